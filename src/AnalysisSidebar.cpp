@@ -142,9 +142,9 @@ AnalysisSidebar::filterChanged()
 }
 
 void
-AnalysisSidebar::setFilter(QStringList filter)
+AnalysisSidebar::setFilter(const RideSet &filter)
 {
-    rideNavigator->searchStrings(filter);
+    rideNavigator->searchStrings(filter.files());
     calendarWidget->setFilter(filter);
 }
 
@@ -48,7 +48,7 @@ class AnalysisSidebar : public QWidget
         void setRide(RideItem*);
 
         void filterChanged();
-        void setFilter(QStringList);
+        void setFilter(const RideSet &);
         void clearFilter();
 
         // analysis menu
@@ -22,6 +22,9 @@
 #include "Context.h"
 #include "RideMetadata.h"
 #include "RideFileCache.h"
+#include "RideFileCacheIndex.h"
+#include "StressCache.h"
+#include "IntervalMetricsCache.h"
 #include "RideMetric.h"
 #include "Settings.h"
 #include "TimeUtils.h"
@@ -105,6 +108,15 @@ Athlete::Athlete(Context *context, const QDir &home)
     // Date Ranges
     seasons = new Seasons(home);
 
+    // Date range aggregates, before metricDB refreshes any cpx
+    cpxIndex = new RideFileCacheIndex(context);
+
+    // Daily PMC stress, before metricDB imports any rides
+    stressCache = new StressCache(context);
+
+    // Interval summaries
+    intervalCache = new IntervalMetricsCache(context);
+
     // Search / filter
 #ifdef GC_HAVE_LUCENE
     namedSearches = new NamedSearches(home); // must be before navigator
@@ -215,6 +227,9 @@ Athlete::~Athlete()
     delete lucene;
 #endif
     delete seasons;
+    delete cpxIndex;
+    delete stressCache;
+    delete intervalCache;
 
     delete rideMetadata_;
     delete zones_;
@@ -358,6 +373,7 @@ Athlete::removeCurrentRide()
     foreach (QString extension, extras) {
 
         QString deleteMe = QFileInfo(strOldFileName).baseName() + "." + extension;
+        if (extension == "cpx") RideFileCache::releaseMapping(home.absolutePath() + "/" + deleteMe);
         QFile::remove(home.absolutePath() + "/" + deleteMe);
     }
 
@@ -390,6 +406,9 @@ Athlete::removeCurrentRide()
 void
 Athlete::checkCPX(RideItem*ride)
 {
+    // the index periods containing it are out of date
+    cpxIndex->rideChanged(ride->fileName);
+
     QList<RideFileCache*> newList;
 
     foreach(RideFileCache *p, cpxCache) {
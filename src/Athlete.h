@@ -40,6 +40,9 @@ class RideNavigator;
 class Lucene;
 class NamedSearches;
 class RideFileCache;
+class RideFileCacheIndex;
+class StressCache;
+class IntervalMetricsCache;
 class RideItem;
 class IntervalItem;
 class IntervalTreeView;
@@ -72,6 +75,9 @@ class Athlete : public QObject
         RideMetadata *rideMetadata_;
         Seasons *seasons;
         QList<RideFileCache*> cpxCache;
+        RideFileCacheIndex *cpxIndex;
+        StressCache *stressCache;
+        IntervalMetricsCache *intervalCache;
 
         // athlete's calendar
         CalendarDownload *calendarDownload;
@@ -21,6 +21,7 @@
 #include "MainWindow.h"
 #include "Context.h"
 #include "Athlete.h"
+#include "RideFileOpenQueue.h"
 
 BatchExportDialog::BatchExportDialog(Context *context) : QDialog(context->mainWindow), context(context)
 {
@@ -185,72 +186,76 @@ BatchExportDialog::exportFiles()
     // what format to export as?
     QString type = RideFileFactory::instance().writeSuffixes().at(format->currentIndex());
 
-    // loop through the table and export all selected
-    for(int i=0; i<files->invisibleRootItem()->childCount(); i++) {
-
-        // give user a chance to abort..
-        QApplication::processEvents();
+    // work out what we are exporting first, they are read on a pool of
+    // threads and handed back in order for us to write them away
+    QList<QTreeWidgetItem*> todo;
+    QStringList names, targets;
 
-        // did they?
-        if (aborted == true) return; // user aborted!
+    for(int i=0; i<files->invisibleRootItem()->childCount(); i++) {
 
         QTreeWidgetItem *current = files->invisibleRootItem()->child(i);
 
         // is it selected
         if (static_cast<QCheckBox*>(files->itemWidget(current,0))->isChecked()) {
 
-            files->setCurrentItem(current); QApplication::processEvents();
-
             QString filename = dirName->text() + "/" + QFileInfo(current->text(1)).baseName() + "." + type;
 
-            if (QFile(filename).exists()) {
-                if (overwrite->isChecked() == false) {
-                    // skip existing files
-                    current->setText(4, tr("Exists - not exported")); QApplication::processEvents();
-                    fails++;
-                    continue;
+            // skip existing files, they are only removed when
+            // there is a ride to replace them with
+            if (QFile(filename).exists() && overwrite->isChecked() == false) {
+                current->setText(4, tr("Exists - not exported"));
+                fails++;
+                continue;
+            }
 
-                } else {
+            // this one then
+            current->setText(4, tr("Reading..."));
 
-                    // remove existing
-                    QFile(filename).remove();
-                    current->setText(4, tr("Removing...")); QApplication::processEvents();
-                }
+            todo << current;
+            names << context->athlete->home.absolutePath()+"/"+current->text(1);
+            targets << filename;
+        }
+    }
 
-            }
-            // this one then
-            current->setText(4, tr("Reading...")); QApplication::processEvents();
+    RideFileOpenQueue queue(context, names);
+    while (!queue.isFinished()) {
 
-            // open it..
-            QStringList errors;
-            QList<RideFile*> rides;
-            QFile thisfile(QString(context->athlete->home.absolutePath()+"/"+current->text(1)));
-            RideFile *ride = RideFileFactory::instance().openRideFile(context, thisfile, errors, &rides);
+        RideFileOpenItem item;
+        if (queue.take(item, 100)) {
 
-            // open success?
-            if (ride) {
+            QTreeWidgetItem *current = todo[item.index];
+            files->setCurrentItem(current);
 
+            // open success?
+            if (item.ride) {
 
                 current->setText(4, tr("Writing...")); QApplication::processEvents();
-                QFile out(filename);
-                bool success = RideFileFactory::instance().writeRideFile(context, ride, out, type);
+                QFile out(targets[item.index]);
+                if (out.exists()) out.remove(); // overwriting
+                bool success = RideFileFactory::instance().writeRideFile(context, item.ride, out, type);
 
                 if (success) {
                     exports++;
-                    current->setText(4, tr("Exported")); QApplication::processEvents();
+                    current->setText(4, tr("Exported"));
                 } else {
                     fails++;
-                    current->setText(4, tr("Write failed")); QApplication::processEvents();
+                    current->setText(4, tr("Write failed"));
                 }
 
-                delete ride; // free memory!
-
             // open failed
             } else {
 
-                current->setText(4, tr("Read error")); QApplication::processEvents();
+                current->setText(4, tr("Read error"));
 
             }
+
+            RideFileOpenQueue::free(item); // free memory!
         }
+
+        // give user a chance to abort..
+        QApplication::processEvents();
+
+        // did they? the readers finish the file they are on
+        if (aborted == true) queue.abort();
     }
 }
@@ -22,6 +22,7 @@
 #include "TimeUtils.h" // for class DateRange
 #include "RealtimeData.h" // for class RealtimeData
 #include "SpecialFields.h" // for class RealtimeData
+#include "RideSet.h" // for class RideSet
 
 class RideFile;
 class RideItem;
@@ -58,7 +59,7 @@ class Context : public QObject
 
         // search filter
         bool isfiltered;
-        QStringList filters;
+        RideSet filters;
 
         // *********************************************
         // APPLICATION EVENTS
@@ -68,7 +69,7 @@ class Context : public QObject
                                     // signal emitted to notify its children
 
         // filters
-        void setFilter(QStringList&f) { filters=f; isfiltered=true; emit filterChanged(); }
+        void setFilter(QStringList&f) { filters=RideSet(f); isfiltered=true; emit filterChanged(); }
         void clearFilter() { filters.clear(); isfiltered=false; emit filterChanged(); }
 
         // realtime signals
@@ -804,7 +804,7 @@ void
 CpintPlot::setFilter(QStringList list)
 {
     isFiltered = true;
-    files = list;
+    files = RideSet(list);
     delete bests;
     bests = NULL;
 }
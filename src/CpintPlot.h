@@ -133,7 +133,7 @@ class CpintPlot : public QwtPlot
         LTMCanvasPicker *canvasPicker;
         penTooltip *zoomer;
 
-        QStringList files;
+        RideSet files;
         bool isFiltered;
         int shadeMode;
 };
@@ -20,6 +20,7 @@
 
 #include "CsvRideFile.h"
 #include "Units.h"
+#include "TextScanner.h"
 #include <QRegExp>
 #include <QTextStream>
 #include <QVector>
@@ -39,7 +40,7 @@ RideFile *CsvFileReader::openRideFile(QFile &file, QStringList &errors, QList<Ri
     bool metric = true;
     enum temperature { degF, degC, degNone };
     typedef enum temperature Temperature;
-    static Temperature tempType = degNone;
+    Temperature tempType = degNone;
     QDateTime startTime;
 
     // TODO: a more robust regex for ergomo files
@@ -95,291 +96,287 @@ RideFile *CsvFileReader::openRideFile(QFile &file, QStringList &errors, QList<Ri
         return NULL;
     }
     int lineno = 1;
-    QTextStream is(&file);
+    TextScanner in(file);
     RideFile *rideFile = new RideFile();
     int iBikeInterval = 0;
     bool dfpmExists   = false;
     int iBikeVersion  = 0;
-    while (!is.atEnd()) {
-        // the readLine() method doesn't handle old Macintosh CR line endings
-        // this workaround will load the the entire file if it has CR endings
-        // then split and loop through each line
-        // otherwise, there will be nothing to split and it will read each line as expected.
-        QString linesIn = is.readLine();
-        QStringList lines = linesIn.split('\r');
-        // workaround for empty lines
-        if(lines.isEmpty()) {
-            lineno++;
-            continue;
-        }
-        for (int li = 0; li < lines.size(); ++li) {
-            QString line = lines[li];
-
-            if (lineno == 1) {
-                if (ergomoCSV.indexIn(line) != -1) {
-                    ergomo = true;
-                    rideFile->setDeviceType("Ergomo");
-                    rideFile->setFileFormat("Ergomo CSV (csv)");
-                    unitsHeader = 2;
-
-                    QStringList headers = line.split(';');
-
-                    if (headers.size()>1)
-                        ergomo_separator = ';';
-                    else
-                        ergomo_separator = ',';
-
-                    ++lineno;
-                    continue;
-                }
-                else if(iBikeCSV.indexIn(line) != -1) {
-                    iBike = true;
-                    rideFile->setDeviceType("iBike");
-                    rideFile->setFileFormat("iBike CSV (csv)");
-                    unitsHeader = 5;
-                    iBikeVersion = line.section( ',', 1, 1 ).toInt();
-                    ++lineno;
-                    continue;
-                 }
-                 else if(motoActvCSV.indexIn(line) != -1) {
-                     motoActv = true;
-                     rideFile->setDeviceType("MotoACTV");
-                     rideFile->setFileFormat("MotoACTV CSV (csv)");
-                     unitsHeader = -1;
-                     /* MotoACTV files are always metric */
+    int tempColumn    = 9; // Joule, unless the headings say otherwise
+    while (in.nextLine()) {
+
+        // only the headings are looked at as text, the
+        // samples are parsed from the fields in place
+        if (lineno == 1) {
+            QString line = in.line();
+            if (ergomoCSV.indexIn(line) != -1) {
+                ergomo = true;
+                rideFile->setDeviceType("Ergomo");
+                rideFile->setFileFormat("Ergomo CSV (csv)");
+                unitsHeader = 2;
+
+                QStringList headers = line.split(';');
+
+                if (headers.size()>1)
+                    ergomo_separator = ';';
+                else
+                    ergomo_separator = ',';
+
+                // semi-colon separated files use a decimal comma
+                in.setSeparators(ergomo_separator == ';' ? ";" : ",");
+                in.setDecimalComma(ergomo_separator == ';');
+
+                ++lineno;
+                continue;
+            }
+            else if(iBikeCSV.indexIn(line) != -1) {
+                iBike = true;
+                rideFile->setDeviceType("iBike");
+                rideFile->setFileFormat("iBike CSV (csv)");
+                unitsHeader = 5;
+                iBikeVersion = line.section( ',', 1, 1 ).toInt();
+                ++lineno;
+                continue;
+             }
+             else if(motoActvCSV.indexIn(line) != -1) {
+                 motoActv = true;
+                 rideFile->setDeviceType("MotoACTV");
+                 rideFile->setFileFormat("MotoACTV CSV (csv)");
+                 unitsHeader = -1;
+                 /* MotoACTV files are always metric */
+                 metric = true;
+                 ++lineno;
+                 continue;
+             }
+             else if(jouleCSV.indexIn(line) != -1) {
+                 joule = true;
+                 rideFile->setDeviceType("Joule");
+                 rideFile->setFileFormat("Joule CSV (csv)");
+                 if(jouleMetriCSV.indexIn(line) != -1) {
+                     unitsHeader = 5;
                      metric = true;
-                     ++lineno;
-                     continue;
-                 }
-                 else if(jouleCSV.indexIn(line) != -1) {
-                     joule = true;
-                     rideFile->setDeviceType("Joule");
-                     rideFile->setFileFormat("Joule CSV (csv)");
-                     if(jouleMetriCSV.indexIn(line) != -1) {
-                         unitsHeader = 5;
-                         metric = true;
-                     }
-                     else { /* ? */ }
-                     ++lineno;
-                     continue;
                  }
-                 // default
-                 rideFile->setDeviceType("PowerTap");
-                 rideFile->setFileFormat("PowerTap CSV (csv)");
+                 else { /* ? */ }
+                 ++lineno;
+                 continue;
+             }
+             // default
+             rideFile->setDeviceType("PowerTap");
+             rideFile->setFileFormat("PowerTap CSV (csv)");
+        }
+        if (iBike && lineno == 2) {
+            if (in.count() == 6) {
+                startTime = QDateTime(
+                    QDate((int)in.number(0), (int)in.number(1), (int)in.number(2)),
+                    QTime((int)in.number(3), (int)in.number(4), (int)in.number(5)));
             }
-            if (iBike && lineno == 2) {
-                QStringList f = line.split(",");
-                if (f.size() == 6) {
-                    startTime = QDateTime(
-                        QDate(f[0].toInt(), f[1].toInt(), f[2].toInt()),
-                        QTime(f[3].toInt(), f[4].toInt(), f[5].toInt()));
+        }
+        if (iBike && lineno == 4) {
+            // this is the line with the iBike configuration data
+            // recording interval is in the [4] location (zero-based array)
+            // the number is in the format 5.000000
+            recInterval = (int)in.number(4);
+        }
+        if (joule && lineno == 2) {
+            // 6,2012-11-27 13:40:41,0,0,0,,55.8,788,227,1,Joule,18.018,,0,
+            if (in.count() >= 2) {
+                int f0l;
+                QString f1 = in.text(1);
+                QStringList f0 = f1.split("|");
+                // new format? due to new PowerAgent version (7.5.7.34)?
+                // 6,2011-01-02 21:22:20|2011-01-02 21:22|01/02/2011 21:22|2011-01-02 21-22-20,0,0, ...
+
+                f0l = f0.size();
+                if (f0l >= 2) {
+                   startTime = QDateTime::fromString(f0[0], "yyyy-MM-dd H:mm:ss");
+                } else {
+                   startTime = QDateTime::fromString(f1, "yyyy-MM-dd H:mm:ss");
                 }
             }
-            if (iBike && lineno == 4) {
-                // this is the line with the iBike configuration data
-                // recording interval is in the [4] location (zero-based array)
-                // the trailing zeroes in the configuration area seem to be causing an error
-                // the number is in the format 5.000000
-                recInterval = (int)line.section(',',4,4).toDouble();
+        }
+        if (lineno == unitsHeader) {
+            QString line = in.line();
+            if (metricUnits.indexIn(line) != -1)
+                metric = true;
+            else if (englishUnits.indexIn(line) != -1)
+                metric = false;
+            else {
+                errors << "Can't find units in first line: \"" + line + "\" of file \"" + file.fileName() + "\".";
+                delete rideFile;
+                file.close();
+                return NULL;
             }
-            if (joule && lineno == 2) {
-                // 6,2012-11-27 13:40:41,0,0,0,,55.8,788,227,1,Joule,18.018,,0,
-                QStringList f = line.split(",");
-                if (f.size() >= 2) {
-                    int f0l;
-                    QStringList f0 = f[1].split("|");
-                    // new format? due to new PowerAgent version (7.5.7.34)?
-                    // 6,2011-01-02 21:22:20|2011-01-02 21:22|01/02/2011 21:22|2011-01-02 21-22-20,0,0, ...
-
-                    f0l = f0.size();
-                    if (f0l >= 2) {
-                       startTime = QDateTime::fromString(f0[0], "yyyy-MM-dd H:mm:ss");
-                    } else {
-                       startTime = QDateTime::fromString(f[1], "yyyy-MM-dd H:mm:ss");
+            if (degCUnits.indexIn(line) != -1)
+                tempType = degC;
+            else if (degFUnits.indexIn(line) != -1)
+                tempType = degF;
+
+            // which column is the temperature in?
+            if (joule && tempType != degNone) {
+                for (int i=0; i<in.count(); i++) {
+                    if (in.text(i).startsWith("Temperature", Qt::CaseInsensitive)) {
+                        tempColumn = i;
+                        break;
                     }
                 }
             }
-            if (lineno == unitsHeader) {
-                if (metricUnits.indexIn(line) != -1)
-                    metric = true;
-                else if (englishUnits.indexIn(line) != -1)
-                    metric = false;
-                else {
-                    errors << "Can't find units in first line: \"" + line + "\" of file \"" + file.fileName() + "\".";
-                    delete rideFile;
-                    file.close();
-                    return NULL;
+        }
+        else if (lineno > unitsHeader && !in.isEmpty()) {
+            double minutes=0,nm,kph,watts,km,cad,alt,hr,dfpm, seconds=0.0;
+            double temp=RideFile::noTemp;
+            double slope=0.0;
+            double lat = 0.0, lon = 0.0;
+            double headwind = 0.0;
+            int interval=0;
+            int pause=0;
+            quint64 ms;
+
+            if (!ergomo && !iBike && !motoActv) {
+                 minutes = in.number(0);
+                 nm = in.number(1);
+                 kph = in.number(2);
+                 watts = in.number(3);
+                 km = in.number(4);
+                 cad = in.number(5);
+                 hr = in.number(6);
+                 interval = (int)in.number(7);
+                 alt = in.number(8);
+                if (joule && tempType != degNone) {
+                    temp = in.number(tempColumn);
+                    if (tempType == degF) {
+                       // convert to deg C
+                       temp *= FAHRENHEIT_PER_CENTIGRADE + FAHRENHEIT_ADD_CENTIGRADE;
+                    }
+                }
+                if (!metric) {
+                    km *= KM_PER_MILE;
+                    kph *= KM_PER_MILE;
+                    alt *= METERS_PER_FOOT;
                 }
-                if (degCUnits.indexIn(line) != -1)
-                    tempType = degC;
-                else if (degFUnits.indexIn(line) != -1)
-                    tempType = degF;
             }
-            else if (lineno > unitsHeader) {
-                double minutes=0,nm,kph,watts,km,cad,alt,hr,dfpm, seconds=0.0;
-                double temp=RideFile::noTemp;
-                double slope=0.0;
-                bool ok;
-                double lat = 0.0, lon = 0.0;
-                double headwind = 0.0;
-                int interval=0;
-                int pause=0;
-                quint64 ms;
-
-                if (!ergomo && !iBike && !motoActv) {
-                     minutes = line.section(',', 0, 0).toDouble();
-                     nm = line.section(',', 1, 1).toDouble();
-                     kph = line.section(',', 2, 2).toDouble();
-                     watts = line.section(',', 3, 3).toDouble();
-                     km = line.section(',', 4, 4).toDouble();
-                     cad = line.section(',', 5, 5).toDouble();
-                     hr = line.section(',', 6, 6).toDouble();
-                     interval = line.section(',', 7, 7).toInt();
-                     alt = line.section(',', 8, 8).toDouble();
-                    if (joule && tempType != degNone) {
-                        // is the position always the same?
-                        // should we read the header and assign positions
-                        // to each item instead?
-                        temp = line.section(',', 9, 9).toDouble();
-                        if (tempType == degF) {
-                           // convert to deg C
-                           temp *= FAHRENHEIT_PER_CENTIGRADE + FAHRENHEIT_ADD_CENTIGRADE;
-                        }
-                    }
-                    if (!metric) {
-                        km *= KM_PER_MILE;
-                        kph *= KM_PER_MILE;
-                        alt *= METERS_PER_FOOT;
-                    }
+            else if (iBike) {
+                // this must be iBike
+                // can't find time as a column.
+                // will we have to extrapolate based on the recording interval?
+                // reading recording interval from config data in ibike csv file
+                //
+                // For iBike software version 11 or higher:
+                // use "power" field until a the "dfpm" field becomes non-zero.
+                 minutes = (recInterval * lineno - unitsHeader)/60.0;
+                 nm = 0; //no torque
+                 kph = in.number(0);
+                 dfpm = in.number(11);
+                 if( iBikeVersion >= 11 && ( dfpm > 0.0 || dfpmExists ) ) {
+                     dfpmExists = true;
+                     watts = dfpm;
+                     headwind = in.number(1);
+                 }
+                 else {
+                     watts = in.number(2);
+                 }
+                 km = in.number(3);
+                 cad = in.number(4);
+                 hr = in.number(5);
+                 alt = in.number(6);
+                 lat = in.number(12);
+                 lon = in.number(13);
+                 temp = in.number(8);
+                 slope = in.number(7);
+                 int lap = (int)in.number(9);
+                 if (lap > 0) {
+                     iBikeInterval += 1;
+                     interval = iBikeInterval;
+                 }
+                if (!metric) {
+                    km *= KM_PER_MILE;
+                    kph *= KM_PER_MILE;
+                    alt *= METERS_PER_FOOT;
+                    headwind *= KM_PER_MILE;
                 }
-                else if (iBike) {
-                    // this must be iBike
-                    // can't find time as a column.
-                    // will we have to extrapolate based on the recording interval?
-                    // reading recording interval from config data in ibike csv file
-                    //
-                    // For iBike software version 11 or higher:
-                    // use "power" field until a the "dfpm" field becomes non-zero.
-                     minutes = (recInterval * lineno - unitsHeader)/60.0;
-                     nm = 0; //no torque
-                     kph = line.section(',', 0, 0).toDouble();
-                     dfpm = line.section( ',', 11, 11).toDouble();
-                     if( iBikeVersion >= 11 && ( dfpm > 0.0 || dfpmExists ) ) {
-                         dfpmExists = true;
-                         watts = dfpm;
-                         headwind = line.section(',', 1, 1).toDouble();
-                     }
-                     else {
-                         watts = line.section(',', 2, 2).toDouble();
-                     }
-                     km = line.section(',', 3, 3).toDouble();
-                     cad = line.section(',', 4, 4).toDouble();
-                     hr = line.section(',', 5, 5).toDouble();
-                     alt = line.section(',', 6, 6).toDouble();
-                     lat = line.section(',', 12, 12).toDouble();
-                     lon = line.section(',', 13, 13).toDouble();
-                     temp = line.section(',', 8, 8).toDouble();
-                     slope = line.section(',', 7, 7).toDouble();
-                     int lap = line.section(',', 9, 9).toInt();
-                     if (lap > 0) {
-                         iBikeInterval += 1;
-                         interval = iBikeInterval;
-                     }
-                    if (!metric) {
-                        km *= KM_PER_MILE;
-                        kph *= KM_PER_MILE;
-                        alt *= METERS_PER_FOOT;
-                        headwind *= KM_PER_MILE;
-                    }
+            }
+           else if(motoActv) {
+                /* MotoActv saves it all as kind of SI (m, ms, m/s, NM etc)
+                 *  "double","double",.. the scanner ignores the quotes
+                 */
+
+                km = in.number(0)/1000;
+                hr = in.number(2);
+                kph = in.number(3)*3.6;
+
+                lat = in.number(5);
+                /* Item 8 is crank torque, 13 is wheel torque */
+                nm = in.number(8);
+
+                /* Ok there's no crank torque, try the wheel */
+                if(nm == 0.0) {
+                     nm = in.number(13);
                 }
-               else if(motoActv) {
-                    /* MotoActv saves it all as kind of SI (m, ms, m/s, NM etc)
-                     *  "double","double",.. so we need to filter out "
-                     */
-
-                    km = line.section(',', 0,0).remove("\"").toDouble()/1000;
-                    hr = line.section(',', 2, 2).remove("\"").toDouble();
-                    kph = line.section(',', 3, 3).remove("\"").toDouble()*3.6;
-
-                    lat = line.section(',', 5, 5).remove("\"").toDouble();
-                    /* Item 8 is crank torque, 13 is wheel torque */
-                    nm = line.section(',', 8, 8).remove("\"").toDouble();
-
-                    /* Ok there's no crank torque, try the wheel */
-                    if(nm == 0.0) {
-                         nm = line.section(',', 13, 13).remove("\"").toDouble();
-                    }
-                    if(epoch_set == false) {
-                         epoch_set = true;
-                         epoch_offset = line.section(',', 9,9).remove("\"").toULongLong(&ok, 10);
-
-                         /* We use this first value as the start time */
-                         startTime = QDateTime();
-                         startTime.setMSecsSinceEpoch(epoch_offset);
-                         rideFile->setStartTime(startTime);
-                    }
-
-                    ms = line.section(',', 9,9).remove("\"").toULongLong(&ok, 10);
-                    ms -= epoch_offset;
-                    seconds = ms/1000;
-
-                    alt = line.section(',', 10, 10).remove("\"").toDouble();
-                    watts = line.section(',', 11, 11).remove("\"").toDouble();
-                    lon = line.section(',', 15, 15).remove("\"").toDouble();
-                    cad = line.section(',', 16, 16).remove("\"").toDouble();
-               }
-                else {
-                     // for ergomo formatted CSV files
-                     minutes     = line.section(ergomo_separator, 0, 0).toDouble() + total_pause;
-                     QString km_string = line.section(ergomo_separator, 1, 1);
-                     km_string.replace(",",".");
-                     km = km_string.toDouble();
-                     watts = line.section(ergomo_separator, 2, 2).toDouble();
-                     cad = line.section(ergomo_separator, 3, 3).toDouble();
-                     QString kph_string = line.section(ergomo_separator, 4, 4);
-                     kph_string.replace(",",".");
-                     kph = kph_string.toDouble();
-                     hr = line.section(ergomo_separator, 5, 5).toDouble();
-                     alt = line.section(ergomo_separator, 6, 6).toDouble();
-                     interval = line.section(',', 8, 8).toInt();
-                     if (interval != prevInterval) {
-                         prevInterval = interval;
-                         if (interval != 0) currentInterval++;
-                     }
-                     if (interval != 0) interval = currentInterval;
-                     pause = line.section(ergomo_separator, 9, 9).toInt();
-                     total_pause += pause;
-                     nm = 0; // torque is not provided in the Ergomo file
-
-                     // the ergomo records the time in whole seconds
-                     // RECORDING INT. 1, 2, 5, 10, 15 or 30 per sec
-                     // Time is *always* perfectly sequential.  To find pauses,
-                     // you need to read the PAUSE column.
-                     minutes = minutes/60.0;
-
-                     if (!metric) {
-                         km *= KM_PER_MILE;
-                         kph *= KM_PER_MILE;
-                         alt *= METERS_PER_FOOT;
-                     }
+                if(epoch_set == false) {
+                     epoch_set = true;
+                     epoch_offset = (quint64)in.number(9);
+
+                     /* We use this first value as the start time */
+                     startTime = QDateTime();
+                     startTime.setMSecsSinceEpoch(epoch_offset);
+                     rideFile->setStartTime(startTime);
                 }
 
-                // PT reports no data as watts == -1.
-                if (watts == -1)
-                    watts = 0;
-
-               if(motoActv)
-                    rideFile->appendPoint(seconds, cad, hr, km,
-                                          kph, nm, watts, alt, lon, lat, 0.0,
-                                          0.0, temp, 0.0, interval);
-               else
-                    rideFile->appendPoint(minutes * 60.0, cad, hr, km,
-                                          kph, nm, watts, alt, lon, lat,
-                                          headwind, slope, temp, 0.0,
-                                          interval);
+                ms = (quint64)in.number(9);
+                ms -= epoch_offset;
+                seconds = ms/1000;
+
+                alt = in.number(10);
+                watts = in.number(11);
+                lon = in.number(15);
+                cad = in.number(16);
+           }
+            else {
+                 // for ergomo formatted CSV files, distance and
+                 // speed have a decimal comma when ';' separated
+                 minutes     = in.number(0) + total_pause;
+                 km = in.number(1);
+                 watts = in.number(2);
+                 cad = in.number(3);
+                 kph = in.number(4);
+                 hr = in.number(5);
+                 alt = in.number(6);
+                 interval = (int)in.number(8);
+                 if (interval != prevInterval) {
+                     prevInterval = interval;
+                     if (interval != 0) currentInterval++;
+                 }
+                 if (interval != 0) interval = currentInterval;
+                 pause = (int)in.number(9);
+                 total_pause += pause;
+                 nm = 0; // torque is not provided in the Ergomo file
+
+                 // the ergomo records the time in whole seconds
+                 // RECORDING INT. 1, 2, 5, 10, 15 or 30 per sec
+                 // Time is *always* perfectly sequential.  To find pauses,
+                 // you need to read the PAUSE column.
+                 minutes = minutes/60.0;
+
+                 if (!metric) {
+                     km *= KM_PER_MILE;
+                     kph *= KM_PER_MILE;
+                     alt *= METERS_PER_FOOT;
+                 }
             }
-            ++lineno;
+
+            // PT reports no data as watts == -1.
+            if (watts == -1)
+                watts = 0;
+
+           if(motoActv)
+                rideFile->appendPoint(seconds, cad, hr, km,
+                                      kph, nm, watts, alt, lon, lat, 0.0,
+                                      0.0, temp, 0.0, interval);
+           else
+                rideFile->appendPoint(minutes * 60.0, cad, hr, km,
+                                      kph, nm, watts, alt, lon, lat,
+                                      headwind, slope, temp, 0.0,
+                                      interval);
         }
+        ++lineno;
     }
     file.close();
 
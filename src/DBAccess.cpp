@@ -32,6 +32,7 @@
 #include <QFile>
 #include <QFileInfo>
 #include "SummaryMetrics.h"
+#include "StressCache.h"
 #include "RideMetadata.h"
 #include "SpecialFields.h"
 
@@ -69,7 +70,7 @@
 
 int DBSchemaVersion = 48;
 
-DBAccess::DBAccess(Context* context) : context(context), db(NULL)
+DBAccess::DBAccess(Context* context) : context(context), db(NULL), insertMetrics(NULL)
 {
     // check we have one and use built in if not there
     RideMetadata::readXML(":/xml/measures.xml", mkeywordDefinitions, mfieldDefinitions, mcolorfield);
@@ -78,6 +79,7 @@ DBAccess::DBAccess(Context* context) : context(context), db(NULL)
 
 DBAccess::~DBAccess()
 {
+    delete insertMetrics;
     if (db) {
         db->close();
         delete db;
@@ -204,6 +206,13 @@ bool DBAccess::createMetricsTable()
 
 bool DBAccess::dropMetricTable()
 {
+    store.clear();
+    context->athlete->stressCache->clear();
+
+    // the insert is for the old schema
+    delete insertMetrics;
+    insertMetrics = NULL;
+
     QSqlQuery query("DROP TABLE metrics", db->database(sessionid));
     bool rc = query.exec();
     return rc;
@@ -380,85 +389,127 @@ int DBAccess::getDBVersion()
 /*----------------------------------------------------------------------
  * CRUD routines for Metrics table
  *----------------------------------------------------------------------*/
-bool DBAccess::importRide(SummaryMetrics *summaryMetrics, RideFile *ride, QColor color, unsigned long fingerprint, bool modify)
+bool DBAccess::importRide(SummaryMetrics *summaryMetrics, RideFile *ride, QColor color, unsigned long fingerprint, bool)
 {
-	QSqlQuery query(db->database(sessionid));
     QDateTime timestamp = QDateTime::currentDateTime();
+    const RideMetricFactory &factory = RideMetricFactory::instance();
 
-    if (modify) {
-        // zap the current row
-	    query.prepare("DELETE FROM metrics WHERE filename = ?;");
-	    query.addBindValue(summaryMetrics->getFileName());
-        query.exec();
-    }
+    // the statement only changes with the schema, so we prepare it once
+    // and reuse it for every ride. Since filename is the primary key
+    // an existing row is replaced, so we don't need to delete it first
+    if (insertMetrics == NULL) {
 
-    // construct an insert statement
-    QString insertStatement = "insert into metrics ( filename, identifier, timestamp, ride_date, color, fingerprint ";
-    const RideMetricFactory &factory = RideMetricFactory::instance();
-    for (int i=0; i<factory.metricCount(); i++)
-        insertStatement += QString(", X%1 ").arg(factory.metricName(i));
+        // construct an insert statement
+        QString insertStatement = "insert or replace into metrics ( filename, identifier, timestamp, ride_date, color, fingerprint ";
+        for (int i=0; i<factory.metricCount(); i++)
+            insertStatement += QString(", X%1 ").arg(factory.metricName(i));
 
-    // And all the metadata texts
-    foreach(FieldDefinition field, context->athlete->rideMetadata()->getFields()) {
-        if (!context->specialFields.isMetric(field.name) && (field.type < 3 || field.type == 7)) {
-            insertStatement += QString(", Z%1 ").arg(context->specialFields.makeTechName(field.name));
+        // And all the metadata texts
+        foreach(FieldDefinition field, context->athlete->rideMetadata()->getFields()) {
+            if (!context->specialFields.isMetric(field.name) && (field.type < 3 || field.type == 7)) {
+                insertStatement += QString(", Z%1 ").arg(context->specialFields.makeTechName(field.name));
+            }
         }
-    }
-        // And all the metadata metrics
-    foreach(FieldDefinition field, context->athlete->rideMetadata()->getFields()) {
-        if (!context->specialFields.isMetric(field.name) && (field.type == 3 || field.type == 4)) {
-            insertStatement += QString(", Z%1 ").arg(context->specialFields.makeTechName(field.name));
+            // And all the metadata metrics
+        foreach(FieldDefinition field, context->athlete->rideMetadata()->getFields()) {
+            if (!context->specialFields.isMetric(field.name) && (field.type == 3 || field.type == 4)) {
+                insertStatement += QString(", Z%1 ").arg(context->specialFields.makeTechName(field.name));
+            }
         }
-    }
 
-    insertStatement += " ) values (?,?,?,?,?,?"; // filename, identifier, timestamp, ride_date, color, fingerprint
-    for (int i=0; i<factory.metricCount(); i++)
-        insertStatement += ",?";
-    foreach(FieldDefinition field, context->athlete->rideMetadata()->getFields()) {
-        if (!context->specialFields.isMetric(field.name) && (field.type < 5 || field.type == 7)) {
+        insertStatement += " ) values (?,?,?,?,?,?"; // filename, identifier, timestamp, ride_date, color, fingerprint
+        for (int i=0; i<factory.metricCount(); i++)
             insertStatement += ",?";
+        foreach(FieldDefinition field, context->athlete->rideMetadata()->getFields()) {
+            if (!context->specialFields.isMetric(field.name) && (field.type < 5 || field.type == 7)) {
+                insertStatement += ",?";
+            }
         }
-    }
-    insertStatement += ")";
+        insertStatement += ")";
 
-	query.prepare(insertStatement);
+        insertMetrics = new QSqlQuery(db->database(sessionid));
+        insertMetrics->prepare(insertStatement);
+    }
+    QSqlQuery &query = *insertMetrics;
+    int bind = 0;
 
     // filename, timestamp, ride date
-	query.addBindValue(summaryMetrics->getFileName());
-	query.addBindValue(summaryMetrics->getId());
-	query.addBindValue(timestamp.toTime_t());
-    query.addBindValue(summaryMetrics->getRideDate());
-    query.addBindValue(color.name());
-    query.addBindValue((int)fingerprint);
+	query.bindValue(bind++, summaryMetrics->getFileName());
+	query.bindValue(bind++, summaryMetrics->getId());
+	query.bindValue(bind++, timestamp.toTime_t());
+    query.bindValue(bind++, summaryMetrics->getRideDate());
+    query.bindValue(bind++, color.name());
+    query.bindValue(bind++, (int)fingerprint);
 
     // values
     for (int i=0; i<factory.metricCount(); i++) {
-	    query.addBindValue(summaryMetrics->getForSymbol(factory.metricName(i)));
+	    query.bindValue(bind++, summaryMetrics->getForMetric(i));
     }
 
     // And all the metadata texts
     foreach(FieldDefinition field, context->athlete->rideMetadata()->getFields()) {
 
         if (!context->specialFields.isMetric(field.name) && (field.type < 3 || field.type ==7)) {
-            query.addBindValue(ride->getTag(field.name, ""));
+            query.bindValue(bind++, ride->getTag(field.name, ""));
         }
     }
     // And all the metadata metrics
     foreach(FieldDefinition field, context->athlete->rideMetadata()->getFields()) {
 
         if (!context->specialFields.isMetric(field.name) && (field.type == 3 || field.type == 4)) {
-            query.addBindValue(ride->getTag(field.name, "0.0").toDouble());
+            query.bindValue(bind++, ride->getTag(field.name, "0.0").toDouble());
         } else if (!context->specialFields.isMetric(field.name)) {
             if (field.name == "Recording Interval") 
-                query.addBindValue(ride->recIntSecs());
+                query.bindValue(bind++, ride->recIntSecs());
         }
     }
 
+    // the PMC is stale from the ride date on, or its old date if it moved
+    QDate stale = summaryMetrics->getRideDate().date();
+    QDate old;
+    if (store.isLoaded()) {
+        int index = store.indexOf(summaryMetrics->getFileName());
+        if (index >= 0) old = store.rideDates().at(index).date();
+    } else {
+        QSqlQuery previous(db->database(sessionid));
+        previous.prepare("SELECT ride_date FROM metrics WHERE filename = ?;");
+        previous.addBindValue(summaryMetrics->getFileName());
+        if (previous.exec() && previous.next()) old = previous.value(0).toDateTime().date();
+    }
+    if (old.isValid() && old < stale) stale = old;
+
     // go do it!
 	bool rc = query.exec();
+    query.finish();
 
 	//if(!rc) qDebug() << query.lastError();
 
+    if (rc) context->athlete->stressCache->rideChanged(stale);
+
+    // keep the in memory copy in step, with the values as
+    // they would be read back from the db
+    if (rc && store.isLoaded()) {
+        SummaryMetrics row;
+        row.setFileName(summaryMetrics->getFileName());
+        row.setId(summaryMetrics->getId());
+        row.setRideDate(QDateTime::fromString(summaryMetrics->getRideDate().toString(Qt::ISODate), Qt::ISODate));
+
+        for (int i=0; i<factory.metricCount(); i++) {
+            double value = summaryMetrics->getForSymbol(factory.metricName(i));
+            row.setForSymbol(factory.metricName(i), value != value ? 0 : value); // NaN is stored as NULL
+        }
+        foreach(FieldDefinition field, context->athlete->rideMetadata()->getFields()) {
+            if (!context->specialFields.isMetric(field.name) && (field.type == 3 || field.type == 4)) {
+                QString underscored = field.name;
+                row.setForSymbol(underscored.replace("_"," "), ride->getTag(field.name, "0.0").toDouble());
+            } else if (!context->specialFields.isMetric(field.name) && (field.type < 3 || field.type == 7)) {
+                QString underscored = field.name;
+                row.setText(underscored.replace("_"," "), ride->getTag(field.name, ""));
+            }
+        }
+        store.insert(row);
+    }
+
 	return rc;
 }
 
@@ -467,9 +518,17 @@ DBAccess::deleteRide(QString name)
 {
     QSqlQuery query(db->database(sessionid));
 
+    // the PMC is stale from the ride date on
+    query.prepare("SELECT ride_date FROM metrics WHERE filename = ?;");
+    query.addBindValue(name);
+    if (query.exec() && query.next()) context->athlete->stressCache->rideChanged(query.value(0).toDateTime().date());
+
     query.prepare("DELETE FROM metrics WHERE filename = ?;");
     query.addBindValue(name);
-    return query.exec();
+    bool rc = query.exec();
+
+    if (rc) store.remove(name);
+    return rc;
 }
 
 QList<QDateTime> DBAccess::getAllDates()
@@ -548,50 +607,115 @@ QList<SummaryMetrics> DBAccess::getAllMetricsFor(QDateTime start, QDateTime end)
     if (start == QDateTime()) start = QDateTime::currentDateTime().addYears(-10);
     if (end == QDateTime()) end = QDateTime::currentDateTime().addYears(+10);
 
+    // answered from the in memory copy of the metrics table
+    if (!store.isLoaded()) loadStore();
+
+    int from, to;
+    store.range(start.date(), end.date(), from, to);
+    for (int i=from; i<to; i++) metrics << store.row(i);
+
+    return metrics;
+}
+
+void
+DBAccess::loadStore()
+{
+    DBSelect select = metricsSelect();
+
+    // the columns, as returned by getAllMetricsFor()
+    QStringList valueNames, textNames;
+    for (int i=0; i<select.names.count(); i++) {
+        if (select.numeric[i]) valueNames << select.names[i];
+        else textNames << select.names[i];
+    }
+
+    store.clear();
+    store.setColumns(valueNames, textNames);
+
+    // execute the select statement
+    QSqlQuery query(select.statement + " ORDER BY ride_date;", db->database(sessionid));
+    query.exec();
+    while(query.next()) store.append(readRow(select, query));
+    store.setLoaded();
+}
+
+DBSelect
+DBAccess::metricsSelect()
+{
+    DBSelect select;
+    select.measures = false;
+
     // construct the select statement
-    QString selectStatement = "SELECT filename, identifier, ride_date";
+    select.statement = "SELECT filename, identifier, ride_date";
     const RideMetricFactory &factory = RideMetricFactory::instance();
-    for (int i=0; i<factory.metricCount(); i++)
-        selectStatement += QString(", X%1 ").arg(factory.metricName(i));
+    for (int i=0; i<factory.metricCount(); i++) {
+        select.statement += QString(", X%1 ").arg(factory.metricName(i));
+        select.names << factory.metricName(i);
+        select.numeric << true;
+    }
     foreach(FieldDefinition field, context->athlete->rideMetadata()->getFields()) {
         if (!context->specialFields.isMetric(field.name) && (field.type < 5 || field.type == 7)) {
-            selectStatement += QString(", Z%1 ").arg(context->specialFields.makeTechName(field.name));
+            select.statement += QString(", Z%1 ").arg(context->specialFields.makeTechName(field.name));
+
+            QString underscored = field.name;
+            select.names << underscored.replace("_"," ");
+            select.numeric << (field.type == 3 || field.type == 4);
         }
     }
-    selectStatement += " FROM metrics where DATE(ride_date) >=DATE(:start) AND DATE(ride_date) <=DATE(:end) "
-                       " ORDER BY ride_date;";
+    select.statement += " FROM metrics";
 
-    // execute the select statement
-    QSqlQuery query(selectStatement, db->database(sessionid));
-    query.bindValue(":start", start.date());
-    query.bindValue(":end", end.date());
-    query.exec();
-    while(query.next())
-    {
-        SummaryMetrics summaryMetrics;
+    return select;
+}
 
-        // filename and date
-        summaryMetrics.setFileName(query.value(0).toString());
-        summaryMetrics.setId(query.value(1).toString());
-        summaryMetrics.setRideDate(query.value(2).toDateTime());
-        // the values
-        int i=0;
-        for (; i<factory.metricCount(); i++)
-            summaryMetrics.setForSymbol(factory.metricName(i), query.value(i+3).toDouble());
-        foreach(FieldDefinition field, context->athlete->rideMetadata()->getFields()) {
-            if (!context->specialFields.isMetric(field.name) && (field.type == 3 || field.type == 4)) {
-                QString underscored = field.name;
-                summaryMetrics.setForSymbol(underscored.replace("_"," "), query.value(i+3).toDouble());
-                i++;
-            } else if (!context->specialFields.isMetric(field.name) && (field.type < 3 || field.type == 7)) {
-                QString underscored = field.name;
-                summaryMetrics.setText(underscored.replace("_"," "), query.value(i+3).toString());
-                i++;
-            }
+DBSelect
+DBAccess::measuresSelect()
+{
+    DBSelect select;
+    select.measures = true;
+
+    // construct the select statement
+    select.statement = "SELECT timestamp, measure_date";
+    foreach(FieldDefinition field, mfieldDefinitions) {
+        if (!context->specialFields.isMetric(field.name) && (field.type < 5 || field.type == 7)) {
+            select.statement += QString(", Z%1 ").arg(context->specialFields.makeTechName(field.name));
         }
-        metrics << summaryMetrics;
     }
-    return metrics;
+    select.statement += " FROM measures";
+
+    // all measures are kept as texts
+    foreach(FieldDefinition field, mfieldDefinitions) {
+        if (field.type < 5 || field.type == 7) {
+            select.names << field.name;
+            select.numeric << false;
+        }
+    }
+
+    return select;
+}
+
+SummaryMetrics
+DBAccess::readRow(const DBSelect &select, const QSqlQuery &query)
+{
+    SummaryMetrics returning;
+    int i;
+
+    if (select.measures) {
+        returning.setDateTime(query.value(1).toDateTime());
+        i = 2;
+    } else {
+        // filename and date
+        returning.setFileName(query.value(0).toString());
+        returning.setId(query.value(1).toString());
+        returning.setRideDate(query.value(2).toDateTime());
+        i = 3;
+    }
+
+    // the values
+    for (int j=0; j<select.names.count(); j++, i++) {
+        if (select.numeric[j]) returning.setForSymbol(select.names[j], query.value(i).toDouble());
+        else returning.setText(select.names[j], query.value(i).toString());
+    }
+    return returning;
 }
 
 SummaryMetrics DBAccess::getRideMetrics(QString filename)
@@ -638,6 +762,137 @@ SummaryMetrics DBAccess::getRideMetrics(QString filename)
     return summaryMetrics;
 }
 
+/*----------------------------------------------------------------------
+ * In memory copy of the Metrics table
+ *----------------------------------------------------------------------*/
+void
+MetricStore::setColumns(QStringList valueNames, QStringList textNames)
+{
+    this->valueNames = valueNames;
+    this->textNames = textNames;
+
+    valueIndex.clear();
+    for (int i=0; i<valueNames.count(); i++) valueIndex.insert(valueNames[i], i);
+
+    values.resize(valueNames.count());
+    texts.resize(textNames.count());
+}
+
+void
+MetricStore::clear()
+{
+    loaded = false;
+    dates.clear();
+    files.clear();
+    ids.clear();
+    fileDates.clear();
+    for (int i=0; i<values.count(); i++) values[i].clear();
+    for (int i=0; i<texts.count(); i++) texts[i].clear();
+}
+
+void
+MetricStore::append(const SummaryMetrics &row)
+{
+    insertAt(dates.count(), row);
+}
+
+void
+MetricStore::insert(const SummaryMetrics &row)
+{
+    remove(row.getFileName());
+
+    // after any rides at the same time
+    int index = qUpperBound(dates.begin(), dates.end(), row.getRideDate()) - dates.begin();
+    insertAt(index, row);
+}
+
+void
+MetricStore::insertAt(int index, const SummaryMetrics &row)
+{
+    dates.insert(index, row.getRideDate());
+    files.insert(index, row.getFileName());
+    ids.insert(index, row.getId());
+    fileDates.insert(row.getFileName(), row.getRideDate());
+
+    const RideMetricFactory &factory = RideMetricFactory::instance();
+    int i=0;
+    for (; i<valueNames.count() && i<factory.metricCount(); i++) values[i].insert(index, row.getForMetric(i));
+    for (; i<valueNames.count(); i++) values[i].insert(index, row.getForSymbol(valueNames[i]));
+    for (i=0; i<textNames.count(); i++) texts[i].insert(index, row.getText(textNames[i], ""));
+}
+
+void
+MetricStore::remove(QString fileName)
+{
+    int index = indexOf(fileName);
+    if (index < 0) return;
+
+    dates.remove(index);
+    files.removeAt(index);
+    ids.removeAt(index);
+    fileDates.remove(fileName);
+
+    for (int i=0; i<values.count(); i++) values[i].remove(index);
+    for (int i=0; i<texts.count(); i++) texts[i].remove(index);
+}
+
+int
+MetricStore::indexOf(QString fileName) const
+{
+    QHash<QString, QDateTime>::const_iterator it = fileDates.find(fileName);
+    if (it == fileDates.end()) return -1;
+
+    // rides at the same time are next to each other
+    int index = qLowerBound(dates.begin(), dates.end(), it.value()) - dates.begin();
+    for (; index < dates.count() && dates[index] == it.value(); index++)
+        if (files[index] == fileName) return index;
+    return -1;
+}
+
+void
+MetricStore::range(QDate start, QDate end, int &from, int &to) const
+{
+    // by date, ignoring the time of day
+    from = qLowerBound(dates.begin(), dates.end(), QDateTime(start, QTime(0,0,0))) - dates.begin();
+    to = qLowerBound(dates.begin(), dates.end(), QDateTime(end.addDays(1), QTime(0,0,0))) - dates.begin();
+    if (to < from) to = from;
+}
+
+SummaryMetrics
+MetricStore::row(int index) const
+{
+    SummaryMetrics returning;
+
+    returning.setFileName(files[index]);
+    returning.setId(ids[index]);
+    returning.setRideDate(dates[index]);
+
+    // the ride metrics come first, in RideMetricFactory order
+    const RideMetricFactory &factory = RideMetricFactory::instance();
+    int i=0;
+    for (; i<valueNames.count() && i<factory.metricCount(); i++) returning.setForMetric(i, values[i][index]);
+    for (; i<valueNames.count(); i++) returning.setForSymbol(valueNames[i], values[i][index]);
+    for (int i=0; i<textNames.count(); i++) returning.setText(textNames[i], texts[i][index]);
+
+    return returning;
+}
+
+const QVector<double> *
+MetricStore::column(QString symbol) const
+{
+    QHash<QString, int>::const_iterator it = valueIndex.find(symbol);
+    if (it == valueIndex.end()) return NULL;
+    return &values[it.value()];
+}
+
+const QVector<QString> *
+MetricStore::textColumn(QString name) const
+{
+    int index = textNames.indexOf(name);
+    if (index < 0) return NULL;
+    return &texts[index];
+}
+
 /*----------------------------------------------------------------------
  * CRUD routines for Measures table
  *----------------------------------------------------------------------*/
@@ -705,39 +960,15 @@ QList<SummaryMetrics> DBAccess::getAllMeasuresFor(QDateTime start, QDateTime end
     if (start == QDateTime()) start = QDateTime::currentDateTime().addYears(-10);
     if (end == QDateTime()) end = QDateTime::currentDateTime().addYears(+10);
 
-    // construct the select statement
-    QString selectStatement = "SELECT timestamp, measure_date";
-    foreach(FieldDefinition field, mfieldDefinitions) {
-        if (!context->specialFields.isMetric(field.name) && (field.type < 5 || field.type == 7)) {
-            selectStatement += QString(", Z%1 ").arg(context->specialFields.makeTechName(field.name));
-        }
-    }
-    selectStatement += " FROM measures where DATE(measure_date) >=DATE(:start) AND DATE(measure_date) <=DATE(:end) "
-                       " ORDER BY measure_date;";
+    DBSelect select = measuresSelect();
+    QString selectStatement = select.statement + " where DATE(measure_date) >=DATE(:start) AND DATE(measure_date) <=DATE(:end) "
+                                                 " ORDER BY measure_date;";
 
     // execute the select statement
     QSqlQuery query(selectStatement, db->database(sessionid));
     query.bindValue(":start", start.date());
     query.bindValue(":end", end.date());
     query.exec();
-    while(query.next())
-    {
-        SummaryMetrics add;
-
-        // filename and date
-        add.setDateTime(query.value(1).toDateTime());
-        // the values
-        int i=2;
-        foreach(FieldDefinition field, mfieldDefinitions) {
-            if (field.type == 3 || field.type == 4) {
-                add.setText(field.name, query.value(i).toString());
-                i++;
-            } else if (field.type < 3 || field.type == 7) {
-                add.setText(field.name, query.value(i).toString());
-                i++;
-            }
-        }
-        measures << add;
-    }
+    while(query.next()) measures << readRow(select, query);
     return measures;
 }
@@ -37,6 +37,67 @@ extern int DBSchemaVersion;
 class RideFile;
 class Zones;
 class RideMetric;
+
+// A select from the metrics or measures table along with what its
+// columns are, so it can be run on another connection (see MetricQuery)
+// metrics: filename, identifier, ride_date and then the columns
+// measures: timestamp, measure_date and then the columns
+struct DBSelect
+{
+    QString statement; // without any where or order by
+    QStringList names; // the columns after the keys
+    QVector<bool> numeric; // value or text
+    bool measures;
+};
+
+// The metrics table is also held in memory column by column so the
+// charts don't need to query and unpack every row whenever they are
+// refreshed. It is loaded from the db the first time it is needed
+// and is kept in step by importRide() and deleteRide(), other than
+// during a bulk refresh when it is dropped and loaded again after.
+class MetricStore
+{
+    public:
+        MetricStore() : loaded(false) {}
+
+        // the columns, metric symbols (and numeric metadata) then texts
+        void setColumns(QStringList valueNames, QStringList textNames);
+        bool isLoaded() const { return loaded; }
+        void setLoaded() { loaded = true; }
+        void clear();
+
+        // rows are kept in ride date order
+        int count() const { return dates.count(); }
+        void append(const SummaryMetrics &row); // when loading, already in order
+        void insert(const SummaryMetrics &row); // replaces any row for the same file
+        void remove(QString fileName);
+        int indexOf(QString fileName) const; // -1 if there is no row for it
+
+        // rows [from, to) with ride date within start and end inclusive
+        void range(QDate start, QDate end, int &from, int &to) const;
+
+        // a row as a SummaryMetrics or a whole column (NULL if no such symbol)
+        SummaryMetrics row(int index) const;
+        const QVector<double> *column(QString symbol) const;
+        const QVector<QString> *textColumn(QString name) const;
+        const QVector<QDateTime> &rideDates() const { return dates; }
+        const QStringList &fileNames() const { return files; }
+
+    private:
+        void insertAt(int index, const SummaryMetrics &row);
+
+        bool loaded;
+
+        QVector<QDateTime> dates;
+        QStringList files, ids;
+        QHash<QString, QDateTime> fileDates; // to find a file's row by date
+
+        QStringList valueNames, textNames;
+        QHash<QString, int> valueIndex;
+        QVector<QVector<double> > values;
+        QVector<QVector<QString> > texts;
+};
+
 class DBAccess
 {
 
@@ -76,6 +137,16 @@ class DBAccess
 
         SummaryMetrics getRideMetrics(QString filename); // for a filename
 
+        // the in memory copy of the metrics table
+        const MetricStore &metricStore() { if (!store.isLoaded()) loadStore(); return store; }
+        void unloadStore() { store.clear(); } // before a bulk refresh
+
+        // for running selects on another connection
+        QString databaseName() const { return db->databaseName(); }
+        DBSelect metricsSelect();
+        DBSelect measuresSelect();
+        static SummaryMetrics readRow(const DBSelect &select, const QSqlQuery &query);
+
 	    QList<QDateTime> getAllDates();
         QList<Season> getAllSeasons();
 
@@ -91,6 +162,12 @@ class DBAccess
         QList<KeywordDefinition> mkeywordDefinitions; //NOTE: not used in measures.xml
         QString mcolorfield;
 
+        MetricStore store;
+        void loadStore();
+
+        // prepared once per schema and reused for every ride
+        QSqlQuery *insertMetrics;
+
 	    typedef QHash<QString,RideMetric*> MetricMap;
 
 	    bool createDatabase();
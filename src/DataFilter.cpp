@@ -22,7 +22,11 @@
 #include "Athlete.h"
 #include "RideNavigator.h"
 #include "RideFileCache.h"
+#include "RideMetric.h"
+#include "SummaryMetrics.h"
+#include "DBAccess.h"
 #include <QDebug>
+#include <math.h>
 
 #include "DataFilter_yacc.h"
 
@@ -157,6 +161,13 @@ void Leaf::validateFilter(DataFilter *df, Leaf *leaf)
 
             // now set the series type
             leaf->seriesType = nameToSeries(symbol);
+
+            // and check the duration, it can be any expression
+            // that is a number, or a number in quotes
+            Leaf *duration = leaf->lvalue.l;
+            if (duration->type != Leaf::String && !isNumber(df, duration))
+                DataFiltererrors << QString("duration for %1() must be a number").arg(leaf->function);
+            validateFilter(df, duration);
         }
         break;
 
@@ -195,7 +206,7 @@ void Leaf::validateFilter(DataFilter *df, Leaf *leaf)
 DataFilter::DataFilter(QObject *parent, Context *context) : QObject(parent), context(context), treeRoot(NULL)
 {
     configUpdate();
-    connect(context, SIGNAL(configChanged()), this, SLOT(configUpdate()));
+    if (context) connect(context, SIGNAL(configChanged()), this, SLOT(configUpdate()));
 }
 
 QStringList DataFilter::parseFilter(QString query)
@@ -235,17 +246,31 @@ QStringList DataFilter::parseFilter(QString query)
         emit parseGood();
 
         // get all fields...
-        QList<SummaryMetrics> allRides = context->athlete->metricDB->getAllMetricsFor(QDateTime(), QDateTime());
+        const MetricStore &allRides = context->athlete->metricDB->metricStore();
+        const QStringList &allFiles = allRides.fileNames();
+
+        // compile it and get any bests or tiz for all rides in one go
+        program.compile(this, treeRoot);
+        program.prepare(context, allFiles);
 
         filenames.clear();
 
-        for (int i=0; i<allRides.count(); i++) {
+        QBitArray matches;
+        if (program.runColumns(allRides, matches)) {
+
+            // evaluated for all rides at once
+            for (int i=0; i<allFiles.count(); i++)
+                if (matches.testBit(i)) filenames << allFiles.at(i);
 
-            // evaluate each ride...
-            QString f= allRides.at(i).getFileName();
-            double result = treeRoot->eval(this, treeRoot, allRides.at(i), f);
-            if (result) {
-                filenames << f;
+        } else {
+
+            for (int i=0; i<allRides.count(); i++) {
+
+                // evaluate each ride...
+                double result = program.run(context, allRides.row(i), i, allFiles.at(i));
+                if (result) {
+                    filenames << allFiles.at(i);
+                }
             }
         }
         emit results(filenames);
@@ -257,6 +282,7 @@ QStringList DataFilter::parseFilter(QString query)
 
 void DataFilter::clearFilter()
 {
+    program.clear();
     if (treeRoot) {
         treeRoot->clear(treeRoot);
         treeRoot = NULL;
@@ -279,7 +305,7 @@ void DataFilter::configUpdate()
     }
 
     // now add the ride metadata fields -- should be the same generally
-    foreach(FieldDefinition field, context->athlete->rideMetadata()->getFields()) {
+    if (context) foreach(FieldDefinition field, context->athlete->rideMetadata()->getFields()) {
             QString underscored = field.name;
             if (!context->specialFields.isMetric(underscored)) {
                 lookupMap.insert(underscored.replace(" ","_"), field.name);
@@ -288,7 +314,7 @@ void DataFilter::configUpdate()
     }
 }
 
-double Leaf::eval(DataFilter *df, Leaf *leaf, SummaryMetrics m, QString f)
+double Leaf::eval(DataFilter *df, Leaf *leaf, const SummaryMetrics &m, QString f)
 {
     switch(leaf->type) {
 
@@ -594,3 +620,470 @@ double Leaf::eval(DataFilter *df, Leaf *leaf, SummaryMetrics m, QString f)
     }
     return false;
 }
+
+//
+// COMPILED PROGRAM
+//
+// Leaf::eval() above is the reference, the program must give the same
+// results -- including its quirks, e.g. a string symbol on the rhs of
+// a comparison defaults to "notfound" but on the lhs it defaults to "".
+//
+int DataFilterProgram::add(opcode op, int arg, double number, QString text)
+{
+    Instruction instruction;
+    instruction.op = op;
+    instruction.arg = arg;
+    instruction.slot = -1;
+    instruction.number = number;
+    instruction.text = text;
+    program << instruction;
+
+    return program.count() - 1;
+}
+
+void DataFilterProgram::compile(DataFilter *df, Leaf *leaf)
+{
+    clear();
+    compileNode(df, leaf);
+
+    // run() and runColumns() trust the program, so if a filter that isn't
+    // well typed has got this far it would run off their stacks, it is false instead
+    if (!checkStacks()) {
+        clear();
+        add(Number, 0, 0);
+    }
+
+    // the stacks can't be any deeper than the program is long
+    numbers.resize(program.count() + 1);
+    strings.resize(program.count() + 1);
+}
+
+// every instruction must have the operands it pops, an and/or must
+// leave the same depth whether it jumps or not, and the program
+// must leave just the one number
+bool DataFilterProgram::checkStacks() const
+{
+    int n=0, s=0; // stack depths
+    QVector<int> jumped(program.count(), 0); // depth left by an and/or that jumps
+
+    for (int pc=0; pc<program.count(); pc++) {
+
+        const Instruction &i = program[pc];
+        switch (i.op) {
+
+        case Number :
+        case Metric :
+        case Value : n++; break;
+
+        case Text :
+        case String : s++; break;
+
+        case Best :
+        case Tiz :
+            if (i.slot < 0 && n < 1) return false; // pops the duration
+            if (i.slot >= 0) n++;
+            break;
+
+        case And :
+        case Or :
+            if (n < 1) return false;
+            jumped[pc] = n--;
+            break;
+
+        case Bool :
+            if (n < 1 || i.arg < 0 || i.arg >= pc || jumped[i.arg] != n) return false;
+            break;
+
+        default:
+            if (i.op >= StringEq && i.op <= StringZero) {
+                if (s < 2) return false;
+                s -= 2;
+                n++;
+            } else {
+                if (n < 2) return false; // numbers
+                n--;
+            }
+            break;
+        }
+    }
+    return n == 1 && s == 0;
+}
+
+void DataFilterProgram::compileNode(DataFilter *df, Leaf *leaf)
+{
+    switch(leaf->type) {
+
+    case Leaf::Logical :
+    {
+        switch (leaf->op) {
+            case AND :
+            case OR :
+            {
+                compileNode(df, leaf->lvalue.l);
+                int jump = add(leaf->op == AND ? And : Or);
+                compileNode(df, leaf->rvalue.l);
+                add(Bool, jump);
+                program[jump].arg = program.count();
+            }
+            break;
+
+            default : // parenthesis
+                compileNode(df, leaf->lvalue.l);
+                break;
+        }
+    }
+    break;
+
+    case Leaf::Function :
+    {
+        Leaf *duration = leaf->lvalue.l;
+        opcode op = leaf->function == "best" ? Best : Tiz; // only best and tiz will parse
+
+        // constant durations are looked up in bulk by prepare()
+        bool constant = true;
+        double number = 0;
+        switch (duration->type) {
+            case Leaf::Float : number = duration->lvalue.f; break;
+            case Leaf::Integer : number = duration->lvalue.i; break;
+            case Leaf::String : number = duration->lvalue.s->toDouble(); break;
+            case Leaf::Symbol :
+                if (df->lookupType.value(*(duration->lvalue.n)) == true) {
+                    compileValue(df, duration, true);
+                    constant = false;
+                }
+                break;
+            default:
+                compileNode(df, duration);
+                constant = false;
+                break;
+        }
+
+        int function = add(op, leaf->seriesType, number);
+        if (constant) program[function].slot = slots++;
+    }
+    break;
+
+    case Leaf::BinaryOperation :
+    case Leaf::Operation :
+    {
+        // the lhs decides if it is a numeric or string operation
+        // (validateFilter has already checked the rhs is the same)
+        bool numeric = leaf->isNumber(df, leaf->lvalue.l);
+
+        compileValue(df, leaf->lvalue.l, true);
+        compileValue(df, leaf->rvalue.l, false);
+
+        if (numeric) {
+            switch (leaf->op) {
+            case ADD : add(Add); break;
+            case SUBTRACT : add(Subtract); break;
+            case DIVIDE : add(Divide); break;
+            case MULTIPLY : add(Multiply); break;
+            case POW : add(Pow); break;
+            case EQ : add(Eq); break;
+            case NEQ : add(Neq); break;
+            case LT : add(Lt); break;
+            case LTE : add(Lte); break;
+            case GT : add(Gt); break;
+            default:
+            case GTE : add(Gte); break;
+            }
+        } else {
+            switch (leaf->op) {
+            case EQ : add(StringEq); break;
+            case NEQ : add(StringNeq); break;
+            case LT : add(StringLt); break;
+            case LTE : add(StringLte); break;
+            case GT : add(StringGt); break;
+            case GTE : add(StringGte); break;
+            case ENDSWITH : add(EndsWith); break;
+            case BEGINSWITH : add(BeginsWith); break;
+            case CONTAINS : add(Contains); break;
+            case MATCHES :
+                {
+                    int matches = add(Matches);
+                    if (leaf->rvalue.l->type == Leaf::String)
+                        program[matches].regexp = QRegExp(*(leaf->rvalue.l->lvalue.s));
+                }
+                break;
+            default: add(StringZero); break; // arithmetic on strings
+            }
+        }
+    }
+    break;
+
+    default: // a value on its own is false
+        add(Number, 0, 0);
+        break;
+    }
+}
+
+void DataFilterProgram::compileValue(DataFilter *df, Leaf *leaf, bool lhs)
+{
+    switch (leaf->type) {
+
+        case Leaf::Symbol :
+        {
+            QString symbol = df->lookupMap.value(*(leaf->lvalue.n),"");
+
+            if (df->lookupType.value(*(leaf->lvalue.n)) == true) {
+                // numeric, ride metrics by id
+                int id = RideMetricFactory::instance().metricId(symbol);
+                if (id >= 0) add(Metric, id);
+                else add(Value, 0, 0, symbol);
+            } else {
+                // string
+                add(Text, lhs ? 0 : 1, 0, symbol);
+            }
+        }
+        break;
+
+        case Leaf::Float :
+            add(Number, 0, leaf->lvalue.f);
+            break;
+
+        case Leaf::Integer :
+            add(Number, 0, leaf->lvalue.i);
+            break;
+
+        case Leaf::String :
+            add(String, 0, 0, *(leaf->lvalue.s));
+            break;
+
+        default:
+            compileNode(df, leaf);
+            break;
+    }
+}
+
+void DataFilterProgram::prepare(Context *context, const QStringList &fileNames)
+{
+    prepared.resize(slots);
+
+    foreach (const Instruction &i, program) {
+        if (i.slot < 0) continue;
+
+        if (i.op == Best) {
+            prepared[i.slot] = RideFileCache::best(context, fileNames, (RideFile::SeriesType) i.arg, i.number);
+        } else {
+            QVector<int> tiz = RideFileCache::tiz(context, fileNames, (RideFile::SeriesType) i.arg, i.number);
+            prepared[i.slot].resize(tiz.count());
+            for (int j=0; j<tiz.count(); j++) prepared[i.slot][j] = tiz[j];
+        }
+    }
+}
+
+double DataFilterProgram::run(Context *context, const SummaryMetrics &m, int ride, const QString &fileName)
+{
+    int n=0, s=0; // stack pointers
+
+    for (int pc=0; pc<program.count(); pc++) {
+
+        Instruction &i = program[pc];
+        switch (i.op) {
+
+        case Number : numbers[n++] = i.number; break;
+        case Metric : numbers[n++] = m.getForMetric(i.arg); break;
+        case Value : numbers[n++] = m.getForSymbol(i.text); break;
+        case Text : strings[s++] = m.getText(i.text, i.arg ? "notfound" : ""); break;
+        case String : strings[s++] = i.text; break;
+
+        case Best :
+        case Tiz :
+        {
+            double duration = i.slot >= 0 ? i.number : numbers[--n];
+
+            if (i.slot >= 0 && ride < prepared.value(i.slot).count())
+                numbers[n++] = prepared[i.slot][ride];
+            else if (i.op == Best)
+                numbers[n++] = RideFileCache::best(context, fileName, (RideFile::SeriesType) i.arg, duration);
+            else
+                numbers[n++] = RideFileCache::tiz(context, fileName, (RideFile::SeriesType) i.arg, duration);
+        }
+        break;
+
+        case Add : n--; numbers[n-1] = numbers[n-1] + numbers[n]; break;
+        case Subtract : n--; numbers[n-1] = numbers[n-1] - numbers[n]; break;
+        case Multiply : n--; numbers[n-1] = numbers[n-1] * numbers[n]; break;
+        case Divide : n--; numbers[n-1] = numbers[n] ? numbers[n-1] / numbers[n] : 0; break; // avoid divide by zero
+        case Pow : n--; numbers[n-1] = numbers[n] ? pow(numbers[n-1], numbers[n]) : 0; break;
+        case Eq : n--; numbers[n-1] = numbers[n-1] == numbers[n]; break;
+        case Neq : n--; numbers[n-1] = numbers[n-1] != numbers[n]; break;
+        case Lt : n--; numbers[n-1] = numbers[n-1] < numbers[n]; break;
+        case Lte : n--; numbers[n-1] = numbers[n-1] <= numbers[n]; break;
+        case Gt : n--; numbers[n-1] = numbers[n-1] > numbers[n]; break;
+        case Gte : n--; numbers[n-1] = numbers[n-1] >= numbers[n]; break;
+
+        case StringEq : s-=2; numbers[n++] = strings[s] == strings[s+1]; break;
+        case StringNeq : s-=2; numbers[n++] = strings[s] != strings[s+1]; break;
+        case StringLt : s-=2; numbers[n++] = strings[s] < strings[s+1]; break;
+        case StringLte : s-=2; numbers[n++] = strings[s] <= strings[s+1]; break;
+        case StringGt : s-=2; numbers[n++] = strings[s] > strings[s+1]; break;
+        case StringGte : s-=2; numbers[n++] = strings[s] >= strings[s+1]; break;
+        case EndsWith : s-=2; numbers[n++] = strings[s].endsWith(strings[s+1]); break;
+        case BeginsWith : s-=2; numbers[n++] = strings[s].startsWith(strings[s+1]); break;
+        case Contains : s-=2; numbers[n++] = strings[s].contains(strings[s+1]); break;
+        case StringZero : s-=2; numbers[n++] = 0; break;
+        case Matches :
+            s-=2;
+            if (i.regexp.isEmpty()) numbers[n++] = QRegExp(strings[s+1]).exactMatch(strings[s]);
+            else numbers[n++] = i.regexp.exactMatch(strings[s]);
+            break;
+
+        case And :
+            if (numbers[--n] == 0) {
+                numbers[n++] = 0;
+                pc = i.arg - 1;
+            }
+            break;
+
+        case Or :
+            if (numbers[--n] != 0) {
+                numbers[n++] = 1;
+                pc = i.arg - 1;
+            }
+            break;
+
+        case Bool : numbers[n-1] = numbers[n-1] ? 1 : 0; break;
+        }
+    }
+    return n ? numbers[n-1] : 0;
+}
+
+//
+// COLUMN-WISE
+//
+// The loops over number columns are kept simple so the compiler
+// can vectorise them; comparisons leave 1 or 0 in the column
+// and are only packed into bits at the end.
+//
+bool DataFilterProgram::runColumns(const MetricStore &store, QBitArray &results)
+{
+    int count = store.count();
+    const RideMetricFactory &factory = RideMetricFactory::instance();
+    static const QString empty(""), notfound("notfound");
+
+    // can't do best() or tiz() with a ride dependent argument
+    foreach (const Instruction &i, program)
+        if ((i.op == Best || i.op == Tiz) && i.slot < 0) return false;
+
+    if (numberColumns.count() < numbers.count()) numberColumns.resize(numbers.count());
+    if (stringColumns.count() < strings.count()) stringColumns.resize(strings.count());
+
+    int n=0, s=0; // stack pointers
+
+    for (int pc=0; pc<program.count(); pc++) {
+
+        const Instruction &i = program[pc];
+
+        // pushing a number column
+        if (i.op == Number || i.op == Metric || i.op == Value || i.op == Best || i.op == Tiz) {
+
+            QVector<double> &to = numberColumns[n++];
+            to.resize(count);
+
+            const QVector<double> *from = NULL;
+            switch (i.op) {
+            case Metric : from = store.column(factory.metricName(i.arg)); break;
+            case Value : from = store.column(i.text); break;
+            case Best :
+            case Tiz : from = &prepared[i.slot]; break;
+            default : break;
+            }
+
+            if (from && from->count() == count) to = *from;
+            else to.fill(i.op == Number ? i.number : 0);
+            continue;
+        }
+
+        // pushing a string column
+        if (i.op == Text || i.op == String) {
+
+            StringColumn &to = stringColumns[s++];
+            const QVector<QString> *from = i.op == Text ? store.textColumn(i.text) : NULL;
+
+            if (from) {
+                to.data = from->constData();
+                to.stride = 1;
+            } else {
+                to.data = i.op == String ? &i.text : (i.arg ? &notfound : &empty);
+                to.stride = 0;
+            }
+            continue;
+        }
+
+        // the jumps are only for short-circuiting, all rows have both sides
+        if (i.op == And || i.op == Or) continue;
+
+        if (i.op == Bool) {
+            double *a = numberColumns[n-2].data();
+            const double *b = numberColumns[n-1].constData();
+            if (program[i.arg].op == And) for (int j=0; j<count; j++) a[j] = (a[j] != 0) & (b[j] != 0);
+            else for (int j=0; j<count; j++) a[j] = (a[j] != 0) | (b[j] != 0);
+            n--;
+            continue;
+        }
+
+        // string operations leave a number column
+        if (i.op >= StringEq && i.op <= StringZero) {
+
+            s -= 2;
+            const StringColumn &l = stringColumns[s];
+            const StringColumn &r = stringColumns[s+1];
+            QVector<double> &to = numberColumns[n++];
+            to.resize(count);
+            double *a = to.data();
+
+            for (int j=0; j<count; j++) {
+                const QString &lhs = l.data[j * l.stride];
+                const QString &rhs = r.data[j * r.stride];
+
+                switch (i.op) {
+                case StringEq : a[j] = lhs == rhs; break;
+                case StringNeq : a[j] = lhs != rhs; break;
+                case StringLt : a[j] = lhs < rhs; break;
+                case StringLte : a[j] = lhs <= rhs; break;
+                case StringGt : a[j] = lhs > rhs; break;
+                case StringGte : a[j] = lhs >= rhs; break;
+                case EndsWith : a[j] = lhs.endsWith(rhs); break;
+                case BeginsWith : a[j] = lhs.startsWith(rhs); break;
+                case Contains : a[j] = lhs.contains(rhs); break;
+                case Matches :
+                    if (i.regexp.isEmpty()) a[j] = QRegExp(rhs).exactMatch(lhs);
+                    else a[j] = i.regexp.exactMatch(lhs);
+                    break;
+                default: a[j] = 0; break;
+                }
+            }
+            continue;
+        }
+
+        // number operations, in place on the lhs
+        n--;
+        double *a = numberColumns[n-1].data();
+        const double *b = numberColumns[n].constData();
+
+        switch (i.op) {
+        case Add : for (int j=0; j<count; j++) a[j] = a[j] + b[j]; break;
+        case Subtract : for (int j=0; j<count; j++) a[j] = a[j] - b[j]; break;
+        case Multiply : for (int j=0; j<count; j++) a[j] = a[j] * b[j]; break;
+        case Divide : for (int j=0; j<count; j++) a[j] = b[j] ? a[j] / b[j] : 0; break;
+        case Pow : for (int j=0; j<count; j++) a[j] = b[j] ? pow(a[j], b[j]) : 0; break;
+        case Eq : for (int j=0; j<count; j++) a[j] = a[j] == b[j]; break;
+        case Neq : for (int j=0; j<count; j++) a[j] = a[j] != b[j]; break;
+        case Lt : for (int j=0; j<count; j++) a[j] = a[j] < b[j]; break;
+        case Lte : for (int j=0; j<count; j++) a[j] = a[j] <= b[j]; break;
+        case Gt : for (int j=0; j<count; j++) a[j] = a[j] > b[j]; break;
+        case Gte : for (int j=0; j<count; j++) a[j] = a[j] >= b[j]; break;
+        default: break;
+        }
+    }
+
+    // and finally pack into bits
+    results.fill(false, count);
+    if (n) {
+        const double *a = numberColumns[n-1].constData();
+        for (int j=0; j<count; j++) if (a[j]) results.setBit(j);
+    }
+    return true;
+}
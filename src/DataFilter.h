@@ -21,12 +21,16 @@
 #include <QDebug>
 #include <QList>
 #include <QStringList>
+#include <QVector>
+#include <QRegExp>
+#include <QBitArray>
 #include "RideFile.h" //for SeriesType
 
 class Context;
 class RideMetric;
 class FieldDefinition;
 class SummaryMetrics;
+class MetricStore;
 class DataFilter;
 
 class Leaf {
@@ -36,7 +40,7 @@ class Leaf {
         Leaf() : type(none),op(0),series(NULL) { }
 
         // evaluate against a SummaryMetric
-        double eval(DataFilter *df, Leaf *, SummaryMetrics, QString filename);
+        double eval(DataFilter *df, Leaf *, const SummaryMetrics &, QString filename);
 
         // tree traversal etc
         void print(Leaf *, int level);  // print leaf and all children
@@ -58,6 +62,82 @@ class Leaf {
         RideFile::SeriesType seriesType; // for ridefilecache
 };
 
+// The parsed tree is compiled into a flat program with the symbols
+// looked up and the functions resolved, which is then run for each
+// ride. It is a simple stack machine, numbers and strings are kept on
+// separate stacks since the type of every node is known when compiling.
+//
+// It can also be run over the columns of the MetricStore, evaluating
+// each instruction for all of the rides at once, which is much quicker
+// when there are lots of rides since the loops are vectorised.
+class DataFilterProgram
+{
+    public:
+        enum opcode {
+            // push a value
+            Number, Metric, Value, Text, String, Best, Tiz,
+
+            // numbers
+            Add, Subtract, Divide, Multiply, Pow,
+            Eq, Neq, Lt, Lte, Gt, Gte,
+
+            // strings
+            StringEq, StringNeq, StringLt, StringLte, StringGt, StringGte,
+            Matches, EndsWith, BeginsWith, Contains, StringZero,
+
+            // logical, jump with the result if it is decided by the lhs
+            And, Or, Bool
+        };
+
+        struct Instruction {
+            opcode op;
+            int arg;        // metric id, series, jump target or text fallback
+            int slot;       // prepared values for best() and tiz(), or -1
+            double number;
+            QString text;
+            QRegExp regexp; // for matches with a constant pattern
+        };
+
+        DataFilterProgram() : slots(0) {}
+
+        void compile(DataFilter *df, Leaf *leaf);
+        void clear() { program.clear(); prepared.clear(); slots = 0; }
+
+        // lookup best() and tiz() with constant arguments for all
+        // of the rides at once, before calling run() for each of them
+        void prepare(Context *context, const QStringList &fileNames);
+
+        // evaluate for the ride'th ride (as passed to prepare)
+        double run(Context *context, const SummaryMetrics &m, int ride, const QString &fileName);
+
+        // evaluate for every ride in the store (as passed to prepare) setting
+        // a bit for each that passes, false if it can't be done column-wise
+        bool runColumns(const MetricStore &store, QBitArray &results);
+
+    private:
+        void compileNode(DataFilter *df, Leaf *leaf);
+        bool checkStacks() const; // can't underflow and leaves one number
+        void compileValue(DataFilter *df, Leaf *leaf, bool lhs);
+        int add(opcode op, int arg=0, double number=0, QString text=QString());
+
+        QVector<Instruction> program;
+        QVector<QVector<double> > prepared;
+        int slots;
+
+        // working storage
+        QVector<double> numbers;
+        QVector<QString> strings;
+
+        // and when running column-wise, a string column is either
+        // a text column in the store or a constant (stride 0)
+        struct StringColumn {
+            const QString *data;
+            int stride;
+        };
+        QVector<QVector<double> > numberColumns;
+        QVector<StringColumn> stringColumns;
+};
+
 class DataFilter : public QObject
 {
     Q_OBJECT
@@ -87,6 +167,7 @@ class DataFilter : public QObject
 
     private:
         Leaf *treeRoot;
+        DataFilterProgram program;
         QStringList errors;
 
         QStringList filenames;
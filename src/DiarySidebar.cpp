@@ -341,7 +341,7 @@ DiarySidebar::setSummary()
 
                 const RideMetric *metric = RideMetricFactory::instance().rideMetric(metricname);
 
-                QStringList empty; // usually for filters, but we don't do that
+                RideSet empty; // usually for filters, but we don't do that
                 QString value = SummaryMetrics::getAggregated(context, metricname, results, empty, false, useMetricUnits);
 
 
@@ -727,7 +727,7 @@ GcMiniCalendar::clearRide()
 }
 
 void
-GcMiniCalendar::setFilter(QStringList filter)
+GcMiniCalendar::setFilter(const RideSet &filter)
 {
     filters = filter;
 }
@@ -838,7 +838,7 @@ GcMultiCalendar::filterChanged()
 }
 
 void
-GcMultiCalendar::setFilter(QStringList filter)
+GcMultiCalendar::setFilter(const RideSet &filter)
 {
     this->filters = filter;
 
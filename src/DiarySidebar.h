@@ -82,7 +82,7 @@ class GcMiniCalendar : public QWidget
         void getDate(int &_month, int &_year) { _month = month; _year = year; }
         void clearRide();
 
-        void setFilter(QStringList filter);
+        void setFilter(const RideSet &filter);
         void clearFilter();
 
     public slots:
@@ -119,7 +119,7 @@ class GcMiniCalendar : public QWidget
         GcCalendarModel *calendarModel;
         bool master;
 
-        QStringList filters;
+        RideSet filters;
 };
 
 class GcMultiCalendar : public QScrollArea
@@ -136,7 +136,7 @@ class GcMultiCalendar : public QScrollArea
         void setRide(RideItem *ride);
         void resizeEvent(QResizeEvent*);
         void filterChanged();
-        void setFilter(QStringList filter);
+        void setFilter(const RideSet &filter);
         void clearFilter();
         void showEvent(QShowEvent*);
 
@@ -146,7 +146,7 @@ class GcMultiCalendar : public QScrollArea
         QVector<GcMiniCalendar*> calendars;
         Context *context;
         int showing;
-        QStringList filters;
+        RideSet filters;
         bool active;
         bool stale; // we need to redraw when shown
         RideItem *_ride;
@@ -39,11 +39,16 @@ struct FitField {
     int num;
     int type; // FIT base_type
     int size; // in bytes
+    int offset; // from the start of the data message
+    bool known; // a base type we can decode
 };
 
+// the fields are laid out when the definition is read
+// so each data message is decoded straight from the buffer
 struct FitDefinition {
     int global_msg_num;
     bool is_big_endian;
+    int size; // of the data message, in bytes
     std::vector<FitField> fields;
 };
 
@@ -77,136 +82,89 @@ struct FitFileReaderState
     FitFileReaderState(QFile &file, QStringList &errors) :
         file(file), errors(errors), rideFile(NULL), start_time(0),
         last_time(0), last_distance(0.00f), interval(0), calibration(0), devices(0), stopped(true),
-        last_event_type(-1), last_event(-1), last_msg_type(-1)
+        last_event_type(-1), last_event(-1), last_msg_type(-1), data(NULL), pos(0)
     {
     }
 
     struct TruncatedRead {};
 
-    void read_unknown( int size, int *count = NULL ){
-        char c[size+1];
+    // the whole file is read in one go and decoded from memory
+    QByteArray buffer;
+    const uchar *data;
+    int pos;
 
-        if (file.read(c, size ) != size)
-            throw TruncatedRead();
-        if (count)
-            (*count) += size;
-    }
-
-    fit_value_t read_int8(int *count = NULL) {
-        qint8 i;
-        if (file.read(reinterpret_cast<char*>( &i), 1) != 1)
-            throw TruncatedRead();
-        if (count)
-            (*count) += 1;
-
-        return i == 0x7f ? NA_VALUE : i;
-    }
-
-    fit_value_t read_uint8(int *count = NULL) {
-        quint8 i;
-        if (file.read(reinterpret_cast<char*>( &i), 1) != 1)
-            throw TruncatedRead();
-        if (count)
-            (*count) += 1;
-
-        return i == 0xff ? NA_VALUE : i;
-    }
-
-    fit_value_t read_uint8z(int *count = NULL) {
-        quint8 i;
-        if (file.read(reinterpret_cast<char*>( &i), 1) != 1)
-            throw TruncatedRead();
-        if (count)
-            (*count) += 1;
-
-        return i == 0x00 ? NA_VALUE : i;
-    }
-
-    fit_value_t read_int16(bool is_big_endian, int *count = NULL) {
-        qint16 i;
-        if (file.read(reinterpret_cast<char*>(&i), 2) != 2)
-            throw TruncatedRead();
-        if (count)
-            (*count) += 2;
-
-        i = is_big_endian
-            ? qFromBigEndian<qint16>( i )
-            : qFromLittleEndian<qint16>( i );
-
-        return i == 0x7fff ? NA_VALUE : i;
-    }
+    // values of the data message being decoded, one per field
+    fit_value_t values[256];
 
-    fit_value_t read_uint16(bool is_big_endian, int *count = NULL) {
-        quint16 i;
-        if (file.read(reinterpret_cast<char*>(&i), 2) != 2)
+    const uchar *take(int size) {
+        if (size < 0 || pos + size > buffer.size())
             throw TruncatedRead();
-        if (count)
-            (*count) += 2;
-
-        i = is_big_endian
-            ? qFromBigEndian<quint16>( i )
-            : qFromLittleEndian<quint16>( i );
-
-        return i == 0xffff ? NA_VALUE : i;
+        const uchar *p = data + pos;
+        pos += size;
+        return p;
     }
 
-    fit_value_t read_uint16z(bool is_big_endian, int *count = NULL) {
-        quint16 i;
-        if (file.read(reinterpret_cast<char*>(&i), 2) != 2)
-            throw TruncatedRead();
-        if (count)
-            (*count) += 2;
-
-        i = is_big_endian
-            ? qFromBigEndian<quint16>( i )
-            : qFromLittleEndian<quint16>( i );
-
-        return i == 0x0000 ? NA_VALUE : i;
-    }
-
-    fit_value_t read_int32(bool is_big_endian, int *count = NULL) {
-        qint32 i;
-        if (file.read(reinterpret_cast<char*>(&i), 4) != 4)
-            throw TruncatedRead();
-        if (count)
-            (*count) += 4;
-
-        i = is_big_endian
-            ? qFromBigEndian<qint32>( i )
-            : qFromLittleEndian<qint32>( i );
-
-        return i == 0x7fffffff ? NA_VALUE : i;
+    // bytes for each base type, 0 if we don't decode it
+    static int typeSize(int type) {
+        switch (type) {
+            case 0: case 1: case 2: case 10: return 1;
+            case 3: case 4: case 11: return 2;
+            case 5: case 6: case 12: return 4;
+            // we may need to add support for float, string + byte base types here
+            default: return 0;
+        }
     }
 
-    fit_value_t read_uint32(bool is_big_endian, int *count = NULL) {
-        quint32 i;
-        if (file.read(reinterpret_cast<char*>(&i), 4) != 4)
-            throw TruncatedRead();
-        if (count)
-            (*count) += 4;
-
-        i = is_big_endian
-            ? qFromBigEndian<quint32>( i )
-            : qFromLittleEndian<quint32>( i );
-
-        return i == 0xffffffff ? NA_VALUE : i;
+    // invalid values are returned as NA_VALUE
+    static fit_value_t decode(const uchar *p, int type, bool is_big_endian) {
+        switch (type) {
+            case 0:
+            case 2: {
+                quint8 i = p[0];
+                return i == 0xff ? NA_VALUE : i;
+            }
+            case 1: {
+                qint8 i = p[0];
+                return i == 0x7f ? NA_VALUE : i;
+            }
+            case 10: {
+                quint8 i = p[0];
+                return i == 0x00 ? NA_VALUE : i;
+            }
+            case 3: {
+                qint16 i = is_big_endian ? qFromBigEndian<qint16>(p) : qFromLittleEndian<qint16>(p);
+                return i == 0x7fff ? NA_VALUE : i;
+            }
+            case 4: {
+                quint16 i = is_big_endian ? qFromBigEndian<quint16>(p) : qFromLittleEndian<quint16>(p);
+                return i == 0xffff ? NA_VALUE : i;
+            }
+            case 11: {
+                quint16 i = is_big_endian ? qFromBigEndian<quint16>(p) : qFromLittleEndian<quint16>(p);
+                return i == 0x0000 ? NA_VALUE : i;
+            }
+            case 5: {
+                qint32 i = is_big_endian ? qFromBigEndian<qint32>(p) : qFromLittleEndian<qint32>(p);
+                return i == 0x7fffffff ? NA_VALUE : i;
+            }
+            case 6: {
+                quint32 i = is_big_endian ? qFromBigEndian<quint32>(p) : qFromLittleEndian<quint32>(p);
+                return i == 0xffffffff ? NA_VALUE : i;
+            }
+            case 12: {
+                quint32 i = is_big_endian ? qFromBigEndian<quint32>(p) : qFromLittleEndian<quint32>(p);
+                return i == 0x00000000 ? NA_VALUE : i;
+            }
+            default:
+                return NA_VALUE;
+        }
     }
 
-    fit_value_t read_uint32z(bool is_big_endian, int *count = NULL) {
-        quint32 i;
-        if (file.read(reinterpret_cast<char*>(&i), 4) != 4)
-            throw TruncatedRead();
-        if (count)
-            (*count) += 4;
-
-        i = is_big_endian
-            ? qFromBigEndian<quint32>( i )
-            : qFromLittleEndian<quint32>( i );
+    fit_value_t read_uint8() { return decode(take(1), 2, false); }
+    fit_value_t read_uint16(bool is_big_endian) { return decode(take(2), 4, is_big_endian); }
+    fit_value_t read_uint32(bool is_big_endian) { return decode(take(4), 6, is_big_endian); }
 
-        return i == 0x00000000 ? NA_VALUE : i;
-    }
-
-    void decodeFileId(const FitDefinition &def, int, const std::vector<fit_value_t> values) {
+    void decodeFileId(const FitDefinition &def, int, const fit_value_t *values) {
         int i = 0;
         int manu = -1, prod = -1;
         foreach(const FitField &field, def.fields) {
@@ -250,7 +208,7 @@ struct FitFileReaderState
         rideFile->setFileFormat("FIT (*.fit)");
     }
 
-    void decodeEvent(const FitDefinition &def, int, const std::vector<fit_value_t> values) {
+    void decodeEvent(const FitDefinition &def, int, const fit_value_t *values) {
         int time = -1;
         int event = -1;
         int event_type = -1;
@@ -320,7 +278,7 @@ struct FitFileReaderState
         last_event_type = event_type;
     }
 
-    void decodeLap(const FitDefinition &def, int time_offset, const std::vector<fit_value_t> values) {
+    void decodeLap(const FitDefinition &def, int time_offset, const fit_value_t *values) {
         time_t time = 0;
         if (time_offset > 0)
             time = last_time + time_offset;
@@ -355,7 +313,7 @@ struct FitFileReaderState
             rideFile->addInterval(this_start_time - start_time, time - start_time, QString("%1").arg(interval));
     }
 
-    void decodeRecord(const FitDefinition &def, int time_offset, const std::vector<fit_value_t> values) {
+    void decodeRecord(const FitDefinition &def, int time_offset, const fit_value_t *values) {
         time_t time = 0;
         if (time_offset > 0)
             time = last_time + time_offset;
@@ -503,8 +461,8 @@ struct FitFileReaderState
 
     int read_record(bool &stop, QStringList &errors) {
         stop = false;
-        int count = 0;
-        int header_byte = read_uint8(&count);
+        int begin = pos;
+        int header_byte = read_uint8();
         if (!(header_byte & 0x80) && (header_byte & 0x40)) {
             // Definition record
             int local_msg_type = header_byte & 0xf;
@@ -512,22 +470,31 @@ struct FitFileReaderState
             local_msg_types.insert(local_msg_type, FitDefinition());
             FitDefinition &def = local_msg_types[local_msg_type];
 
-            int reserved = read_uint8(&count); (void) reserved; // unused
-            def.is_big_endian = read_uint8(&count);
-            def.global_msg_num = read_uint16(def.is_big_endian, &count);
-            int num_fields = read_uint8(&count);
+            const uchar *p = take(5);
+            // p[0] is reserved
+            def.is_big_endian = p[1];
+            def.global_msg_num = decode(p + 2, 4, def.is_big_endian);
+            int num_fields = p[4];
             //printf("definition: local type=%d global=%d arch=%d fields=%d\n",
             //       local_msg_type, def.global_msg_num, def.is_big_endian,
             //       num_fields );
 
-            for (int i = 0; i < num_fields; ++i) {
+            def.size = 0;
+            p = take(num_fields * 3);
+            for (int i = 0; i < num_fields; ++i, p += 3) {
                 def.fields.push_back(FitField());
                 FitField &field = def.fields.back();
 
-                field.num = read_uint8(&count);
-                field.size = read_uint8(&count);
-                int base_type = read_uint8(&count);
-                field.type = base_type & 0x1f;
+                field.num = p[0];
+                field.size = p[1];
+                field.type = p[2] & 0x1f;
+                field.offset = def.size;
+                def.size += field.size;
+
+                // arrays are decoded as their first element
+                int size = typeSize(field.type);
+                field.known = size && size <= field.size;
+                if (!field.known) unknown_base_type.insert(field.num);
                 //printf("  field %d: %d bytes, num %d, type %d\n",
                 //       i, field.size, field.num, field.type );
             }
@@ -548,35 +515,18 @@ struct FitFileReaderState
             if (!local_msg_types.contains(local_msg_type)) {
                 errors << QString("local type %1 without previous definition").arg(local_msg_type);
                 stop = true;
-                return count;
+                return pos - begin;
             }
             const FitDefinition &def = local_msg_types[local_msg_type];
             //printf( "message local=%d global=%d\n", local_msg_type,
             //    def.global_msg_num );
 
-            std::vector<fit_value_t> values;
+            const uchar *message = take(def.size);
+            int i = 0;
             foreach(const FitField &field, def.fields) {
-                fit_value_t v;
-                switch (field.type) {
-                    case 0: v = read_uint8(&count); break;
-                    case 1: v = read_int8(&count); break;
-                    case 2: v = read_uint8(&count); break;
-                    case 3: v = read_int16(def.is_big_endian, &count); break;
-                    case 4: v = read_uint16(def.is_big_endian, &count); break;
-                    case 5: v = read_int32(def.is_big_endian, &count); break;
-                    case 6: v = read_uint32(def.is_big_endian, &count); break;
-                    case 10: v = read_uint8z(&count); break;
-                    case 11: v = read_uint16z(def.is_big_endian, &count); break;
-                    case 12: v = read_uint32z(def.is_big_endian, &count); break;
-                    // we may need to add support for float, string + byte base types here
-                    default:
-                        read_unknown( field.size, &count );
-                        v = NA_VALUE;
-                        unknown_base_type.insert(field.num);
-                }
-                values.push_back(v);
+                values[i++] = field.known ? decode(message + field.offset, field.type, def.is_big_endian) : NA_VALUE;
                 //printf( " field: type=%d num=%d value=%lld\n",
-                //    field.type, field.num, v );
+                //    field.type, field.num, values[i-1] );
             }
             // Most of the record types in the FIT format aren't actually all
             // that useful.  FileId, Lap, and Record clearly are.  The one
@@ -601,7 +551,7 @@ struct FitFileReaderState
             }
             last_msg_type = def.global_msg_num;
         }
-        return count;
+        return pos - begin;
     }
 
     RideFile * run() {
@@ -612,10 +562,19 @@ struct FitFileReaderState
             delete rideFile;
             return NULL;
         }
+        buffer = file.readAll();
+        file.close();
+        data = reinterpret_cast<const uchar*>(buffer.constData());
+        pos = 0;
+
+        if (buffer.size() < 12) {
+            errors << "truncated header";
+            delete rideFile;
+            return NULL;
+        }
         int header_size = read_uint8();
         if (header_size != 12 && header_size != 14) {
             errors << QString("bad header size: %1").arg(header_size);
-            file.close();
             delete rideFile;
             return NULL;
         }
@@ -628,23 +587,22 @@ struct FitFileReaderState
         (void) profile_version; // not sure what to do with this
 
         int data_size = read_uint32(false); // always littleEndian
-        char fit_str[5];
-        if (file.read(fit_str, 4) != 4) {
-            errors << "truncated header";
-            file.close();
-            delete rideFile;
-            return NULL;
-        }
-        fit_str[4] = '\0';
-        if (strcmp(fit_str, ".FIT") != 0) {
-            errors << QString("bad header, expected \".FIT\" but got \"%1\"").arg(fit_str);
-            file.close();
+        QByteArray fit_str(reinterpret_cast<const char*>(take(4)), 4);
+        if (fit_str != ".FIT") {
+            errors << QString("bad header, expected \".FIT\" but got \"%1\"").arg(QString(fit_str));
             delete rideFile;
             return NULL;
         }
 
         // read the rest of the header
-        if (header_size == 14) read_uint16(false);
+        if (header_size == 14) {
+            if (buffer.size() < 14) {
+                errors << "truncated header";
+                delete rideFile;
+                return NULL;
+            }
+            take(2);
+        }
 
         int bytes_read = 0;
         bool stop = false;
@@ -654,18 +612,15 @@ struct FitFileReaderState
         }
         catch (TruncatedRead &e) {
             errors << "truncated file body";
-            file.close();
             delete rideFile;
             return NULL;
         }
         if (stop) {
-            file.close();
             delete rideFile;
             return NULL;
         }
         else {
-            int crc = read_uint16( false ); // always littleEndian
-            (void) crc;
+            // the crc follows, but we don't check it
             foreach(int num, unknown_global_msg_nums)
                 qDebug() << QString("FitRideFile: unknown global message number %1; ignoring it").arg(num);
             foreach(int num, unknown_record_fields)
@@ -673,7 +628,6 @@ struct FitFileReaderState
             foreach(int num, unknown_base_type)
                 qDebug() << QString("FitRideFile: unknown base type %1; skipped").arg(num);
 
-            file.close();
             return rideFile;
         }
     }
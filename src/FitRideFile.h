@@ -25,6 +25,7 @@
 struct FitFileReader : public RideFileReader {
     virtual RideFile *openRideFile(QFile &file, QStringList &errors, QList<RideFile*>* = 0) const; 
     bool hasWrite() const { return false; }
+    bool isReentrant() const { return true; }
 };
 
 #endif // _FitRideFile_h
@@ -17,6 +17,7 @@
  */
 
 #include "GcRideFile.h"
+#include "XmlTokenizer.h"
 #include <algorithm> // for std::sort
 #include <QDomDocument>
 #include <QVector>
@@ -29,135 +30,171 @@ static int gcFileReaderRegistered =
     RideFileFactory::instance().registerReader(
         "gc", "GoldenCheetah XML", new GcFileReader());
 
+// the elements we look at
+struct GcTag {
+    enum { Attributes, Attribute, Override, Metric, Tags, Tag, Intervals, Interval,
+           Samples, Sample };
+};
+
 RideFile *
 GcFileReader::openRideFile(QFile &file, QStringList &errors, QList<RideFile*>*) const
 {
-    QDomDocument doc("GoldenCheetah");
     if (!file.open(QIODevice::ReadOnly)) {
         errors << "Could not open file.";
         return NULL;
     }
 
-    bool parsed = doc.setContent(&file);
-    file.close();
-    if (!parsed) {
-        errors << "Could not parse file.";
-        return NULL;
-    }
+    XmlTokenizer xml(&file);
+    xml.addTag("attributes", GcTag::Attributes);
+    xml.addTag("attribute", GcTag::Attribute);
+    xml.addTag("override", GcTag::Override);
+    xml.addTag("metric", GcTag::Metric);
+    xml.addTag("tags", GcTag::Tags);
+    xml.addTag("tag", GcTag::Tag);
+    xml.addTag("intervals", GcTag::Intervals);
+    xml.addTag("interval", GcTag::Interval);
+    xml.addTag("samples", GcTag::Samples);
+    xml.addTag("sample", GcTag::Sample);
 
     RideFile *rideFile = new RideFile();
-    QDomElement root = doc.documentElement();
-    QDomNode attributes = root.firstChildElement("attributes");
-
-    for (QDomElement attr = attributes.firstChildElement("attribute");
-         !attr.isNull(); attr = attr.nextSiblingElement("attribute")) {
-        QString key = attr.attribute("key");
-        QString value = attr.attribute("value");
-        if (key == "Device type")
-            rideFile->setDeviceType(value);
-        else if (key == "File Format")
-            rideFile->setFileFormat(value);
-        if (key == "Start time") {
-            // by default QDateTime is localtime - the source however is UTC
-            QDateTime aslocal = QDateTime::fromString(value, DATETIME_FORMAT);
-            // construct in UTC so we can honour the conversion to localtime
-            QDateTime asUTC = QDateTime(aslocal.date(), aslocal.time(), Qt::UTC);
-            // now set in localtime
-            rideFile->setStartTime(asUTC.toLocalTime());
-        }
-        if (key == "Identifier") {
-            rideFile->setId(value);
-        }
-    }
 
-    // read in metric overrides:
-    //  <override>
-    //    <metric name="skiba_bike_score" value="100"/>
-    //    <metric name="average_speed" secs="3600" km="30"/>
-    //  </override>
-
-    QDomNode overrides = root.firstChildElement("override");
-    if (!overrides.isNull()) {
-
-        for (QDomElement override = overrides.firstChildElement("metric");
-            !override.isNull();
-            override = override.nextSiblingElement("metric")) {
-
-            // setup the metric overrides QMap
-            QMap<QString, QString> bsm;
-
-            // for now only value is known to be maintained
-            bsm.insert("value", override.attribute("value"));
+    QVector<double> intervalStops; // used to set the interval number for each point
+    RideFileInterval add;          // used to add each named interval to RideFile
 
-            // insert into the rideFile overrides
-            rideFile->metricOverrides.insert(override.attribute("name"), bsm);
+    int parent = XmlTokenizer::Unknown; // element below the root we are in
+    int depth = 0;
+    bool parsed = true, hasSamples = false, recIntSet = false;
+
+    for (bool done = false; !done; ) {
+
+        switch (xml.next()) {
+
+        case XmlTokenizer::StartElement:
+            depth++;
+            if (depth == 2) {
+                parent = xml.tag();
+                if (parent == GcTag::Samples) hasSamples = true;
+                break;
+            }
+            if (depth != 3) break;
+
+            if (parent == GcTag::Attributes && xml.tag() == GcTag::Attribute) {
+
+                QString key = xml.attribute("key");
+                QString value = xml.attribute("value");
+                if (key == "Device type")
+                    rideFile->setDeviceType(value);
+                else if (key == "File Format")
+                    rideFile->setFileFormat(value);
+                if (key == "Start time") {
+                    // by default QDateTime is localtime - the source however is UTC
+                    QDateTime aslocal = QDateTime::fromString(value, DATETIME_FORMAT);
+                    // construct in UTC so we can honour the conversion to localtime
+                    QDateTime asUTC = QDateTime(aslocal.date(), aslocal.time(), Qt::UTC);
+                    // now set in localtime
+                    rideFile->setStartTime(asUTC.toLocalTime());
+                }
+                if (key == "Identifier") {
+                    rideFile->setId(value);
+                }
+
+            } else if (parent == GcTag::Override && xml.tag() == GcTag::Metric) {
+
+                // read in metric overrides:
+                //  <override>
+                //    <metric name="skiba_bike_score" value="100"/>
+                //    <metric name="average_speed" secs="3600" km="30"/>
+                //  </override>
+
+                // setup the metric overrides QMap
+                QMap<QString, QString> bsm;
+
+                // for now only value is known to be maintained
+                bsm.insert("value", xml.attribute("value"));
+
+                // insert into the rideFile overrides
+                rideFile->metricOverrides.insert(xml.attribute("name"), bsm);
+
+            } else if (parent == GcTag::Tags && xml.tag() == GcTag::Tag) {
+
+                // read in the name/value metadata pairs
+                rideFile->setTag(xml.attribute("name"), xml.attribute("value"));
+
+            } else if (parent == GcTag::Intervals && xml.tag() == GcTag::Interval) {
+
+                // record the stops for old-style datapoint interval numbering
+                double stop = xml.attributeNumber("stop");
+                intervalStops.append(stop);
+
+                // add a new interval to the new-style interval ranges
+                add.stop = stop;
+                add.start = xml.attributeNumber("start");
+                add.name = xml.attribute("name");
+                rideFile->addInterval(add.start, add.stop, add.name);
+
+            } else if (parent == GcTag::Samples && xml.tag() == GcTag::Sample) {
+
+                double secs, cad, hr, km, kph, nm, watts, alt, lon, lat;
+                double headwind = 0.0;
+                secs = xml.attributeNumber("secs");
+                cad = xml.attributeNumber("cad");
+                hr = xml.attributeNumber("hr");
+                km = xml.attributeNumber("km");
+                kph = xml.attributeNumber("kph");
+                nm = xml.attributeNumber("nm");
+                watts = xml.attributeNumber("watts");
+                alt = xml.attributeNumber("alt");
+                lon = xml.attributeNumber("lon");
+                lat = xml.attributeNumber("lat");
+
+                // interval numbers are set once all the intervals are known
+                rideFile->appendPoint(secs, cad, hr, km, kph, nm, watts, alt, lon, lat, headwind, 0.0, RideFile::noTemp, 0, 0);
+                if (!recIntSet) {
+                    rideFile->setRecIntSecs(xml.attributeNumber("len"));
+                    recIntSet = true;
+                }
+            }
+            break;
+
+        case XmlTokenizer::EndElement:
+            if (--depth == 1) parent = XmlTokenizer::Unknown;
+            break;
+
+        case XmlTokenizer::EndDocument:
+            done = true;
+            break;
+
+        case XmlTokenizer::Invalid:
+            done = true;
+            parsed = false;
+            break;
         }
     }
+    file.close();
 
-    // read in the name/value metadata pairs
-    QDomNode tags = root.firstChildElement("tags");
-    if (!tags.isNull()) {
+    if (!parsed) {
+        errors << "Could not parse file.";
+        delete rideFile;
+        return NULL;
+    }
 
-        for (QDomElement tag = tags.firstChildElement("tag");
-             !tag.isNull();
-             tag = tag.nextSiblingElement("tag")) {
+    if (!hasSamples) return rideFile; // manual file will have no samples
 
-            rideFile->setTag(tag.attribute("name"), tag.attribute("value"));
-        }
+    if (!recIntSet) {
+        errors << "no samples in ride file";
+        delete rideFile;
+        return NULL;
     }
 
-    QVector<double> intervalStops; // used to set the interval number for each point
-    RideFileInterval add;          // used to add each named interval to RideFile
-    QDomNode intervals = root.firstChildElement("intervals");
-    if (!intervals.isNull()) {
-        for (QDomElement interval = intervals.firstChildElement("interval");
-             !interval.isNull(); interval = interval.nextSiblingElement("interval")) {
-
-            // record the stops for old-style datapoint interval numbering
-            double stop = interval.attribute("stop").toDouble();
-            intervalStops.append(stop);
-
-            // add a new interval to the new-style interval ranges
-            add.stop = stop;
-            add.start = interval.attribute("start").toDouble();
-            add.name = interval.attribute("name");
-            rideFile->addInterval(add.start, add.stop, add.name);
-        }
-    }
+    // number the points by the interval they end in
     std::sort(intervalStops.begin(), intervalStops.end()); // just in case
     int interval = 0;
-
-    QDomElement samples = root.firstChildElement("samples");
-    if (samples.isNull()) return rideFile; // manual file will have no samples
-
-    bool recIntSet = false;
-    for (QDomElement sample = samples.firstChildElement("sample");
-         !sample.isNull(); sample = sample.nextSiblingElement("sample")) {
-        double secs, cad, hr, km, kph, nm, watts, alt, lon, lat;
-        double headwind = 0.0;
-        secs = sample.attribute("secs", "0.0").toDouble();
-        cad = sample.attribute("cad", "0.0").toDouble();
-        hr = sample.attribute("hr", "0.0").toDouble();
-        km = sample.attribute("km", "0.0").toDouble();
-        kph = sample.attribute("kph", "0.0").toDouble();
-        nm = sample.attribute("nm", "0.0").toDouble();
-        watts = sample.attribute("watts", "0.0").toDouble();
-        alt = sample.attribute("alt", "0.0").toDouble();
-        lon = sample.attribute("lon", "0.0").toDouble();
-        lat = sample.attribute("lat", "0.0").toDouble();
-        while ((interval < intervalStops.size()) && (secs >= intervalStops[interval]))
+    foreach (RideFilePoint *point, rideFile->dataPoints()) {
+        while ((interval < intervalStops.size()) && (point->secs >= intervalStops[interval]))
             ++interval;
-        rideFile->appendPoint(secs, cad, hr, km, kph, nm, watts, alt, lon, lat, headwind, 0.0, RideFile::noTemp, 0, interval);
-        if (!recIntSet) {
-            rideFile->setRecIntSecs(sample.attribute("len").toDouble());
-            recIntSet = true;
-        }
-    }
-
-    if (!recIntSet) {
-        errors << "no samples in ride file";
-        return NULL;
+        point->interval = interval;
     }
+    if (interval) rideFile->setDataPresent(RideFile::interval, true);
 
     return rideFile;
 }
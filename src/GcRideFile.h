@@ -26,6 +26,7 @@ struct GcFileReader : public RideFileReader {
     virtual RideFile *openRideFile(QFile &file, QStringList &errors, QList<RideFile*>* = 0) const; 
     bool writeRideFile(Context *, const RideFile *ride, QFile &file) const;
     bool hasWrite() const { return true; }
+    bool isReentrant() const { return true; }
 };
 
 #endif // _GcRideFile_h
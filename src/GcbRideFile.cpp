@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2026 GoldenCheetah Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "GcbRideFile.h"
+#include <QDataStream>
+#include <QtEndian>
+#include <string.h> // for memcmp/memcpy
+
+static int gcbFileReaderRegistered =
+    RideFileFactory::instance().registerReader(
+        "gcb", "GoldenCheetah Binary", new GcbFileReader());
+
+static const int gcbHeaderSize = 32;
+
+// the series we store, in the order they are written
+static const RideFile::SeriesType gcbSeries[] = {
+    RideFile::secs, RideFile::cad, RideFile::hr, RideFile::km, RideFile::kph,
+    RideFile::nm, RideFile::watts, RideFile::alt, RideFile::lon, RideFile::lat,
+    RideFile::headwind, RideFile::slope, RideFile::temp, RideFile::interval,
+    RideFile::lrbalance
+};
+static const int gcbSeriesCount = sizeof(gcbSeries) / sizeof(gcbSeries[0]);
+
+// read a double from a series block, on little-endian
+// hosts we just use the block in place
+static inline double gcbValue(const uchar *block, int index)
+{
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    return reinterpret_cast<const double *>(block)[index];
+#else
+    quint64 bits = qFromLittleEndian<quint64>(block + (index * sizeof(double)));
+    double value;
+    memcpy(&value, &bits, sizeof(double));
+    return value;
+#endif
+}
+
+static RideFile *
+gcbParse(const uchar *data, qint64 size, QStringList &errors)
+{
+    // header
+    if (size < gcbHeaderSize || memcmp(data, "GCRB", 4)) {
+        errors << "Not a GoldenCheetah binary ride file.";
+        return NULL;
+    }
+
+    quint32 version = qFromLittleEndian<quint32>(data + 4);
+    quint32 samples = qFromLittleEndian<quint32>(data + 8);
+    quint32 present = qFromLittleEndian<quint32>(data + 12);
+    double recIntSecs = gcbValue(data + 16, 0);
+    quint64 start = qFromLittleEndian<quint64>(data + 24);
+
+    if (version != GcbRideFileVersion) {
+        errors << QString("Unsupported GoldenCheetah binary version %1.").arg(version);
+        return NULL;
+    }
+
+    // time is always written, and every sample has it, so the count
+    // can't be more than would fit in the file
+    if (!(present & (1u << RideFile::secs)) ||
+        samples > (quint64) (size - gcbHeaderSize) / sizeof(double)) {
+        errors << "Corrupt GoldenCheetah binary ride file.";
+        return NULL;
+    }
+
+    // locate the series blocks
+    const uchar *blocks[RideFile::none];
+    memset(blocks, 0, sizeof(blocks));
+
+    qint64 offset = gcbHeaderSize;
+    for (int i=0; i<gcbSeriesCount; i++) {
+        if (present & (1u << gcbSeries[i])) {
+            if (offset + (qint64) samples * sizeof(double) > size) {
+                errors << "Truncated GoldenCheetah binary ride file.";
+                return NULL;
+            }
+            blocks[gcbSeries[i]] = data + offset;
+            offset += (qint64) samples * sizeof(double);
+        }
+    }
+
+    RideFile *ride = new RideFile(QDateTime::fromTime_t(start), recIntSecs);
+    ride->reservePoints(samples);
+
+    // samples, absent series get the same defaults as RideFilePoint
+    #define GCB_VALUE(series, def) (blocks[RideFile::series] ? gcbValue(blocks[RideFile::series], i) : (def))
+    for (quint32 i=0; i<samples; i++) {
+        ride->appendPoint(GCB_VALUE(secs, 0.0), GCB_VALUE(cad, 0.0), GCB_VALUE(hr, 0.0),
+                          GCB_VALUE(km, 0.0), GCB_VALUE(kph, 0.0), GCB_VALUE(nm, 0.0),
+                          GCB_VALUE(watts, 0.0), GCB_VALUE(alt, 0.0), GCB_VALUE(lon, 0.0),
+                          GCB_VALUE(lat, 0.0), GCB_VALUE(headwind, 0.0), GCB_VALUE(slope, 0.0),
+                          GCB_VALUE(temp, RideFile::noTemp), GCB_VALUE(lrbalance, 0.0),
+                          (int) GCB_VALUE(interval, 0.0));
+    }
+    #undef GCB_VALUE
+
+    // metadata
+    QByteArray metadata = QByteArray::fromRawData((const char *)(data + offset), size - offset);
+    QDataStream in(metadata);
+    in.setVersion(QDataStream::Qt_4_6);
+    in.setByteOrder(QDataStream::LittleEndian);
+
+    QString deviceType, id;
+    QMap<QString,QString> tags;
+    in >> deviceType >> id >> tags >> ride->metricOverrides;
+    ride->setDeviceType(deviceType);
+    ride->setId(id);
+    QMapIterator<QString,QString> tag(tags);
+    while (tag.hasNext()) {
+        tag.next();
+        ride->setTag(tag.key(), tag.value());
+    }
+
+    quint32 count;
+    in >> count;
+    for (quint32 i=0; i<count && in.status() == QDataStream::Ok; i++) {
+        double start, stop;
+        QString name;
+        in >> start >> stop >> name;
+        ride->addInterval(start, stop, name);
+    }
+
+    in >> count;
+    for (quint32 i=0; i<count && in.status() == QDataStream::Ok; i++) {
+        double start;
+        qint32 value;
+        QString name;
+        in >> start >> value >> name;
+        ride->addCalibration(start, value, name);
+    }
+
+    in >> count;
+    for (quint32 i=0; i<count && in.status() == QDataStream::Ok; i++) {
+        RideFilePoint p;
+        in >> p.secs >> p.cad >> p.hr >> p.km >> p.kph >> p.nm >> p.watts >> p.alt
+           >> p.lon >> p.lat >> p.headwind >> p.slope >> p.temp >> p.lrbalance;
+        qint32 interval;
+        in >> interval;
+        p.interval = interval;
+        ride->appendReference(p);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        errors << "Truncated GoldenCheetah binary ride file metadata.";
+        delete ride;
+        return NULL;
+    }
+    return ride;
+}
+
+RideFile *
+GcbFileReader::openRideFile(QFile &file, QStringList &errors, QList<RideFile*>*) const
+{
+    if (!file.open(QIODevice::ReadOnly)) {
+        errors << "Could not open file.";
+        return NULL;
+    }
+
+    // map the file so the series blocks are used in place,
+    // if we can't map it then just read the whole thing in
+    qint64 size = file.size();
+    uchar *mapped = size ? file.map(0, size) : NULL;
+    QByteArray contents;
+    const uchar *data = mapped;
+    if (data == NULL) {
+        contents = file.readAll();
+        data = reinterpret_cast<const uchar *>(contents.constData());
+        size = contents.size();
+    }
+
+    RideFile *ride = gcbParse(data, size, errors);
+
+    if (mapped) file.unmap(mapped);
+    file.close();
+    return ride;
+}
+
+bool
+GcbFileReader::writeRideFile(Context *, const RideFile *ride, QFile &file) const
+{
+    // can we open the file for writing?
+    if (!file.open(QIODevice::WriteOnly)) return false;
+
+    // truncate existing
+    file.resize(0);
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_6);
+    out.setByteOrder(QDataStream::LittleEndian);
+
+    // which series are present? time always is
+    quint32 present = 0;
+    for (int i=0; i<gcbSeriesCount; i++)
+        if (gcbSeries[i] == RideFile::secs || ride->isDataPresent(gcbSeries[i]))
+            present |= (1u << gcbSeries[i]);
+
+    // header
+    out.writeRawData("GCRB", 4);
+    out << GcbRideFileVersion
+        << (quint32) ride->dataPoints().count()
+        << present
+        << ride->recIntSecs()
+        << (quint64) ride->startTime().toUTC().toTime_t();
+
+    // series blocks
+    for (int i=0; i<gcbSeriesCount; i++) {
+        if (present & (1u << gcbSeries[i])) {
+            RideFileSeries series = ride->series(gcbSeries[i]);
+            for (int j=0; j<series.count; j++) out << series[j];
+        }
+    }
+
+    // metadata
+    out << ride->deviceType() << ride->id() << ride->tags() << ride->metricOverrides;
+
+    out << (quint32) ride->intervals().count();
+    foreach (RideFileInterval interval, ride->intervals())
+        out << interval.start << interval.stop << interval.name;
+
+    out << (quint32) ride->calibrations().count();
+    foreach (RideFileCalibration calibration, ride->calibrations())
+        out << calibration.start << (qint32) calibration.value << calibration.name;
+
+    out << (quint32) ride->referencePoints().count();
+    foreach (const RideFilePoint *p, ride->referencePoints())
+        out << p->secs << p->cad << p->hr << p->km << p->kph << p->nm << p->watts << p->alt
+            << p->lon << p->lat << p->headwind << p->slope << p->temp << p->lrbalance
+            << (qint32) p->interval;
+
+    file.close();
+    return out.status() == QDataStream::Ok;
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2026 GoldenCheetah Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _GcbRideFile_h
+#define _GcbRideFile_h
+#include "GoldenCheetah.h"
+
+#include "RideFile.h"
+
+// The GoldenCheetah binary ride format (.gcb) is a compact columnar
+// representation of a RideFile that can be loaded without any parsing.
+//
+// All values are little-endian.
+//
+// Header (32 bytes)
+//      char[4]     magic "GCRB"
+//      quint32     version (GcbRideFileVersion)
+//      quint32     sample count
+//      quint32     series present, bit n set for RideFile::SeriesType n
+//      double      recording interval in seconds
+//      quint64     start time, seconds since the epoch UTC
+//
+// Series blocks
+//      for each series present, in SeriesType order, a block of
+//      sample count doubles. Since the header is 32 bytes each block
+//      is 8 byte aligned and can be used in place from a mapped file.
+//
+// Metadata (QDataStream, Qt_4_6 little-endian)
+//      QString                             device type
+//      QString                             identifier
+//      QMap<QString,QString>               tags
+//      QMap<QString,QMap<QString,QString>> metric overrides
+//      quint32 + n x (double, double, QString)  intervals
+//      quint32 + n x (double, qint32, QString)  calibrations
+//      quint32 + n x 15 doubles                 references
+//
+static const quint32 GcbRideFileVersion = 1;
+// revision history:
+// version  date         description
+// 1        16-Oct-26    Initial - header, series blocks and metadata
+
+struct GcbFileReader : public RideFileReader {
+    virtual RideFile *openRideFile(QFile &file, QStringList &errors, QList<RideFile*>* = 0) const;
+    bool writeRideFile(Context *, const RideFile *ride, QFile &file) const;
+    bool hasWrite() const { return true; }
+    bool isReentrant() const { return true; }
+};
+
+#endif // _GcbRideFile_h
@@ -27,9 +27,6 @@
 #include "TimeUtils.h"
 #include <math.h>
 
-// use stc strtod to bypass Qt toDouble() issues
-#include <stdlib.h>
-
 GpxParser::GpxParser (RideFile* rideFile)
     : rideFile(rideFile)
 {
@@ -52,42 +49,46 @@ GpxParser::GpxParser (RideFile* rideFile)
 
 }
 
-bool GpxParser::startElement( const QString&, const QString&,
-    const QString& qName,
-    const QXmlAttributes& qAttributes)
+bool
+GpxParser::parse(QIODevice &device)
 {
-    buffer.clear();
+    XmlTokenizer xml(&device);
+    xml.addTag("metadata", Metadata);
+    xml.addTag("trkpt", Trkpt);
+    xml.addTag("time", Time);
+    xml.addTag("ele", Ele);
+    xml.addTag("gpxtpx:hr", GpxtpxHr);
+    xml.addTag("gpxdata:hr", GpxdataHr);
+    xml.addTag("gpxdata:temp", GpxdataTemp);
+    xml.addTag("gpxdata:cadence", GpxdataCadence);
+    xml.addTag("gpxdata:bikepower", GpxdataBikepower);
+
+    forever {
+        switch (xml.next()) {
+        case XmlTokenizer::StartElement: startElement(xml); break;
+        case XmlTokenizer::EndElement: endElement(xml); break;
+        case XmlTokenizer::EndDocument: return true;
+        case XmlTokenizer::Invalid: return false;
+        }
+    }
+}
 
+void
+GpxParser::startElement(const XmlTokenizer &xml)
+{
     if(metadata)
-        return true;
+        return;
 
-    if(qName == "metadata")
+    if(xml.tag() == Metadata)
     {
         metadata = true;
 
     }
-    else if(qName == "trkpt")
+    else if(xml.tag() == Trkpt)
     {
-        int i = qAttributes.index("lat");
-        if(i >= 0)
-        {
-            lat = qAttributes.value(i).toDouble();
-        }
-        else
-        {
-            lat = lastLat;
-        }
-        i = qAttributes.index("lon");
-        if( i >= 0)
-        {
-            lon = qAttributes.value(i).toDouble();
-        }
-        else
-        {
-            lon = lastLon;
-        }
+        lat = xml.attributeNumber("lat", lastLat);
+        lon = xml.attributeNumber("lon", lastLon);
     }
-    return TRUE;
 }
 
 #define PI 3.14159265
@@ -97,21 +98,23 @@ inline double toRadians(double degrees)
 
 }
 
-bool
-        GpxParser::endElement( const QString&, const QString&, const QString& qName)
+void
+GpxParser::endElement(const XmlTokenizer &xml)
 {
-    if(qName == "metadata")
+    int tag = xml.tag();
+
+    if(tag == Metadata)
     {
         metadata = false;
     }
     else if(metadata == true)
     {
-        return true;
+        return;
     }
-    else if (qName == "time")
+    else if (tag == Time)
     {
 
-        time = convertToLocalTime(buffer);
+        time = convertToLocalTime(xml.text());
         if(firstTime)
         {
             start_time = time;
@@ -119,33 +122,33 @@ bool
             firstTime = false;
         }
     }
-    else if (qName == "ele")
+    else if (tag == Ele)
     {
-        alt = buffer.toDouble();  // metric
+        alt = xml.number();  // metric
     }
-    else if (qName == "gpxtpx:hr")
+    else if (tag == GpxtpxHr)
     {
-        hr = buffer.toInt();
+        hr = (int) xml.number();
     }
-    else if (qName == "gpxdata:hr")
+    else if (tag == GpxdataHr)
     {
-        hr = buffer.toDouble(); // on suunto ambit export file, there are sometimes double values
+        hr = xml.number(); // on suunto ambit export file, there are sometimes double values
     }
-    else if (qName == "gpxdata:temp")
+    else if (tag == GpxdataTemp)
     {
-        temp = buffer.toDouble();
+        temp = xml.number();
     }
-    else if (qName == "gpxdata:cadence")
+    else if (tag == GpxdataCadence)
     {
-        cad = buffer.toDouble();
+        cad = xml.number();
     }
-    else if (qName == "gpxdata:bikepower") // hopefully suunto adds bikepower data to gpx export file, as it is on saved moveslink log_.xml
+    else if (tag == GpxdataBikepower) // hopefully suunto adds bikepower data to gpx export file, as it is on saved moveslink log_.xml
     {
-        watts = buffer.toDouble();
+        watts = xml.number();
     }
 
 
-    else if (qName == "trkpt")
+    else if (tag == Trkpt)
     {
         if(lastLon == 0)
         {
@@ -153,7 +156,7 @@ bool
             last_time = time;
             lastLon = lon;
             lastLat = lat;
-            return TRUE;
+            return;
         }
         // we need to figure out the distance by using the lon,lat
         // using teh haversine formula
@@ -253,12 +256,4 @@ bool
         lastLon = lon;
         lastLat = lat;
     }
-
-    return TRUE;
-}
-
-bool GpxParser::characters( const QString& str )
-{
-    buffer += str;
-    return TRUE;
 }
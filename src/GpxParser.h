@@ -19,32 +19,35 @@
  * Franklin Street, Fifth Floor, Boston, MA  02110-1301	 USA
  */
 
-#ifndef _TcxParser_h
-#define _TcxParser_h
+#ifndef _GpxParser_h
+#define _GpxParser_h
 #include "GoldenCheetah.h"
 
 #include "RideFile.h"
 #include <QString>
 #include <QDateTime>
-#include <QXmlDefaultHandler>
+#include <QIODevice>
 #include "Settings.h"
+#include "XmlTokenizer.h"
 
-class GpxParser : public QXmlDefaultHandler
+class GpxParser
 {
 public:
     GpxParser(RideFile* rideFile);
 
-    bool startElement( const QString&, const QString&, const QString&,
-		       const QXmlAttributes& );
-    bool endElement( const QString&, const QString&, const QString& );
-
-    bool characters( const QString& );
+    bool parse(QIODevice &device);
 
 private:
 
+    // the elements we look at
+    enum { Metadata, Trkpt, Time, Ele, GpxtpxHr, GpxdataHr, GpxdataTemp,
+           GpxdataCadence, GpxdataBikepower };
+
+    void startElement(const XmlTokenizer &xml);
+    void endElement(const XmlTokenizer &xml);
+
     RideFile*   rideFile;
 
-    QString     buffer;
     QVariant    isGarminSmartRecording;
     QVariant    GarminHWM;
 
@@ -69,5 +72,5 @@ private:
 
 };
 
-#endif // _TcxParser_h
+#endif // _GpxParser_h
 
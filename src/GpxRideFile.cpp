@@ -28,18 +28,20 @@ static int tcxFileReaderRegistered =
 
 RideFile *GpxFileReader::openRideFile(QFile &file, QStringList &errors, QList<RideFile*>*) const
 {
-    (void) errors;
     RideFile *rideFile = new RideFile();
     rideFile->setRecIntSecs(1.0);
     //rideFile->setDeviceType("GPS Exchange Format");
     rideFile->setFileFormat("GPS Exchange Format (gpx)");
 
-    GpxParser handler(rideFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errors << "Could not open file.";
+        delete rideFile;
+        return NULL;
+    }
 
-    QXmlInputSource source (&file);
-    QXmlSimpleReader reader;
-    reader.setContentHandler (&handler);
-    reader.parse (source);
+    GpxParser handler(rideFile);
+    handler.parse(file);
+    file.close();
 
     return rideFile;
 }
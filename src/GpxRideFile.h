@@ -28,6 +28,7 @@
 struct GpxFileReader : public RideFileReader {
     virtual RideFile *openRideFile(QFile &file, QStringList &errors, QList<RideFile*>* = 0) const; 
     bool hasWrite() const { return false; }
+    bool isReentrant() const { return true; }
 };
 
 #endif // _GpxRideFile_h
@@ -921,7 +921,7 @@ void
 HistogramWindow::setFilter(QStringList list)
 {
     isfiltered = true;
-    files = list;
+    files = RideSet(list);
     stale = true;
     updateChart();
     repaint();
@@ -211,7 +211,7 @@ class HistogramWindow : public GcChartWindow
 #ifdef GC_HAVE_LUCENE
         SearchFilterBox *searchBox;
         bool isfiltered;
-        QStringList files;
+        RideSet files;
 #endif
 
         bool active,  // active switching mode between data series and metric
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2026 GoldenCheetah Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "IntervalMetricsCache.h"
+#include "Context.h"
+#include "Athlete.h"
+#include "RideItem.h"
+#include "RideFile.h"
+#include "DBAccess.h"
+#include "Zones.h"
+#include "HrZones.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDataStream>
+
+IntervalMetricsCache::IntervalMetricsCache(Context *context) : context(context), loaded(false), dirty(false)
+{
+}
+
+IntervalMetricsCache::~IntervalMetricsCache()
+{
+    if (dirty) write();
+}
+
+//
+// METRICS
+//
+QHash<QString,RideMetricPtr>
+IntervalMetricsCache::metrics(RideItem *item, double start, double stop, const QStringList &symbols)
+{
+    QHash<QString,RideMetricPtr> returning;
+
+    RideFile *ride = item->ride();
+    if (!ride) return returning;
+
+    // the samples from start up to stop
+    const QVector<RideFilePoint*> &points = ride->dataPoints();
+    int from = ride->intervalBegin(RideFileInterval(start, stop, ""));
+    int to = from;
+    while (to >= 0 && to < points.count() && points[to]->secs < stop) to++;
+    if (from < 0 || to <= from) return returning;
+
+    // unsaved changes can't be cached, the
+    // fingerprint only changes when it is saved
+    Entry *entry = NULL;
+    if (!item->isDirty()) {
+        load();
+
+        Fingerprint now = fingerprint(item);
+        if (!entries.contains(item->fileName) || entries.value(item->fileName).fingerprint != now) {
+            Entry add;
+            add.fingerprint = now;
+            entries.insert(item->fileName, add);
+            dirty = true;
+        }
+        entry = &entries[item->fileName];
+    }
+
+    // use what we have already
+    const RideMetricFactory &factory = RideMetricFactory::instance();
+    Bounds bounds(start, stop);
+    QStringList missing;
+    foreach(QString symbol, symbols) {
+        if (!factory.haveMetric(symbol)) continue;
+
+        if (entry && entry->intervals.value(bounds).contains(symbol)) {
+            RideMetricPtr m(factory.newMetric(symbol));
+            m->setValue(entry->intervals[bounds].value(symbol));
+            returning.insert(symbol, m);
+        } else {
+            missing << symbol;
+        }
+    }
+    if (missing.isEmpty()) return returning;
+
+    // and compute the rest over a view of the interval's samples,
+    // the view takes the ride's weight so get it once for them all
+    ride->getWeight();
+    RideFile view(ride, from, to);
+    view.context = context; // hack, until we refactor athlete and mainwindow
+
+    QHash<QString,RideMetricPtr> computed =
+        RideMetric::computeMetrics(context, &view, context->athlete->zones(), context->athlete->hrZones(), missing);
+
+    foreach(QString symbol, missing) {
+        RideMetricPtr m = computed.value(symbol);
+        if (!m) continue;
+
+        returning.insert(symbol, m);
+        if (entry) {
+            entry->intervals[bounds].insert(symbol, m->value(true));
+            dirty = true;
+        }
+    }
+    return returning;
+}
+
+IntervalMetricsCache::Fingerprint
+IntervalMetricsCache::fingerprint(RideItem *item) const
+{
+    // what the metric refresh checks, see MetricAggregator::refreshMetrics(),
+    // but the zones are kept apart so a change to one can't cancel the other
+    QFileInfo file(context->athlete->home.absolutePath() + "/" + item->fileName);
+
+    Fingerprint returning;
+    returning.timestamp = file.lastModified().toTime_t();
+    returning.zones = context->athlete->zones()->getFingerprint();
+    returning.hrZones = context->athlete->hrZones()->getFingerprint();
+    return returning;
+}
+
+//
+// PERSISTANCE
+//
+void
+IntervalMetricsCache::load()
+{
+    if (loaded) return;
+    loaded = true;
+
+    QFile file(context->athlete->home.absolutePath() + "/intervalmetrics.cache");
+    if (!file.open(QIODevice::ReadOnly)) return;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_4_6);
+
+    // the metrics are recomputed when their
+    // code changes, so we should too
+    quint32 version, schema;
+    in >> version >> schema;
+    if (in.status() != QDataStream::Ok || version != IntervalMetricsCacheVersion ||
+        schema != static_cast<quint32>(DBSchemaVersion)) {
+        dirty = true; // overwrite it
+        return;
+    }
+
+    quint32 count;
+    in >> count;
+    for (quint32 i=0; i<count && in.status() == QDataStream::Ok; i++) {
+
+        QString fileName;
+        Entry entry;
+        in >> fileName >> entry.fingerprint.timestamp >> entry.fingerprint.zones
+           >> entry.fingerprint.hrZones >> entry.intervals;
+
+        // forget rides that have been deleted
+        if (QFile::exists(context->athlete->home.absolutePath() + "/" + fileName))
+            entries.insert(fileName, entry);
+        else
+            dirty = true;
+    }
+
+    // start again if it is corrupt
+    if (in.status() != QDataStream::Ok) {
+        entries.clear();
+        dirty = true;
+    }
+}
+
+void
+IntervalMetricsCache::write()
+{
+    QFile file(context->athlete->home.absolutePath() + "/intervalmetrics.cache");
+    if (!file.open(QIODevice::WriteOnly)) return;
+    file.resize(0);
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_6);
+
+    out << (quint32) IntervalMetricsCacheVersion << (quint32) DBSchemaVersion;
+    out << (quint32) entries.count();
+
+    QHashIterator<QString, Entry> i(entries);
+    while (i.hasNext()) {
+        i.next();
+        const Fingerprint &fingerprint = i.value().fingerprint;
+        out << i.key() << fingerprint.timestamp << fingerprint.zones << fingerprint.hrZones << i.value().intervals;
+    }
+
+    file.close();
+
+    // don't leave a partial cache behind
+    if (out.status() != QDataStream::Ok) file.remove();
+    else dirty = false;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2026 GoldenCheetah Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _GC_IntervalMetricsCache_h
+#define _GC_IntervalMetricsCache_h 1
+#include "GoldenCheetah.h"
+
+#include "RideMetric.h"
+
+#include <QHash>
+#include <QMap>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+
+class Context;
+class RideItem;
+
+// The IntervalMetricsCache holds the metrics computed for each interval
+// of a ride so the ride and interval summaries don't recompute them
+// every time the ride is selected.
+//
+// The values are kept by ride with the fingerprint they were computed
+// with; the timestamp of the ride file and the zones (as used by the
+// metric refresh), so when a ride is saved or the zones change they
+// are recomputed. A ride that has been edited but not saved is not
+// cached at all. The values for each interval are keyed by its start
+// and stop, so renaming an interval doesn't matter. They are computed
+// over a view of the ride's points rather than a copy.
+//
+// The cache is kept in the athlete's home directory, next to the
+// metrics db, and written when the athlete is closed.
+static const unsigned int IntervalMetricsCacheVersion = 2;
+// revision history:
+// version  date         description
+// 1        16-Oct-26    Initial - values by ride and interval start/stop
+// 2        16-Oct-26    Ride timestamp and zone fingerprints kept apart
+
+class IntervalMetricsCache
+{
+    public:
+        IntervalMetricsCache(Context *context);
+        ~IntervalMetricsCache();
+
+        // the metrics for the ride between start and stop secs
+        // empty if there are no samples in the interval
+        QHash<QString,RideMetricPtr> metrics(RideItem *item, double start, double stop, const QStringList &symbols);
+
+    private:
+
+        typedef QPair<double, double> Bounds; // start, stop
+        struct Fingerprint {
+            quint32 timestamp; // of the ride file
+            quint32 zones, hrZones;
+
+            bool operator==(const Fingerprint &other) const {
+                return timestamp == other.timestamp && zones == other.zones && hrZones == other.hrZones;
+            }
+            bool operator!=(const Fingerprint &other) const { return !(*this == other); }
+        };
+        struct Entry {
+            Fingerprint fingerprint;
+            QMap<Bounds, QHash<QString, double> > intervals;
+        };
+
+        Fingerprint fingerprint(RideItem *item) const;
+        void load();
+        void write();
+
+        Context *context;
+        bool loaded, dirty;
+        QHash<QString, Entry> entries; // by ride filename
+};
+#endif // _GC_IntervalMetricsCache_h
@@ -22,6 +22,7 @@
 #include "RideMetric.h"
 #include "IntervalItem.h"
 #include "IntervalSummaryWindow.h"
+#include "IntervalMetricsCache.h"
 #include "Settings.h"
 #include "TimeUtils.h"
 
@@ -65,24 +66,8 @@ void IntervalSummaryWindow::intervalSelected()
 
 void IntervalSummaryWindow::calcInterval(IntervalItem* interval, QString& html)
 {
-	const RideFile* ride = context->currentRide();
-
     bool metricUnits = context->athlete->useMetricUnits;
 
-    RideFile f(ride->startTime(), ride->recIntSecs());
-    f.context = context;
-    int start = ride->timeIndex(interval->start);
-    int end = ride->timeIndex(interval->stop);
-    for (int i = start; i < end; ++i) {
-        const RideFilePoint *p = ride->dataPoints()[i];
-        f.appendPoint(p->secs, p->cad, p->hr, p->km, p->kph, p->nm,
-                      p->watts, p->alt, p->lon, p->lat, p->headwind, p->slope, p->temp, p->lrbalance, 0);
-    }
-    if (f.dataPoints().size() == 0) {
-        // Interval empty, do not compute any metrics
-        html += "<i>" + tr("empty interval") + "</tr>";
-    }
-
     QString s;
     if (appsettings->contains(GC_SETTINGS_INTERVAL_METRICS))
         s = appsettings->value(this, GC_SETTINGS_INTERVAL_METRICS).toString();
@@ -91,7 +76,11 @@ void IntervalSummaryWindow::calcInterval(IntervalItem* interval, QString& html)
     QStringList intervalMetrics = s.split(",");
 
     QHash<QString,RideMetricPtr> metrics =
-        RideMetric::computeMetrics(context, &f, context->athlete->zones(), context->athlete->hrZones(), intervalMetrics);
+        context->athlete->intervalCache->metrics((RideItem*)context->currentRideItem(), interval->start, interval->stop, intervalMetrics);
+    if (metrics.isEmpty()) {
+        // Interval empty, no metrics
+        html += "<i>" + tr("empty interval") + "</tr>";
+    }
 
     html += "<b>" + interval->text(0) + "</b>";
     html += "<table align=\"center\" width=\"90%\" ";
@@ -34,6 +34,7 @@ struct JsonFileReader : public RideFileReader {
     virtual RideFile *openRideFile(QFile &file, QStringList &errors, QList<RideFile*>* = 0) const; 
     bool writeRideFile(Context *, const RideFile *ride, QFile &file) const;
     bool hasWrite() const { return true; }
+    bool isReentrant() const { return true; }
 };
 
 #endif // _JsonRideFile_h
@@ -35,31 +35,43 @@
 // in writeRideFile below, this is NOT a generic json parser.
 
 #include "JsonRideFile.h"
+#include <math.h>
+#include <float.h>
+#include <string.h>
 
 // Set during parser processing, using same
 // naming conventions as yacc/lex -p
-static RideFile *JsonRide;
-
-// term state data is held in these variables
-static RideFilePoint JsonPoint;
-static RideFileInterval JsonInterval;
-static RideFileCalibration JsonCalibration;
-static QString JsonString,
-               JsonTagKey, JsonTagValue,
-               JsonOverName, JsonOverKey, JsonOverValue;
-static double JsonNumber;
-static QStringList JsonRideFileerrors;
-static QMap <QString, QString> JsonOverrides;
+//
+// The parser and lexer are reentrant, all the state for a
+// parse is held in a JsonContext so several .json files
+// can be parsed at once from different threads
+struct JsonContext {
+
+    RideFile *JsonRide;
+
+    // term state data is held in these variables
+    RideFilePoint JsonPoint;
+    RideFileInterval JsonInterval;
+    RideFileCalibration JsonCalibration;
+    QString JsonString,
+            JsonTagKey, JsonTagValue,
+            JsonOverName, JsonOverKey, JsonOverValue;
+    double JsonNumber;
+    QStringList JsonRideFileerrors;
+    QMap <QString, QString> JsonOverrides;
+
+    JsonContext() : JsonRide(NULL), JsonNumber(0) {}
+};
 
 // Lex scanner
-extern int JsonRideFilelex(); // the lexer aka yylex()
-extern void JsonRideFile_setString(QString);
-extern int JsonRideFilelex_destroy(void); // the cleaner for lexer
+extern void JsonRideFile_setString(QString, void *scanner);
+extern int JsonRideFilelex_init(void **scanner); // create a lexer
+extern int JsonRideFilelex_destroy(void *scanner); // the cleaner for lexer
+extern char *JsonRideFileget_text(void *scanner); // aka yytext
 
 // yacc parser
-extern char *JsonRideFiletext; // set by the lexer aka yytext
-void JsonRideFileerror(const char *error) // used by parser aka yyerror()
-{ JsonRideFileerrors << error; }
+void JsonRideFileerror(JsonContext *jc, void *, const char *error) // used by parser aka yyerror()
+{ jc->JsonRideFileerrors << error; }
 
 //
 // Utility functions
@@ -105,6 +117,16 @@ static QString unprotect(const QString string)
 
 %}
 
+%define api.pure
+%parse-param { struct JsonContext *jc }
+%parse-param { void *scanner }
+%lex-param { void *scanner }
+
+%code {
+// Lex scanner, declared here as it needs YYSTYPE
+extern int JsonRideFilelex(YYSTYPE *, void *scanner); // the lexer aka yylex()
+}
+
 %token STRING INTEGER FLOAT
 %token RIDE STARTTIME RECINTSECS DEVICETYPE IDENTIFIER
 %token OVERRIDES
@@ -147,13 +169,13 @@ rideelement: starttime
  * First class variables
  */
 starttime: STARTTIME ':' string         {
-                                          QDateTime aslocal = QDateTime::fromString(JsonString, DATETIME_FORMAT);
+                                          QDateTime aslocal = QDateTime::fromString(jc->JsonString, DATETIME_FORMAT);
                                           QDateTime asUTC = QDateTime(aslocal.date(), aslocal.time(), Qt::UTC);
-                                          JsonRide->setStartTime(asUTC.toLocalTime());
+                                          jc->JsonRide->setStartTime(asUTC.toLocalTime());
                                         }
-recordint: RECINTSECS ':' number        { JsonRide->setRecIntSecs(JsonNumber); }
-devicetype: DEVICETYPE ':' string       { JsonRide->setDeviceType(JsonString); }
-identifier: IDENTIFIER ':' string       { JsonRide->setId(JsonString); }
+recordint: RECINTSECS ':' number        { jc->JsonRide->setRecIntSecs(jc->JsonNumber); }
+devicetype: DEVICETYPE ':' string       { jc->JsonRide->setDeviceType(jc->JsonString); }
+identifier: IDENTIFIER ':' string       { jc->JsonRide->setId(jc->JsonString); }
 
 /*
  * Metric Overrides
@@ -161,40 +183,40 @@ identifier: IDENTIFIER ':' string       { JsonRide->setId(JsonString); }
 overrides: OVERRIDES ':' '[' overrides_list ']' ;
 overrides_list: override | overrides_list ',' override ;
 
-override: '{' override_name ':' override_values '}' { JsonRide->metricOverrides.insert(JsonOverName, JsonOverrides);
-                                                      JsonOverrides.clear();
+override: '{' override_name ':' override_values '}' { jc->JsonRide->metricOverrides.insert(jc->JsonOverName, jc->JsonOverrides);
+                                                      jc->JsonOverrides.clear();
                                                     }
-override_name: string                   { JsonOverName = JsonString; }
+override_name: string                   { jc->JsonOverName = jc->JsonString; }
 
 override_values: '{' override_value_list '}';
 override_value_list: override_value | override_value_list ',' override_value ;
-override_value: override_key ':' override_value { JsonOverrides.insert(JsonOverKey, JsonOverValue); }
-override_key : string                   { JsonOverKey = JsonString; }
-override_value : string                 { JsonOverValue = JsonString; }
+override_value: override_key ':' override_value { jc->JsonOverrides.insert(jc->JsonOverKey, jc->JsonOverValue); }
+override_key : string                   { jc->JsonOverKey = jc->JsonString; }
+override_value : string                 { jc->JsonOverValue = jc->JsonString; }
 
 /*
  * Ride metadata tags
  */
 tags: TAGS ':' '{' tags_list '}'
 tags_list: tag | tags_list ',' tag ;
-tag: tag_key ':' tag_value              { JsonRide->setTag(JsonTagKey, JsonTagValue); }
+tag: tag_key ':' tag_value              { jc->JsonRide->setTag(jc->JsonTagKey, jc->JsonTagValue); }
 
-tag_key : string                        { JsonTagKey = JsonString; }
-tag_value : string                      { JsonTagValue = JsonString; }
+tag_key : string                        { jc->JsonTagKey = jc->JsonString; }
+tag_value : string                      { jc->JsonTagValue = jc->JsonString; }
 
 /*
  * Intervals
  */
 intervals: INTERVALS ':' '[' interval_list ']' ;
 interval_list: interval | interval_list ',' interval ;
-interval: '{' NAME ':' string ','       { JsonInterval.name = JsonString; }
-              START ':' number ','      { JsonInterval.start = JsonNumber; }
-              STOP ':' number           { JsonInterval.stop = JsonNumber; }
+interval: '{' NAME ':' string ','       { jc->JsonInterval.name = jc->JsonString; }
+              START ':' number ','      { jc->JsonInterval.start = jc->JsonNumber; }
+              STOP ':' number           { jc->JsonInterval.stop = jc->JsonNumber; }
           '}'
-                                        { JsonRide->addInterval(JsonInterval.start,
-                                                                JsonInterval.stop,
-                                                                JsonInterval.name);
-                                          JsonInterval = RideFileInterval();
+                                        { jc->JsonRide->addInterval(jc->JsonInterval.start,
+                                                                    jc->JsonInterval.stop,
+                                                                    jc->JsonInterval.name);
+                                          jc->JsonInterval = RideFileInterval();
                                         }
 
 /*
@@ -202,14 +224,14 @@ interval: '{' NAME ':' string ','       { JsonInterval.name = JsonString; }
  */
 calibrations: CALIBRATIONS ':' '[' calibration_list ']' ;
 calibration_list: calibration | calibration_list ',' calibration ;
-calibration: '{' NAME ':' string ','    { JsonCalibration.name = JsonString; }
-                 START ':' number ','   { JsonCalibration.start = JsonNumber; }
-                 VALUE ':' number       { JsonCalibration.value = JsonNumber; }
+calibration: '{' NAME ':' string ','    { jc->JsonCalibration.name = jc->JsonString; }
+                 START ':' number ','   { jc->JsonCalibration.start = jc->JsonNumber; }
+                 VALUE ':' number       { jc->JsonCalibration.value = jc->JsonNumber; }
              '}'
-                                        { JsonRide->addCalibration(JsonCalibration.start,
-                                                                   JsonCalibration.value,
-                                                                   JsonCalibration.name);
-                                          JsonCalibration = RideFileCalibration();
+                                        { jc->JsonRide->addCalibration(jc->JsonCalibration.start,
+                                                                       jc->JsonCalibration.value,
+                                                                       jc->JsonCalibration.name);
+                                          jc->JsonCalibration = RideFileCalibration();
                                         }
 
 
@@ -218,11 +240,11 @@ calibration: '{' NAME ':' string ','    { JsonCalibration.name = JsonString; }
  */
 references: REFERENCES ':' '[' reference_list ']'
                                         {
-                                          JsonPoint = RideFilePoint();
+                                          jc->JsonPoint = RideFilePoint();
                                         }
 reference_list: reference | reference_list ',' reference;
-reference: '{' series '}'               { JsonRide->appendReference(JsonPoint);
-                                          JsonPoint = RideFilePoint();
+reference: '{' series '}'               { jc->JsonRide->appendReference(jc->JsonPoint);
+                                          jc->JsonPoint = RideFilePoint();
                                         }
 
 /*
@@ -230,41 +252,41 @@ reference: '{' series '}'               { JsonRide->appendReference(JsonPoint);
  */
 samples: SAMPLES ':' '[' sample_list ']' ;
 sample_list: sample | sample_list ',' sample ;
-sample: '{' series_list '}'             { JsonRide->appendPoint(JsonPoint.secs, JsonPoint.cad,
-                                                    JsonPoint.hr, JsonPoint.km, JsonPoint.kph,
-                                                    JsonPoint.nm, JsonPoint.watts, JsonPoint.alt,
-                                                    JsonPoint.lon, JsonPoint.lat,
-                                                    JsonPoint.headwind,
-                                                    JsonPoint.slope, JsonPoint.temp, JsonPoint.lrbalance,
-                                                    JsonPoint.interval);
-                                          JsonPoint = RideFilePoint();
+sample: '{' series_list '}'             { jc->JsonRide->appendPoint(jc->JsonPoint.secs, jc->JsonPoint.cad,
+                                                    jc->JsonPoint.hr, jc->JsonPoint.km, jc->JsonPoint.kph,
+                                                    jc->JsonPoint.nm, jc->JsonPoint.watts, jc->JsonPoint.alt,
+                                                    jc->JsonPoint.lon, jc->JsonPoint.lat,
+                                                    jc->JsonPoint.headwind,
+                                                    jc->JsonPoint.slope, jc->JsonPoint.temp, jc->JsonPoint.lrbalance,
+                                                    jc->JsonPoint.interval);
+                                          jc->JsonPoint = RideFilePoint();
                                         }
 
 series_list: series | series_list ',' series ;
-series: SECS ':' number                 { JsonPoint.secs = JsonNumber; }
-        | KM ':' number                 { JsonPoint.km = JsonNumber; }
-        | WATTS ':' number              { JsonPoint.watts = JsonNumber; }
-        | NM ':' number                 { JsonPoint.nm = JsonNumber; }
-        | CAD ':' number                { JsonPoint.cad = JsonNumber; }
-        | KPH ':' number                { JsonPoint.kph = JsonNumber; }
-        | HR ':' number                 { JsonPoint.hr = JsonNumber; }
-        | ALTITUDE ':' number           { JsonPoint.alt = JsonNumber; }
-        | LAT ':' number                { JsonPoint.lat = JsonNumber; }
-        | LON ':' number                { JsonPoint.lon = JsonNumber; }
-        | HEADWIND ':' number           { JsonPoint.headwind = JsonNumber; }
-        | SLOPE ':' number              { JsonPoint.slope = JsonNumber; }
-        | TEMP ':' number               { JsonPoint.temp = JsonNumber; }
-        | LRBALANCE ':' number          { JsonPoint.lrbalance = JsonNumber; }
+series: SECS ':' number                 { jc->JsonPoint.secs = jc->JsonNumber; }
+        | KM ':' number                 { jc->JsonPoint.km = jc->JsonNumber; }
+        | WATTS ':' number              { jc->JsonPoint.watts = jc->JsonNumber; }
+        | NM ':' number                 { jc->JsonPoint.nm = jc->JsonNumber; }
+        | CAD ':' number                { jc->JsonPoint.cad = jc->JsonNumber; }
+        | KPH ':' number                { jc->JsonPoint.kph = jc->JsonNumber; }
+        | HR ':' number                 { jc->JsonPoint.hr = jc->JsonNumber; }
+        | ALTITUDE ':' number           { jc->JsonPoint.alt = jc->JsonNumber; }
+        | LAT ':' number                { jc->JsonPoint.lat = jc->JsonNumber; }
+        | LON ':' number                { jc->JsonPoint.lon = jc->JsonNumber; }
+        | HEADWIND ':' number           { jc->JsonPoint.headwind = jc->JsonNumber; }
+        | SLOPE ':' number              { jc->JsonPoint.slope = jc->JsonNumber; }
+        | TEMP ':' number               { jc->JsonPoint.temp = jc->JsonNumber; }
+        | LRBALANCE ':' number          { jc->JsonPoint.lrbalance = jc->JsonNumber; }
         ;
 
 /*
  * Primitives
  */
-number: INTEGER                         { JsonNumber = QString(JsonRideFiletext).toInt(); }
-        | FLOAT                         { JsonNumber = QString(JsonRideFiletext).toDouble(); }
+number: INTEGER                         { jc->JsonNumber = QString(JsonRideFileget_text(scanner)).toInt(); }
+        | FLOAT                         { jc->JsonNumber = QString(JsonRideFileget_text(scanner)).toDouble(); }
         ;
 
-string: STRING                          { JsonString = unprotect(JsonRideFiletext); }
+string: STRING                          { jc->JsonString = unprotect(JsonRideFileget_text(scanner)); }
         ;
 %%
 
@@ -293,12 +315,16 @@ JsonFileReader::openRideFile(QFile &file, QStringList &errors, QList<RideFile*>*
         return NULL; 
     }
 
+    // our own parse state and lexer
+    JsonContext jc;
+    void *scanner;
+    JsonRideFilelex_init(&scanner);
+
     // inform the parser/lexer we have a new file
-    JsonRideFile_setString(contents);
+    JsonRideFile_setString(contents, scanner);
 
     // setup
-    JsonRide = new RideFile;
-    JsonRideFileerrors.clear();
+    jc.JsonRide = new RideFile;
 
     // set to non-zero if you want to
     // to debug the yyparse() state machine
@@ -306,17 +332,187 @@ JsonFileReader::openRideFile(QFile &file, QStringList &errors, QList<RideFile*>*
     //yydebug = 0;
 
     // parse it
-    JsonRideFileparse();
+    JsonRideFileparse(&jc, scanner);
 
     // clean up
-    JsonRideFilelex_destroy();
+    JsonRideFilelex_destroy(scanner);
 
     // Only get errors so fail if we have any
     if (errors.count()) {
-        errors << JsonRideFileerrors;
-        delete JsonRide;
+        errors << jc.JsonRideFileerrors;
+        delete jc.JsonRide;
         return NULL;
-    } else return JsonRide;
+    } else return jc.JsonRide;
+}
+
+//
+// Writing
+//
+// Rides can have hundreds of thousands of samples, so rather than streaming
+// every field through a QTextStream the writer formats into one large buffer
+// that is written out whenever it fills up. Numbers are formatted by hand
+// exactly as QString::arg() did, so the files written are unchanged.
+class JsonWriter
+{
+    public:
+        JsonWriter(QFile &file) : file(file), used(0), ok(true) { buffer.resize(Capacity); }
+
+        JsonWriter &operator<<(const char *text) { append(text, strlen(text)); return *this; }
+        JsonWriter &operator<<(const QString &text) {
+            QByteArray local = text.toLocal8Bit(); // as QTextStream did
+            append(local.constData(), local.size());
+            return *this;
+        }
+        JsonWriter &operator<<(int value);
+        JsonWriter &operator<<(double value) { return number(value, 6); }
+
+        // %g with precision significant digits
+        JsonWriter &number(double value, int precision);
+
+        bool flush(); // false if the file could not be written
+
+    private:
+        void append(const char *text, int length);
+
+        static const int Capacity = 256 * 1024;
+
+        QFile &file;
+        QByteArray buffer;
+        int used;
+        bool ok;
+};
+
+void
+JsonWriter::append(const char *text, int length)
+{
+    if (used + length > Capacity) {
+        flush();
+        if (length > Capacity) { // won't fit anyway
+            if (file.write(text, length) != length) ok = false;
+            return;
+        }
+    }
+    memcpy(buffer.data() + used, text, length);
+    used += length;
+}
+
+bool
+JsonWriter::flush()
+{
+    if (used && file.write(buffer.constData(), used) != used) ok = false;
+    used = 0;
+    return ok;
+}
+
+JsonWriter &
+JsonWriter::operator<<(int value)
+{
+    char text[16], *p = text + sizeof(text);
+    unsigned int n = value < 0 ? 0u - (unsigned int)value : value;
+    do { *--p = '0' + n % 10; n /= 10; } while (n);
+    if (value < 0) *--p = '-';
+    append(p, text + sizeof(text) - p);
+    return *this;
+}
+
+static const double powersOf10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static double scale(double value, int exponent) // value * 10^exponent
+{
+    if (exponent > 22 || exponent < -22) return value * pow(10.0, exponent); // inexact, Qt rounds these
+    return exponent >= 0 ? value * powersOf10[exponent] : value / powersOf10[-exponent];
+}
+
+JsonWriter &
+JsonWriter::number(double value, int precision)
+{
+    char text[48], *p = text;
+
+    if (value != value) { append("nan", 3); return *this; }
+    if (value < 0 || (value == 0 && 1 / value < 0)) { *p++ = '-'; value = -value; }
+    if (value > DBL_MAX) { *p++ = 'i'; *p++ = 'n'; *p++ = 'f'; append(text, p - text); return *this; }
+
+    // most samples are whole numbers (watts, hr, cad, secs)
+    if (value < powersOf10[precision] && value == floor(value)) {
+        char digits[24], *d = digits + sizeof(digits);
+        quint64 n = (quint64)value;
+        do { *--d = '0' + n % 10; n /= 10; } while (n);
+        memcpy(p, d, digits + sizeof(digits) - d);
+        p += digits + sizeof(digits) - d;
+        append(text, p - text);
+        return *this;
+    }
+
+    // round to precision significant digits, the decimal exponent
+    // from log10 can be one out either way so check the result
+    int exponent = (int)floor(log10(value));
+    double scaled = scale(value, precision - 1 - exponent);
+    if (scaled >= powersOf10[precision] - 0.5) {
+        exponent++;
+        scaled = scale(value, precision - 1 - exponent);
+    } else if (scaled < powersOf10[precision - 1]) {
+        exponent--;
+        scaled = scale(value, precision - 1 - exponent);
+    }
+
+    // scaling can be an ulp out, so when it is too close to a tie to call
+    // (or out of range of the exact powers) let Qt round it exactly
+    if (precision - 1 - exponent > 22 || precision - 1 - exponent < -22
+        || fabs(scaled - floor(scaled) - 0.5) < 1e-4) {
+        QByteArray exact = QByteArray::number(value, 'g', precision);
+        memcpy(p, exact.constData(), exact.size());
+        p += exact.size();
+        append(text, p - text);
+        return *this;
+    }
+    double mantissa = rint(scaled);
+
+    // its digits, without trailing zeroes
+    char digits[24];
+    quint64 n = (quint64)mantissa;
+    for (int i = precision - 1; i >= 0; i--) { digits[i] = '0' + n % 10; n /= 10; }
+    int count = precision;
+    while (count > 1 && digits[count - 1] == '0') count--;
+
+    int point = exponent + 1; // digits before the decimal point
+    if (point <= -4 || point > precision) {
+
+        // d.ddde+XX
+        *p++ = digits[0];
+        if (count > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, count - 1);
+            p += count - 1;
+        }
+        *p++ = 'e';
+        *p++ = exponent < 0 ? '-' : '+';
+        if (exponent < 0) exponent = -exponent;
+        if (exponent >= 100) *p++ = '0' + exponent / 100;
+        *p++ = '0' + (exponent / 10) % 10;
+        *p++ = '0' + exponent % 10;
+
+    } else if (point <= 0) {
+
+        // 0.000ddd
+        *p++ = '0';
+        *p++ = '.';
+        for (int i = point; i < 0; i++) *p++ = '0';
+        memcpy(p, digits, count);
+        p += count;
+
+    } else {
+
+        // ddd.ddd or ddd000
+        for (int i = 0; i < point || i < count; i++) {
+            if (i == point) *p++ = '.';
+            *p++ = i < count ? digits[i] : '0';
+        }
+    }
+    append(text, p - text);
+    return *this;
 }
 
 // Writes valid .json (validated at www.jsonlint.com)
@@ -329,8 +525,8 @@ JsonFileReader::writeRideFile(Context *, const RideFile *ride, QFile &file) cons
     // truncate existing
     file.resize(0);
 
-    // setup streamer
-    QTextStream out(&file);
+    // setup writer
+    JsonWriter out(file);
 
     // start of document and ride
     out << "{\n\t\"RIDE\":{\n";
@@ -416,8 +612,8 @@ JsonFileReader::writeRideFile(Context *, const RideFile *ride, QFile &file) cons
 
             out << "\t\t\t{ ";
             out << "\"NAME\":\"" << protect(i.name) << "\"";
-            out << ", \"START\": " << QString("%1").arg(i.start);
-            out << ", \"STOP\": " << QString("%1").arg(i.stop) << " }";
+            out << ", \"START\": " << i.start;
+            out << ", \"STOP\": " << i.stop << " }";
         }
         out <<"\n\t\t]";
     }
@@ -436,8 +632,8 @@ JsonFileReader::writeRideFile(Context *, const RideFile *ride, QFile &file) cons
 
             out << "\t\t\t{ ";
             out << "\"NAME\":\"" << protect(i.name) << "\"";
-            out << ", \"START\": " << QString("%1").arg(i.start);
-            out << ", \"VALUE\": " << QString("%1").arg(i.value) << " }";
+            out << ", \"START\": " << i.start;
+            out << ", \"VALUE\": " << i.value << " }";
         }
         out <<"\n\t\t]";
     }
@@ -456,9 +652,9 @@ JsonFileReader::writeRideFile(Context *, const RideFile *ride, QFile &file) cons
 
             out << "\t\t\t{ ";
 
-            if (p->watts > 0) out << " \"WATTS\":" << QString("%1").arg(p->watts);
-            if (p->cad > 0) out << " \"CAD\":" << QString("%1").arg(p->cad);
-            if (p->hr > 0) out << " \"HR\":"  << QString("%1").arg(p->hr);
+            if (p->watts > 0) out << " \"WATTS\":" << p->watts;
+            if (p->cad > 0) out << " \"CAD\":" << p->cad;
+            if (p->hr > 0) out << " \"HR\":"  << p->hr;
 
             // sample points in here!
             out << " }";
@@ -474,6 +670,9 @@ JsonFileReader::writeRideFile(Context *, const RideFile *ride, QFile &file) cons
         out << ",\n\t\t\"SAMPLES\":[\n";
         bool first = true;
 
+        // absent series aren't written at all
+        const RideFileDataPresent *present = ride->areDataPresent();
+
         foreach (RideFilePoint *p, ride->dataPoints()) {
 
             if (first) first=false;
@@ -482,23 +681,21 @@ JsonFileReader::writeRideFile(Context *, const RideFile *ride, QFile &file) cons
             out << "\t\t\t{ ";
 
             // always store time
-            out << "\"SECS\":" << QString("%1").arg(p->secs);
-
-            if (ride->areDataPresent()->km) out << ", \"KM\":" << QString("%1").arg(p->km);
-            if (ride->areDataPresent()->watts) out << ", \"WATTS\":" << QString("%1").arg(p->watts);
-            if (ride->areDataPresent()->nm) out << ", \"NM\":" << QString("%1").arg(p->nm);
-            if (ride->areDataPresent()->cad) out << ", \"CAD\":" << QString("%1").arg(p->cad);
-            if (ride->areDataPresent()->kph) out << ", \"KPH\":" << QString("%1").arg(p->kph);
-            if (ride->areDataPresent()->hr) out << ", \"HR\":"  << QString("%1").arg(p->hr);
-            if (ride->areDataPresent()->alt) out << ", \"ALT\":" << QString("%1").arg(p->alt);
-            if (ride->areDataPresent()->lat)
-                out << ", \"LAT\":" << QString("%1").arg(p->lat, 0, 'g', 11);
-            if (ride->areDataPresent()->lon)
-                out << ", \"LON\":" << QString("%1").arg(p->lon, 0, 'g', 11);
-            if (ride->areDataPresent()->headwind) out << ", \"HEADWIND\":" << QString("%1").arg(p->headwind);
-            if (ride->areDataPresent()->slope) out << ", \"SLOPE\":" << QString("%1").arg(p->slope);
-            if (ride->areDataPresent()->temp && p->temp != RideFile::noTemp) out << ", \"TEMP\":" << QString("%1").arg(p->temp);
-            if (ride->areDataPresent()->lrbalance) out << ", \"LRBALANCE\":" << QString("%1").arg(p->lrbalance);
+            out << "\"SECS\":" << p->secs;
+
+            if (present->km) out << ", \"KM\":" << p->km;
+            if (present->watts) out << ", \"WATTS\":" << p->watts;
+            if (present->nm) out << ", \"NM\":" << p->nm;
+            if (present->cad) out << ", \"CAD\":" << p->cad;
+            if (present->kph) out << ", \"KPH\":" << p->kph;
+            if (present->hr) out << ", \"HR\":"  << p->hr;
+            if (present->alt) out << ", \"ALT\":" << p->alt;
+            if (present->lat) { out << ", \"LAT\":"; out.number(p->lat, 11); }
+            if (present->lon) { out << ", \"LON\":"; out.number(p->lon, 11); }
+            if (present->headwind) out << ", \"HEADWIND\":" << p->headwind;
+            if (present->slope) out << ", \"SLOPE\":" << p->slope;
+            if (present->temp && p->temp != RideFile::noTemp) out << ", \"TEMP\":" << p->temp;
+            if (present->lrbalance) out << ", \"LRBALANCE\":" << p->lrbalance;
 
             // sample points in here!
             out << " }";
@@ -509,8 +706,9 @@ JsonFileReader::writeRideFile(Context *, const RideFile *ride, QFile &file) cons
     // end of ride and document
     out << "\n\t}\n}\n";
 
-    // close
+    // write what's left and close
+    bool written = out.flush();
     file.close();
 
-    return true;
+    return written;
 }
@@ -779,12 +779,15 @@ LTMPlot::createTODCurveData(LTMSettings *settings, MetricDetail metricDetail, QV
 
     for (int i=0; i<(24); i++) x[i]=i;
 
-    foreach (SummaryMetrics rideMetrics, *(settings->data)) {
+    // lookup the metric once, not for every ride
+    int id = RideMetricFactory::instance().metricId(metricDetail.symbol);
+
+    foreach (const SummaryMetrics &rideMetrics, *(settings->data)) {
 
         // filter out unwanted rides
         if (context->isfiltered && !context->filters.contains(rideMetrics.getFileName())) continue;
 
-        double value = rideMetrics.getForSymbol(metricDetail.symbol);
+        double value = id >= 0 ? rideMetrics.getForMetric(id) : rideMetrics.getForSymbol(metricDetail.symbol);
 
         // check values are bounded to stop QWT going berserk
         if (isnan(value) || isinf(value)) value = 0;
@@ -854,7 +857,12 @@ LTMPlot::createCurveData(LTMSettings *settings, MetricDetail metricDetail, QVect
     int lastDay=0;
     unsigned long secondsPerGroupBy=0;
     bool wantZero = (metricDetail.curveStyle == QwtPlotCurve::Steps);
-    foreach (SummaryMetrics rideMetrics, *data) {
+
+    // lookup the metrics once, not for every ride
+    int id = RideMetricFactory::instance().metricId(metricDetail.symbol);
+    int workoutTime = RideMetricFactory::instance().metricId("workout_time");
+
+    foreach (const SummaryMetrics &rideMetrics, *data) {
 
         // filter out unwanted rides but not for PMC type metrics
         // because that needs to be done in the stress calculator
@@ -869,7 +877,7 @@ LTMPlot::createCurveData(LTMSettings *settings, MetricDetail metricDetail, QVect
         if (metricDetail.type == METRIC_MEASURE)
             value = rideMetrics.getText(metricDetail.symbol, "0.0").toDouble();
         else
-            value = rideMetrics.getForSymbol(metricDetail.symbol);
+            value = id >= 0 ? rideMetrics.getForMetric(id) : rideMetrics.getForSymbol(metricDetail.symbol);
 
         // check values are bounded to stop QWT going berserk
         if (isnan(value) || isinf(value)) value = 0;
@@ -888,7 +896,7 @@ LTMPlot::createCurveData(LTMSettings *settings, MetricDetail metricDetail, QVect
         }
 
         if (value || wantZero) {
-            unsigned long seconds = rideMetrics.getForSymbol("workout_time");
+            unsigned long seconds = rideMetrics.getForMetric(workoutTime);
             if (metricDetail.type == METRIC_MEASURE) seconds = 1;
             if (currentDay > lastDay) {
                 if (lastDay && wantZero) {
@@ -685,7 +685,7 @@ LTMSidebar::setSummary(DateRange dateRange)
 
                 const RideMetric *metric = RideMetricFactory::instance().rideMetric(metricname);
 
-                QStringList empty; // filter list not used at present
+                RideSet empty; // filter list not used at present
                 QString value = SummaryMetrics::getAggregated(context, metricname, results, empty, false, context->athlete->useMetricUnits);
 
                 // Maximum Max and Average Average looks nasty, remove from name for display
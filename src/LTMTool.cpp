@@ -1138,7 +1138,7 @@ void
 LTMTool::setFilter(QStringList files)
 {
         _amFiltered = true;
-        filenames = files;
+        filenames = RideSet(files);
 
         emit filterChanged();
 }
@@ -77,7 +77,7 @@ class LTMTool : public QWidget
         int useSelected();
 
         bool isFiltered() { return _amFiltered; }
-        QStringList &filters() { return filenames; }
+        RideSet &filters() { return filenames; }
 
 #ifdef GC_HAVE_LUCENE
         SearchFilterBox *searchBox;
@@ -147,7 +147,7 @@ class LTMTool : public QWidget
         //const Season *dateRange;
 
         bool _amFiltered; // is a filter appling?
-        QStringList filenames; // filters
+        RideSet filenames; // filters
 
         QList<MetricDetail> metrics;
         QTreeWidget *metricTree;
@@ -158,6 +158,11 @@ LTMWindow::LTMWindow(Context *context) :
     connect(context, SIGNAL(rideAdded(RideItem*)), this, SLOT(refresh(void)));
     connect(context, SIGNAL(rideDeleted(RideItem*)), this, SLOT(refresh(void)));
     connect(context, SIGNAL(configChanged()), this, SLOT(refresh()));
+
+    // the rides for the date range are fetched in the background
+    queryId = 0;
+    connect(context->athlete->metricDB->query(), SIGNAL(results(int, QList<SummaryMetrics>, QList<SummaryMetrics>)),
+            this, SLOT(queryResults(int, QList<SummaryMetrics>, QList<SummaryMetrics>)));
 }
 
 LTMWindow::~LTMWindow()
@@ -213,12 +218,8 @@ LTMWindow::refresh()
 
     // refresh for changes to ridefiles / zones
     if (amVisible() == true && context->athlete->metricDB != NULL) {
-        results.clear(); // clear any old data
-        results = context->athlete->metricDB->getAllMetricsFor(settings.start, settings.end);
-        measures.clear(); // clear any old data
-        measures = context->athlete->metricDB->getAllMeasuresFor(settings.start, settings.end);
-        refreshPlot();
-        repaint(); // title changes color when filters change
+        // plotted when the results arrive, see queryResults()
+        queryId = context->athlete->metricDB->query()->getAllMetricsFor(this, settings.start, settings.end, true);
         dirty = false;
     } else {
         dirty = true;
@@ -289,25 +290,34 @@ LTMWindow::filterChanged()
         settings.start = settings.start.addDays(-1*(dow-1));
 
     // we need to get data again and apply filter
-    results.clear(); // clear any old data
-    results = context->athlete->metricDB->getAllMetricsFor(settings.start, settings.end);
-    measures.clear(); // clear any old data
-    measures = context->athlete->metricDB->getAllMeasuresFor(settings.start, settings.end);
+    // plotted when the results arrive, see queryResults()
+    queryId = context->athlete->metricDB->query()->getAllMetricsFor(this, settings.start, settings.end, true);
+}
+
+void
+LTMWindow::queryResults(int id, QList<SummaryMetrics> metrics, QList<SummaryMetrics> measures)
+{
+    // not ours, or we've asked for another date range since
+    if (id != queryId) return;
+
+    results = metrics;
+    this->measures = measures;
 
     // loop through results removing any not in stringlist..
     if (ltmTool->isFiltered()) {
 
         QList<SummaryMetrics> filteredresults;
-        foreach (SummaryMetrics x, results) {
+        foreach (const SummaryMetrics &x, results) {
             if (ltmTool->filters().contains(x.getFileName()))
                 filteredresults << x;
         }
         results = filteredresults;
-        settings.data = &results;
-        settings.measures = &measures;
     }
+    settings.data = &results;
+    settings.measures = &this->measures;
 
     refreshPlot();
+    repaint(); // title changes color when filters change
 }
 
 void
@@ -173,6 +173,7 @@ class LTMWindow : public GcChartWindow
         void saveClicked();
         void applyClicked();
         void refresh();
+        void queryResults(int id, QList<SummaryMetrics> metrics, QList<SummaryMetrics> measures);
         void pointClicked(QwtPlotCurve*, int);
         int groupForDate(QDate, int);
 
@@ -199,6 +200,7 @@ class LTMWindow : public GcChartWindow
 
         // local state
         bool dirty;
+        int queryId; // the results we are waiting for
         LTMSettings settings; // all the plot settings
         QList<SummaryMetrics> results;
         QList<SummaryMetrics> measures;
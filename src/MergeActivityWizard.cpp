@@ -1008,7 +1008,8 @@ MergeConfirm::validatePage()
         previousSecs1 = secs;
     }
 
-
+    // the points were changed directly
+    ride1->ride()->invalidateSeries();
 
     //--------------------------------------
     // STEP 4 : save the new (merged) file
@@ -40,6 +40,7 @@ MetricAggregator::MetricAggregator(Context *context) : QObject(context), context
 {
     colorEngine = new ColorEngine(context);
     dbaccess = new DBAccess(context);
+    metricQuery = new MetricQuery(context, dbaccess);
     connect(context, SIGNAL(configChanged()), this, SLOT(update()));
     connect(context, SIGNAL(rideClean(RideItem*)), this, SLOT(update(void)));
     connect(context, SIGNAL(rideAdded(RideItem*)), this, SLOT(addRide(RideItem*)));
@@ -49,6 +50,7 @@ MetricAggregator::MetricAggregator(Context *context) : QObject(context), context
 MetricAggregator::~MetricAggregator()
 {
     delete colorEngine;
+    delete metricQuery;
     delete dbaccess;
 }
 
@@ -111,6 +113,34 @@ void MetricAggregator::refreshMetrics(QDateTime forceAfterThisDate)
     unsigned long zoneFingerPrint = static_cast<unsigned long>(context->athlete->zones()->getFingerprint())
                                   + static_cast<unsigned long>(context->athlete->hrZones()->getFingerprint()); // checksum of *all* zone data (HR and Power)
 
+    // work out which ride files are out of date, the
+    // refreshers will also check the .cpx for each of them
+    QList<MetricRefreshItem> todo;
+    int updates = 0;
+    while (i.hasNext()) {
+        MetricRefreshItem item;
+        item.name = i.next();
+
+        // if it s missing or out of date then update it!
+        status current = dbStatus.value(item.name);
+        QFileInfo file(context->athlete->home.absolutePath() + "/" + item.name);
+
+        item.update = (current.timestamp < file.lastModified().toTime_t() ||
+                      zoneFingerPrint != current.fingerprint ||
+                      (!forceAfterThisDate.isNull() && item.name >= forceAfterThisDate.toString("yyyy_MM_dd_hh_mm_ss")));
+        item.modify = (current.timestamp > 0);
+        if (item.update) updates++;
+        todo << item;
+    }
+
+    // rather than keep the in memory copy of the metrics table in step
+    // ride by ride, it is loaded again when it is next needed
+    if (updates) dbaccess->unloadStore();
+
+    // the refreshers cannot use the metric db to get the
+    // athlete weight so we fetch the measures for them now
+    QList<SummaryMetrics> measures = dbaccess->getAllMeasuresFor(QDateTime::fromString("Jan 1 00:00:00 1900"), QDateTime::currentDateTime());
+
     // update statistics for ride files which are out of date
     // showing a progress bar as we go
     QTime elapsed;
@@ -128,18 +158,34 @@ void MetricAggregator::refreshMetrics(QDateTime forceAfterThisDate)
     QTextStream out(&log);
     out << "METRIC REFRESH STARTS: " << QDateTime::currentDateTime().toString() + "\r\n";
 
-    while (i.hasNext()) {
-        QString name = i.next();
-        QFile file(context->athlete->home.absolutePath() + "/" + name);
+    // start the refreshers, one per core, results are bounded
+    // so we don't hold too many rides in memory at once
+    int workers = qMax(1, QThread::idealThreadCount());
+    MetricRefreshQueue queue(todo, workers, workers * 2);
+    QList<MetricRefresher*> refreshers;
+    for (int n=0; n<workers; n++) {
+        MetricRefresher *refresher = new MetricRefresher(this, &queue, measures);
+        refreshers << refresher;
+        refresher->start();
+    }
 
-        // if it s missing or out of date then update it!
-        status current = dbStatus.value(name);
-        unsigned long dbTimeStamp = current.timestamp;
-        unsigned long fingerprint = current.fingerprint;
+    // we are the single writer to the db
+    bool cancelled = false;
+    QString name;
+    while (!queue.isFinished()) {
 
-        RideFile *ride = NULL;
+        MetricRefreshItem item;
+        if (queue.take(item, 100)) {
 
-        processed++;
+            processed++;
+            name = item.name;
+
+            if (item.ride) {
+                out << "Updating statistics: " << item.name << "\r\n";
+                writeRide(item.summary, item.ride, zoneFingerPrint, item.modify);
+                delete item.ride; // free memory
+            }
+        }
 
         // create the dialog if we need to show progress for long running uodate
         long elapsedtime = elapsed.elapsed();
@@ -163,44 +209,21 @@ void MetricAggregator::refreshMetrics(QDateTime forceAfterThisDate)
         }
         QApplication::processEvents();
 
-        if (dbTimeStamp < QFileInfo(file).lastModified().toTime_t() ||
-            zoneFingerPrint != fingerprint ||
-            (!forceAfterThisDate.isNull() && name >= forceAfterThisDate.toString("yyyy_MM_dd_hh_mm_ss"))) {
-            QStringList errors;
-
-            // log
-            out << "Opening ride: " << name << "\r\n";
-
-            // read file and process it if we didn't already...
-            if (ride == NULL) ride = RideFileFactory::instance().openRideFile(context, file, errors);
-
-            out << "File open completed: " << name << "\r\n";
-
-            if (ride != NULL) {
-
-                out << "Getting weight: " << name << "\r\n";
-                ride->getWeight();
-                out << "Updating statistics: " << name << "\r\n";
-                importRide(context->athlete->home, ride, name, zoneFingerPrint, (dbTimeStamp > 0));
-
-            }
-        }
-
-        // update cache (will check timestamps itself)
-        // if ride wasn't opened it will do it itself
-        // we only want to check so passing check=true
-        // because we don't actually want the results now
-        RideFileCache updater(context, context->athlete->home.absolutePath() + "/" + name, ride, true);
-
-        // free memory - if needed
-        if (ride) delete ride;
-
-        if (bar && bar->wasCanceled()) {
+        // refreshers will finish what they are doing
+        // and we still write whatever they hand back
+        if (bar && bar->wasCanceled() && !cancelled) {
             out << "METRIC REFRESH CANCELLED\r\n";
-            break;
+            queue.abort();
+            cancelled = true;
         }
     }
 
+    // they have all exited by now
+    foreach (MetricRefresher *refresher, refreshers) {
+        refresher->wait();
+        delete refresher;
+    }
+
     // now zap the progress bar
     if (bar) delete bar;
 
@@ -243,11 +266,19 @@ void MetricAggregator::update() {
     refreshMetrics();
 }
 
-bool MetricAggregator::importRide(QDir path, RideFile *ride, QString fileName, unsigned long fingerprint, bool modify)
+bool MetricAggregator::importRide(QDir, RideFile *ride, QString fileName, unsigned long fingerprint, bool modify)
 {
     SummaryMetrics summaryMetric;
-    QFile file(path.absolutePath() + "/" + fileName);
 
+    if (!computeRide(ride, fileName, summaryMetric)) return false;
+    writeRide(summaryMetric, ride, fingerprint, modify);
+    return true;
+}
+
+// compute the metrics for a ride, does not touch the db or
+// the gui so it can be called from the refresher threads
+bool MetricAggregator::computeRide(RideFile *ride, QString fileName, SummaryMetrics &summaryMetric)
+{
     QRegExp rx = RideFileFactory::instance().rideFileRegExp();
     if (!rx.exactMatch(fileName)) {
         return false; // not a ridefile!
@@ -276,6 +307,12 @@ bool MetricAggregator::importRide(QDir path, RideFile *ride, QString fileName, u
         summaryMetric.setForSymbol(factory.metricName(i), computed.value(factory.metricName(i))->value(true));
     }
 
+    return true;
+}
+
+// write the computed metrics away, gui thread only
+void MetricAggregator::writeRide(SummaryMetrics &summaryMetric, RideFile *ride, unsigned long fingerprint, bool modify)
+{
     // what color will this ride be?
     QColor color = colorEngine->colorFor(ride->getTag(context->athlete->rideMetadata()->getColorField(), ""));
 
@@ -283,10 +320,108 @@ bool MetricAggregator::importRide(QDir path, RideFile *ride, QString fileName, u
 #ifdef GC_HAVE_LUCENE
     context->athlete->lucene->importRide(&summaryMetric, ride, color, fingerprint, modify);
 #endif
+}
+
+/*----------------------------------------------------------------------
+ * Metric refresh pipeline
+ *----------------------------------------------------------------------*/
+MetricRefreshQueue::MetricRefreshQueue(QList<MetricRefreshItem> todo, int workers, int capacity)
+    : todo(todo), workers(workers), capacity(capacity), aborted(false)
+{
+}
+
+bool
+MetricRefreshQueue::next(MetricRefreshItem &item)
+{
+    QMutexLocker locker(&lock);
+    if (aborted || todo.isEmpty()) return false;
+    item = todo.takeFirst();
+    return true;
+}
+
+void
+MetricRefreshQueue::done(MetricRefreshItem &item)
+{
+    QMutexLocker locker(&lock);
+    while (results.count() >= capacity) notFull.wait(&lock);
+    results << item;
+    notEmpty.wakeOne();
+}
+
+void
+MetricRefreshQueue::finished()
+{
+    QMutexLocker locker(&lock);
+    workers--;
+    notEmpty.wakeOne();
+}
 
+bool
+MetricRefreshQueue::take(MetricRefreshItem &item, int msecs)
+{
+    QMutexLocker locker(&lock);
+    if (results.isEmpty() && workers) notEmpty.wait(&lock, msecs);
+    if (results.isEmpty()) return false;
+
+    item = results.takeFirst();
+    notFull.wakeOne();
     return true;
 }
 
+bool
+MetricRefreshQueue::isFinished()
+{
+    QMutexLocker locker(&lock);
+    return workers == 0 && results.isEmpty();
+}
+
+void
+MetricRefreshQueue::abort()
+{
+    QMutexLocker locker(&lock);
+    aborted = true;
+}
+
+void
+MetricRefresher::run()
+{
+    Context *context = aggregator->context;
+
+    MetricRefreshItem item;
+    while (queue->next(item)) {
+
+        QString path = context->athlete->home.absolutePath() + "/" + item.name;
+
+        // open the ride if the metrics or cpx need it
+        if (item.update || !RideFileCache::isCurrent(path)) {
+            QStringList errors;
+            QFile file(path);
+            item.ride = RideFileFactory::instance().openRideFile(context, file, errors);
+        }
+
+        if (item.ride) {
+            item.ride->getWeight(measures); // before the metrics and cpx need it
+
+            // metrics if out of date
+            if (item.update) item.update = aggregator->computeRide(item.ride, item.name, item.summary);
+
+            // update cache (will check timestamps itself)
+            RideFileCache updater(context, path, item.ride, true);
+
+            // we only keep it to write if we need to
+            if (!item.update) {
+                delete item.ride;
+                item.ride = NULL;
+            }
+        }
+
+        // hand back to the writer
+        queue->done(item);
+        item = MetricRefreshItem();
+    }
+    queue->finished();
+}
+
 void
 MetricAggregator::importMeasure(SummaryMetrics *sm)
 {
@@ -312,7 +447,9 @@ MetricAggregator::writeAsCSV(QString filename)
     QTextStream out(&file);
 
     // write headings
+    const RideMetricFactory &factory = RideMetricFactory::instance();
     out<<"date, time, filename,";
+    for (int j=0; j<factory.metricCount(); j++) out<<factory.metricName(j)<<",";
     QMapIterator<QString, double>i(all[0].values());
     while (i.hasNext()) {
         i.next();
@@ -326,6 +463,7 @@ MetricAggregator::writeAsCSV(QString filename)
            <<x.getRideDate().time().toString()<<","
            <<x.getFileName()<<",";
 
+        for (int j=0; j<factory.metricCount(); j++) out<<x.getForMetric(j)<<",";
         QMapIterator<QString, double>i(x.values());
         while (i.hasNext()) {
             i.next();
@@ -342,6 +480,13 @@ MetricAggregator::getAllMetricsFor(DateRange dr)
     return getAllMetricsFor(QDateTime(dr.from, QTime(0,0,0)), QDateTime(dr.to, QTime(23,59,59)));
 }
 
+const MetricStore &
+MetricAggregator::metricStore()
+{
+    if (context->athlete->isclean == false) refreshMetrics(); // get them up-to-date
+    return dbaccess->metricStore();
+}
+
 QList<SummaryMetrics>
 MetricAggregator::getAllMetricsFor(QDateTime start, QDateTime end)
 {
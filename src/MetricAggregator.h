@@ -31,6 +31,11 @@
 #include "Context.h"
 #include "DBAccess.h"
 #include "Colors.h"
+#include "MetricQuery.h"
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
 
 class MetricAggregator : public QObject
 {
@@ -47,12 +52,14 @@ class MetricAggregator : public QObject
         void refreshMetrics(QDateTime forceAfterThisDate);
         void getFirstLast(QDate &, QDate &);
         DBAccess *db() { return dbaccess; }
+        MetricQuery *query() { return metricQuery; } // in the background
         SummaryMetrics getAllMetricsFor(QString filename); // for a single ride
         QList<SummaryMetrics> getAllMetricsFor(QDateTime start, QDateTime end);
         QList<SummaryMetrics> getAllMetricsFor(DateRange);
         QList<SummaryMetrics> getAllMeasuresFor(QDateTime start, QDateTime end);
         QList<SummaryMetrics> getAllMeasuresFor(DateRange);
         SummaryMetrics getRideMetrics(QString filename);
+        const MetricStore &metricStore(); // all rides, brought up to date first
         void writeAsCSV(QString filename); // export all...
 
     signals:
@@ -64,13 +71,70 @@ class MetricAggregator : public QObject
         void importMeasure(SummaryMetrics *sm);
 
     private:
+        friend class MetricRefresher; // computes metrics for us during refresh
+
         Context *context;
         DBAccess *dbaccess;
+        MetricQuery *metricQuery;
 
 	    typedef QHash<QString,RideMetric*> MetricMap;
 	    bool importRide(QDir path, RideFile *ride, QString fileName, unsigned long, bool modify);
+        bool computeRide(RideFile *ride, QString fileName, SummaryMetrics &summaryMetric); // thread safe
+        void writeRide(SummaryMetrics &summaryMetric, RideFile *ride, unsigned long, bool modify);
 	    MetricMap metrics;
         ColorEngine *colorEngine;
 };
 
+// The metric refresh is a pipeline; a pool of MetricRefresher threads
+// open each ride, compute its metrics and update its .cpx. The results
+// are handed back through the MetricRefreshQueue to refreshMetrics()
+// which is the single writer to the database, all within one transaction.
+struct MetricRefreshItem
+{
+    QString name;       // ride filename
+    bool update;        // metrics are out of date
+    bool modify;        // already in the db
+    RideFile *ride;     // set by the refresher if opened
+    SummaryMetrics summary;
+
+    MetricRefreshItem() : update(false), modify(false), ride(NULL) {}
+};
+
+class MetricRefreshQueue
+{
+    public:
+        MetricRefreshQueue(QList<MetricRefreshItem> todo, int workers, int capacity);
+
+        // refresher side
+        bool next(MetricRefreshItem &item);     // false when nothing left to do
+        void done(MetricRefreshItem &item);     // blocks whilst the results are full
+        void finished();                        // refresher is exiting
+
+        // writer side
+        bool take(MetricRefreshItem &item, int msecs); // wait for a result
+        bool isFinished();                             // all refreshers exited and results drained
+        void abort();                                  // stop handing out work
+
+    private:
+        QMutex lock;
+        QWaitCondition notFull, notEmpty;
+
+        QList<MetricRefreshItem> todo, results;
+        int workers, capacity;
+        bool aborted;
+};
+
+class MetricRefresher : public QThread
+{
+    public:
+        MetricRefresher(MetricAggregator *aggregator, MetricRefreshQueue *queue, QList<SummaryMetrics> &measures)
+        : aggregator(aggregator), queue(queue), measures(measures) {}
+        void run();
+
+    private:
+        MetricAggregator *aggregator;
+        MetricRefreshQueue *queue;
+        QList<SummaryMetrics> &measures; // for weight, fetched up front
+};
+
 #endif /* METRICAGGREGATOR_H_ */
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2026 GoldenCheetah Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "MetricQuery.h"
+#include "MetricAggregator.h"
+#include "Context.h"
+#include "Athlete.h"
+
+MetricQuery::MetricQuery(Context *context, DBAccess *dbaccess) :
+    context(context), dbaccess(dbaccess), running(NULL), abandon(0), stopping(false), lastId(0)
+{
+    databaseName = dbaccess->databaseName();
+
+    // results are queued across to the gui thread
+    qRegisterMetaType<QList<SummaryMetrics> >("QList<SummaryMetrics>");
+}
+
+MetricQuery::~MetricQuery()
+{
+    lock.lock();
+    stopping = true;
+    abandon = 1;
+    wake.wakeAll();
+    lock.unlock();
+
+    wait();
+}
+
+int
+MetricQuery::getAllMetricsFor(QObject *requester, QDateTime from, QDateTime to, bool measures)
+{
+    // the db is only written by the refresh, which needs to happen
+    // in the gui thread, but it is only left dirty after an import
+    if (context->athlete->isclean == false) context->athlete->metricDB->refreshMetrics();
+
+    // null date range fetches all, see DBAccess::getAllMetricsFor()
+    if (from == QDateTime()) from = QDateTime::currentDateTime().addYears(-10);
+    if (to == QDateTime()) to = QDateTime::currentDateTime().addYears(+10);
+
+    Request add;
+    add.requester = requester;
+    add.start = from;
+    add.end = to;
+    add.measures = measures;
+    add.metricsSelect = dbaccess->metricsSelect();
+    if (measures) add.measuresSelect = dbaccess->measuresSelect();
+
+    // replaces anything it asked for before
+    cancel(requester);
+
+    QMutexLocker locker(&lock);
+    add.id = ++lastId;
+    queue << add;
+    wake.wakeAll();
+
+    if (!isRunning()) start();
+    return add.id;
+}
+
+void
+MetricQuery::cancel(QObject *requester)
+{
+    QMutexLocker locker(&lock);
+
+    for (int i=0; i<queue.count(); i++)
+        if (queue[i].requester == requester) queue.removeAt(i--);
+
+    if (running == requester) abandon = 1;
+}
+
+void
+MetricQuery::run()
+{
+    // our own connection, only ever used in this thread
+    QString connectionName = QString("%1_query").arg(context->athlete->cyclist);
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        db.setDatabaseName(databaseName);
+        db.open();
+
+        forever {
+
+            lock.lock();
+            while (queue.isEmpty() && !stopping) wake.wait(&lock);
+            if (stopping) {
+                lock.unlock();
+                break;
+            }
+            Request request = queue.takeFirst();
+            running = request.requester;
+            abandon = 0;
+            lock.unlock();
+
+            QList<SummaryMetrics> metrics, measures;
+            metrics = select(db, request.metricsSelect, "ride_date", request.start.date(), request.end.date());
+            if (request.measures)
+                measures = select(db, request.measuresSelect, "measure_date", request.start.date(), request.end.date());
+
+            lock.lock();
+            bool cancelled = abandon;
+            running = NULL;
+            lock.unlock();
+
+            if (!cancelled) emit results(request.id, metrics, measures);
+        }
+
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+}
+
+QList<SummaryMetrics>
+MetricQuery::select(QSqlDatabase db, const DBSelect &select, const QString &where, QDate start, QDate end)
+{
+    QList<SummaryMetrics> returning;
+
+    QString statement = select.statement + QString(" where DATE(%1) >=DATE(:start) AND DATE(%1) <=DATE(:end) "
+                                                   " ORDER BY %1;").arg(where);
+
+    QSqlQuery query(db);
+    query.prepare(statement);
+    query.bindValue(":start", start);
+    query.bindValue(":end", end);
+    query.exec();
+
+    while (query.next() && !abandon) returning << DBAccess::readRow(select, query);
+
+    return returning;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2026 GoldenCheetah Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _GC_MetricQuery_h
+#define _GC_MetricQuery_h 1
+#include "GoldenCheetah.h"
+
+#include "SummaryMetrics.h"
+#include "DBAccess.h"
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QList>
+
+class Context;
+
+// MetricQuery runs queries on the metrics db in a background thread,
+// with its own connection, so the charts don't block painting while
+// the rides for a date range are fetched.
+//
+// A chart asks for a date range and is given an id for the query, the
+// results are signalled with that id when they are ready. Asking again
+// before they arrive cancels the earlier query, so a chart only ever
+// gets the results for the last date range it asked for.
+class MetricQuery : public QThread
+{
+    Q_OBJECT
+    G_OBJECT
+
+    public:
+        MetricQuery(Context *context, DBAccess *dbaccess);
+        ~MetricQuery();
+
+        // rides between from and to, and measures too if asked
+        int getAllMetricsFor(QObject *requester, QDateTime from, QDateTime to, bool measures = false);
+
+        // the requester isn't interested any more e.g. being deleted
+        void cancel(QObject *requester);
+
+    signals:
+        void results(int id, QList<SummaryMetrics> metrics, QList<SummaryMetrics> measures);
+
+    protected:
+        void run();
+
+    private:
+
+        struct Request {
+            int id;
+            QObject *requester;
+            QDateTime start, end;
+            bool measures;
+
+            // taken when asked, the schema may change
+            DBSelect metricsSelect, measuresSelect;
+        };
+
+        QList<SummaryMetrics> select(QSqlDatabase db, const DBSelect &select, const QString &where, QDate start, QDate end);
+
+        Context *context;
+        DBAccess *dbaccess;
+        QString databaseName;
+
+        QMutex lock;
+        QWaitCondition wake;
+        QList<Request> queue;
+        QObject *running; // requester of the query being run
+        QAtomicInt abandon; // the running query has been cancelled
+        bool stopping;
+        int lastId;
+};
+#endif // _GC_MetricQuery_h
@@ -91,7 +91,7 @@ class PerformanceManagerWindow : public GcWindow
 	QSharedPointer<QSettings> settings;
 
 	void setPMSliderDates();
-    QStringList filter;
+    RideSet filter;
     bool isfiltered;
 
 };
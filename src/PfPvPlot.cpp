@@ -374,16 +374,21 @@ PfPvPlot::setData(RideItem *_rideItem)
         long tot_cad = 0;
         long tot_cad_points = 0;
 
-        foreach(const RideFilePoint *p1, ride->dataPoints()) {
+        // both will be empty if not present
+        RideFileSeries watts = ride->series(RideFile::watts);
+        RideFileSeries cad = ride->series(RideFile::cad);
+        int count = qMin(watts.count, cad.count);
 
-            if (p1->watts != 0 && p1->cad != 0) {
+        for (int i=0; i<count; i++) {
 
-                double aepf = (p1->watts * 60.0) / (p1->cad * cl_ * 2.0 * PI);
-                double cpv = (p1->cad * cl_ * 2.0 * PI) / 60.0;
+            if (watts[i] != 0 && cad[i] != 0) {
+
+                double aepf = (watts[i] * 60.0) / (cad[i] * cl_ * 2.0 * PI);
+                double cpv = (cad[i] * cl_ * 2.0 * PI) / 60.0;
 
                 if (aepf <= 2500) { // > 2500 newtons is our out of bounds
                     dataSet.insert(std::make_pair<double, double>(aepf, cpv));
-                    tot_cad += p1->cad;
+                    tot_cad += cad[i];
                     tot_cad_points++;
                 }
             }
@@ -622,7 +622,7 @@ PowerHist::setData(RideFileCache *cache)
 
 void 
 PowerHist::setData(QList<SummaryMetrics>&results, QString totalMetric, QString distMetric,
-                     bool isFiltered, QStringList files)
+                     bool isFiltered, const RideSet &files)
 {
     // what metrics are we plotting?
     source = Metric;
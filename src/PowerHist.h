@@ -119,7 +119,7 @@ class PowerHist : public QwtPlot
 
         // set data from metrics
         void setData(QList<SummaryMetrics>&results, QString totalMetric, QString distMetric,
-                     bool isFiltered, QStringList files);
+                     bool isFiltered, const RideSet &files);
 
         void setlnY(bool value);
         void setWithZeros(bool value);
@@ -19,7 +19,9 @@
 #include "PwxRideFile.h"
 #include "Athlete.h"
 #include "Settings.h"
+#include "XmlTokenizer.h"
 #include <QDomDocument>
+#include <QBuffer>
 #include <QVector>
 
 #include <QDebug>
@@ -28,36 +30,53 @@ static int pwxFileReaderRegistered =
     RideFileFactory::instance().registerReader(
         "pwx", "TrainingPeaks PWX", new PwxFileReader());
 
-RideFile *
-PwxFileReader::openRideFile(QFile &file, QStringList &errors, QList<RideFile*>*) const
-{
-    QDomDocument doc("TrainingPeaks PWX");
-    if (!file.open(QIODevice::ReadOnly)) {
-        errors << "Could not open file.";
-        return NULL;
-    }
+// the pwx elements we look at
+struct PwxTag {
+    enum { Workout, Athlete, Name, Weight, Code, Goal, SportType, Cmt, Device,
+           Make, Model, Extension, Time, Segment, SummaryData, Beginning, Duration,
+           Sample, TimeOffset, Hr, Spd, Pwr, Torq, Cad, Dist, Lat, Lon, Alt, Temp };
+};
 
-    bool parsed = doc.setContent(&file);
-    file.close();
-    if (!parsed) {
-        errors << "Could not parse file.";
-        return NULL;
-    }
-
-    return PwxFromDomDoc(doc, errors);
-}
-
-RideFile *
-PwxFileReader::PwxFromDomDoc(QDomDocument doc, QStringList &errors) const
+static RideFile *
+pwxFromDevice(QIODevice &device, QStringList &errors)
 {
+    XmlTokenizer xml(&device);
+    xml.addTag("workout", PwxTag::Workout);
+    xml.addTag("athlete", PwxTag::Athlete);
+    xml.addTag("name", PwxTag::Name);
+    xml.addTag("weight", PwxTag::Weight);
+    xml.addTag("code", PwxTag::Code);
+    xml.addTag("goal", PwxTag::Goal);
+    xml.addTag("sportType", PwxTag::SportType);
+    xml.addTag("cmt", PwxTag::Cmt);
+    xml.addTag("device", PwxTag::Device);
+    xml.addTag("make", PwxTag::Make);
+    xml.addTag("model", PwxTag::Model);
+    xml.addTag("extension", PwxTag::Extension);
+    xml.addTag("time", PwxTag::Time);
+    xml.addTag("segment", PwxTag::Segment);
+    xml.addTag("summarydata", PwxTag::SummaryData);
+    xml.addTag("beginning", PwxTag::Beginning);
+    xml.addTag("duration", PwxTag::Duration);
+    xml.addTag("sample", PwxTag::Sample);
+    xml.addTag("timeoffset", PwxTag::TimeOffset);
+    xml.addTag("hr", PwxTag::Hr);
+    xml.addTag("spd", PwxTag::Spd);
+    xml.addTag("pwr", PwxTag::Pwr);
+    xml.addTag("torq", PwxTag::Torq);
+    xml.addTag("cad", PwxTag::Cad);
+    xml.addTag("dist", PwxTag::Dist);
+    xml.addTag("lat", PwxTag::Lat);
+    xml.addTag("lon", PwxTag::Lon);
+    xml.addTag("alt", PwxTag::Alt);
+    xml.addTag("temp", PwxTag::Temp);
+
     RideFile *rideFile = new RideFile();
-    QDomElement root = doc.documentElement();
-    QDomNode workout = root.firstChildElement("workout");
-    QDomNode node = workout.firstChild();
 
-    // can arrive at any time, so lets cache them
-    // and sort out at the end
-    QDateTime rideDate;
+    // the elements we are in, pwx/workout/sample/hr is 4 deep
+    QVector<int> path;
+    bool root = false;
+    int workouts = 0;
 
     int intervals = 0;
     int samples = 0;
@@ -66,190 +85,184 @@ PwxFileReader::PwxFromDomDoc(QDomDocument doc, QStringList &errors) const
     double rtime = 0;
     double rdist = 0;
 
-    while (!node.isNull()) {
+    // the device, segment and sample being read
+    QString make, model, deviceinfo;
+    RideFileInterval segment;
+    bool named = false, hasBeginning = false, hasDuration = false;
+    double duration = 0;
+    RideFilePoint add;
 
-        // athlete
-        if (node.nodeName() == "athlete") {
+    for (bool done = false; !done; ) {
 
-            QDomElement name = node.firstChildElement("name");
-            if (!name.isNull()) {
-                rideFile->setTag("Athlete Name", name.text());
-            }
-
-            QDomElement weight = node.firstChildElement("weight");
-            if (!weight.isNull()) {
-                rideFile->setTag("Weight", weight.text());
-            }
-
-        // workout code
-        } else if (node.nodeName() == "code") {
-
-            QDomElement code = node.toElement();
-            rideFile->setTag("Workout Code", code.text());
-
-        // goal / objective
-        } else if (node.nodeName() == "goal") {
-
-            QDomElement goal = node.toElement();
-            rideFile->setTag("Objective", goal.text());
-
-        // sport
-        } else if (node.nodeName() == "sportType") {
-
-            QDomElement sport = node.toElement();
-            rideFile->setTag("Sport", sport.text());
+        switch (xml.next()) {
 
-        // notes
-        } else if (node.nodeName() == "cmt") {
+        case XmlTokenizer::StartElement:
+            root = true;
+            path << xml.tag();
+            if (path.size() == 2 && xml.tag() == PwxTag::Workout) workouts++;
 
-            // Add the PWX cmt tag as notes
-            QDomElement notes = node.toElement();
-            rideFile->setTag("Notes", notes.text());
+            // we only read the first workout
+            if (path.size() != 3 || path[1] != PwxTag::Workout || workouts != 1) break;
 
-        // device type and info
-        } else if (node.nodeName() == "device") {
-
-            QString devicetype;
-            // make and model
-            QDomElement make = node.firstChildElement("make");
-            if (!make.isNull()) devicetype = make.text();
-            QDomElement model = node.firstChildElement("model");
-            if (!model.isNull()) {
-                if (devicetype != "") devicetype += " ";
-                devicetype += model.text();
+            switch (xml.tag()) {
+            case PwxTag::Device:
+                make = model = deviceinfo = QString();
+                break;
+            case PwxTag::Segment:
+                segment = RideFileInterval();
+                named = hasBeginning = hasDuration = false;
+                break;
+            case PwxTag::Sample:
+                add = RideFilePoint();
+                add.temp = 0.0;
+                break;
             }
-            rideFile->setDeviceType(devicetype);
-            rideFile->setFileFormat("Peaksware Data File (pwx)");
-
-            // device settings data
-            QString deviceinfo;
-            QDomElement extension = node.firstChildElement("extension");
-            if (!extension.isNull()) {
-                for (QDomElement info=extension.firstChildElement();
-                    !info.isNull();
-                    info = info.nextSiblingElement()) {
-                    deviceinfo += info.tagName();
+            break;
+
+        case XmlTokenizer::EndElement:
+        {
+            if (path.isEmpty()) break;
+
+            int depth = path.size();
+            int tag = xml.tag();
+
+            if (depth >= 3 && path[1] == PwxTag::Workout && workouts == 1) {
+
+                int parent = path[depth-2];
+
+                if (depth == 3) {
+
+                    switch (tag) {
+
+                    // workout code
+                    case PwxTag::Code: rideFile->setTag("Workout Code", xml.text()); break;
+
+                    // goal / objective
+                    case PwxTag::Goal: rideFile->setTag("Objective", xml.text()); break;
+
+                    // sport
+                    case PwxTag::SportType: rideFile->setTag("Sport", xml.text()); break;
+
+                    // notes, add the PWX cmt tag as notes
+                    case PwxTag::Cmt: rideFile->setTag("Notes", xml.text()); break;
+
+                    // start date/time
+                    case PwxTag::Time:
+                        rideFile->setStartTime(QDateTime::fromString(xml.text(), Qt::ISODate));
+                        break;
+
+                    // device type and info
+                    case PwxTag::Device:
+                        if (make != "" && model != "") make += " ";
+                        rideFile->setDeviceType(make + model);
+                        rideFile->setFileFormat("Peaksware Data File (pwx)");
+                        rideFile->setTag("Device Info", deviceinfo);
+                        break;
+
+                    // interval data
+                    case PwxTag::Segment:
+                        if (!named) segment.name = QString("Interval #%1").arg(++intervals);
+                        if (hasBeginning && hasDuration)
+                            rideFile->addInterval(segment.start, segment.start + duration, segment.name);
+                        break;
+
+                    // data points: offset, hr, spd, pwr, torq, cad, dist, lat, lon, alt, temp
+                    case PwxTag::Sample:
+                        // do we need to calculate distance?
+                        if (add.km == 0.0 && samples) {
+                            // delta secs * kph/3600
+                            add.km = rdist + ((add.secs - rtime) * (add.kph/3600));
+                        }
+
+                        // running totals
+                        samples++;
+                        rtime = add.secs;
+                        rdist = add.km;
+
+                        // add the data point
+                        rideFile->appendPoint(add.secs, add.cad, add.hr, add.km, add.kph,
+                                add.nm, add.watts, add.alt, add.lon, add.lat, add.headwind,
+                                add.slope, add.temp, add.lrbalance, add.interval);
+                        break;
+                    }
+
+                } else if (depth == 4 && parent == PwxTag::Athlete) {
+
+                    if (tag == PwxTag::Name) rideFile->setTag("Athlete Name", xml.text());
+                    else if (tag == PwxTag::Weight) rideFile->setTag("Weight", xml.text());
+
+                } else if (depth == 4 && parent == PwxTag::Device) {
+
+                    if (tag == PwxTag::Make) make = xml.text();
+                    else if (tag == PwxTag::Model) model = xml.text();
+
+                } else if (depth == 4 && parent == PwxTag::Segment) {
+
+                    if (tag == PwxTag::Name) {
+                        segment.name = xml.text();
+                        named = true;
+                    }
+
+                } else if (depth == 4 && parent == PwxTag::Sample) {
+
+                    switch (tag) {
+                    case PwxTag::TimeOffset: add.secs = xml.number(); break; // offset (secs)
+                    case PwxTag::Hr: add.hr = xml.number(); break;
+                    case PwxTag::Spd: add.kph = xml.number() * 3.6; break; // meters per second converted to kph
+                    case PwxTag::Pwr:
+                        add.watts = xml.number();
+                        // NOTE! undo the fudge to set zero values to
+                        //       1 in the writer (below). This is to keep
+                        //       the TP upload web-service happy with zero values
+                        if (add.watts == 1) add.watts = 0.0;
+                        break;
+                    case PwxTag::Torq: add.nm = xml.number(); break;
+                    case PwxTag::Cad: add.cad = xml.number(); break;
+                    case PwxTag::Dist: add.km = xml.number() / 1000; break;
+                    case PwxTag::Lat: add.lat = xml.number(); break;
+                    case PwxTag::Lon: add.lon = xml.number(); break;
+                    case PwxTag::Alt: add.alt = xml.number(); break;
+                    case PwxTag::Temp: add.temp = xml.number(); break;
+                    }
+
+                } else if (depth == 5 && parent == PwxTag::Extension && path[2] == PwxTag::Device) {
+
+                    // device settings data
+                    deviceinfo += xml.name();
                     deviceinfo += ": ";
-                    deviceinfo += info.text();
+                    deviceinfo += xml.text();
                     deviceinfo += '\n';
-                }
-            }
-            rideFile->setTag("Device Info", deviceinfo);
-
-        // start date/time
-        } else if (node.nodeName() == "time") {
-            QDomElement date = node.toElement();
-            rideDate = QDateTime::fromString(date.text(), Qt::ISODate);
-            rideFile->setStartTime(rideDate);
-
-        // interval data
-        } else if (node.nodeName() == "segment") {
-            RideFileInterval add;
-
-            // name
-            QDomElement name = node.firstChildElement("name");
-            if (!name.isNull()) add.name = name.text();
-            else add.name = QString("Interval #%1").arg(++intervals);
-
-            QDomElement summary = node.firstChildElement("summarydata");
-            if (!summary.isNull()) {
-
-                // start
-                QDomElement beginning = summary.firstChildElement("beginning");
-                if (!beginning.isNull()) add.start = beginning.text().toDouble();
-                else add.start = -1;
-
-                // duration - convert to end
-                QDomElement duration = summary.firstChildElement("duration");
-                if (!duration.isNull() && add.start != -1)
-                    add.stop = duration.text().toDouble() + add.start;
-                else
-                    add.stop = -1;
-
-                // add interval
-                if (add.start != -1 && add.stop != -1) {
-                    rideFile->addInterval(add.start, add.stop, add.name);
-                }
-            }
 
-        // data points: offset, hr, spd, pwr, torq, cad, dist, lat, lon, alt, temp
-        } else if (node.nodeName() == "sample") {
-            RideFilePoint add;
+                } else if (depth == 5 && parent == PwxTag::SummaryData && path[2] == PwxTag::Segment) {
 
-            // offset (secs)
-            QDomElement off = node.firstChildElement("timeoffset");
-            if (!off.isNull()) add.secs = off.text().toDouble();
-            else add.secs = 0.0;
-            // hr
-            QDomElement hr = node.firstChildElement("hr");
-            if (!hr.isNull()) add.hr = hr.text().toDouble();
-            else add.hr = 0.0;
-            // spd in meters per second converted to kph
-            QDomElement spd = node.firstChildElement("spd");
-            if (!spd.isNull()) add.kph = spd.text().toDouble() * 3.6;
-            else add.kph = 0.0;
-            // pwr
-            QDomElement pwr = node.firstChildElement("pwr");
-            if (!pwr.isNull()) {
-                add.watts = pwr.text().toDouble();
-                // NOTE! undo the fudge to set zero values to
-                //       1 in the writer (below). This is to keep
-                //       the TP upload web-service happy with zero values
-                if (add.watts == 1) add.watts = 0.0;
-            } else add.watts = 0.0;
-            // torq
-            QDomElement torq = node.firstChildElement("torq");
-            if (!torq.isNull()) add.nm = torq.text().toDouble();
-            else add.nm = 0.0;
-            // cad
-            QDomElement cad = node.firstChildElement("cad");
-            if (!cad.isNull()) add.cad = cad.text().toDouble();
-            else add.cad = 0.0;
-            // dist
-            QDomElement dist = node.firstChildElement("dist");
-            if (!dist.isNull()) add.km = dist.text().toDouble() /1000;
-            else add.km = 0.0;
-
-            // lat
-            QDomElement lat = node.firstChildElement("lat");
-            if (!lat.isNull()) add.lat = lat.text().toDouble();
-            else add.lat = 0.0;
-            // lon
-            QDomElement lon = node.firstChildElement("lon");
-            if (!lon.isNull()) add.lon = lon.text().toDouble();
-            else add.lon = 0.0;
-            // alt
-            QDomElement alt = node.firstChildElement("alt");
-            if (!alt.isNull()) add.alt = alt.text().toDouble();
-            else add.alt = 0.0;
-            // temp
-            QDomElement temp = node.firstChildElement("temp");
-            if (!temp.isNull()) add.temp = temp.text().toDouble();
-            else add.temp = 0.0;
-
-            // do we need to calculate distance?
-            if (add.km == 0.0 && samples) {
-                // delta secs * kph/3600
-                add.km = rdist + ((add.secs - rtime) * (add.kph/3600));
+                    if (tag == PwxTag::Beginning) {
+                        segment.start = xml.number();
+                        hasBeginning = true;
+                    } else if (tag == PwxTag::Duration) {
+                        duration = xml.number();
+                        hasDuration = true;
+                    }
+                }
             }
+            path.pop_back();
+            break;
+        }
 
-            // running totals
-            samples++;
-            rtime = add.secs;
-            rdist = add.km;
-
-            // add the data point
-            rideFile->appendPoint(add.secs, add.cad, add.hr, add.km, add.kph,
-                    add.nm, add.watts, add.alt, add.lon, add.lat, add.headwind,
-                    add.slope, add.temp, add.lrbalance, add.interval);
-
+        case XmlTokenizer::EndDocument:
+            done = true;
+            break;
 
-        // ignored for now
-        } else if (node.nodeName() == "summarydata") {
-        } else if (node.nodeName() == "extension") {
+        case XmlTokenizer::Invalid:
+            done = true;
+            root = false;
+            break;
         }
+    }
 
-        node = node.nextSibling();
+    if (!root) {
+        errors << "Could not parse file.";
+        delete rideFile;
+        return NULL;
     }
 
     // post-process and check
@@ -300,6 +313,30 @@ PwxFileReader::PwxFromDomDoc(QDomDocument doc, QStringList &errors) const
     return rideFile;
 }
 
+RideFile *
+PwxFileReader::openRideFile(QFile &file, QStringList &errors, QList<RideFile*>*) const
+{
+    if (!file.open(QIODevice::ReadOnly)) {
+        errors << "Could not open file.";
+        return NULL;
+    }
+
+    RideFile *rideFile = pwxFromDevice(file, errors);
+    file.close();
+    return rideFile;
+}
+
+RideFile *
+PwxFileReader::PwxFromDomDoc(QDomDocument doc, QStringList &errors) const
+{
+    // it has already been parsed once, but reading the serialised
+    // document is still quicker than walking the dom
+    QByteArray content = doc.toByteArray();
+    QBuffer buffer(&content);
+    buffer.open(QIODevice::ReadOnly);
+    return pwxFromDevice(buffer, errors);
+}
+
 bool
 PwxFileReader::writeRideFile(Context *context, const RideFile *ride, QFile &file) const
 {
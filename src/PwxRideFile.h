@@ -29,6 +29,7 @@ struct PwxFileReader : public RideFileReader {
     bool writeRideFile(Context *, const RideFile *ride, QFile &file) const;
     virtual RideFile *PwxFromDomDoc(QDomDocument doc, QStringList &errors) const;
     bool hasWrite() const { return true; }
+    bool isReentrant() const { return true; }
 };
 
 #endif // _PwxRideFile_h
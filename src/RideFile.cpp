@@ -29,6 +29,8 @@
 #include <QtXml/QtXml>
 #include <algorithm> // for std::lower_bound
 #include <assert.h>
+#include <new> // for placement new
+#include <stdlib.h> // for malloc/free
 
 #define mark() \
 { \
@@ -41,9 +43,10 @@
 RideFile::RideFile(const QDateTime &startTime, double recIntSecs) :
             startTime_(startTime), recIntSecs_(recIntSecs),
             deviceType_("unknown"), data(NULL), weight_(0),
-            totalCount(0)
+            totalCount(0), seriesValid_(0), view_(false)
 {
     command = new RideFileCommand(this);
+    context = NULL; // set by the reader
 
     minPoint = new RideFilePoint();
     maxPoint = new RideFilePoint();
@@ -51,9 +54,10 @@ RideFile::RideFile(const QDateTime &startTime, double recIntSecs) :
     totalPoint = new RideFilePoint();
 }
 
-RideFile::RideFile() : recIntSecs_(0.0), deviceType_("unknown"), data(NULL), weight_(0), totalCount(0)
+RideFile::RideFile() : recIntSecs_(0.0), deviceType_("unknown"), data(NULL), weight_(0), totalCount(0), seriesValid_(0), view_(false)
 {
     command = new RideFileCommand(this);
+    context = NULL; // set by the reader
 
     minPoint = new RideFilePoint();
     maxPoint = new RideFilePoint();
@@ -61,11 +65,58 @@ RideFile::RideFile() : recIntSecs_(0.0), deviceType_("unknown"), data(NULL), wei
     totalPoint = new RideFilePoint();
 }
 
+RideFile::RideFile(const RideFile *ride, int from, int to) :
+            startTime_(ride->startTime_), recIntSecs_(ride->recIntSecs_),
+            deviceType_("unknown"), data(NULL), weight_(ride->weight_),
+            totalCount(0), seriesValid_(0), view_(true)
+{
+    command = new RideFileCommand(this);
+    context = ride->context;
+
+    minPoint = new RideFilePoint();
+    maxPoint = new RideFilePoint();
+    avgPoint = new RideFilePoint();
+    totalPoint = new RideFilePoint();
+
+    from = qMax(from, 0);
+    to = qMin(to, ride->dataPoints_.count());
+    if (from >= to) return;
+    dataPoints_ = ride->dataPoints_.mid(from, to - from);
+
+    // as appendPoint() would have, except the interval
+    // which is never present in a view, like a copy
+    foreach(RideFilePoint *point, dataPoints_) {
+        dataPresent.secs     |= (point->secs != 0);
+        dataPresent.cad      |= (point->cad != 0);
+        dataPresent.hr       |= (point->hr != 0);
+        dataPresent.km       |= (point->km != 0);
+        dataPresent.kph      |= (point->kph != 0);
+        dataPresent.nm       |= (point->nm != 0);
+        dataPresent.watts    |= (point->watts != 0);
+        dataPresent.alt      |= (point->alt != 0);
+        dataPresent.lon      |= (point->lon != 0);
+        dataPresent.lat      |= (point->lat != 0);
+        dataPresent.headwind |= (point->headwind != 0);
+        dataPresent.slope    |= (point->slope != 0);
+        dataPresent.temp     |= (point->temp != noTemp);
+        dataPresent.lrbalance|= (point->lrbalance != 0);
+
+        updateMin(point);
+        updateMax(point);
+        updateAvg(point);
+    }
+}
+
 RideFile::~RideFile()
 {
     emit deleted();
-    foreach(RideFilePoint *point, dataPoints_)
-        delete point;
+
+    // the pool releases its own points in one go
+    // and a view's points belong to its ride
+    if (!view_) {
+        foreach(RideFilePoint *point, dataPoints_)
+            if (!pool_.owns(point)) delete point;
+    }
     delete command;
     //!!! if (data) delete data; // need a mechanism to notify the editor
 }
@@ -275,6 +326,10 @@ RideFileFactory::writeRideFile(Context *context, const RideFile *ride, QFile &fi
     else return reader->writeRideFile(context, ride, file);
 }
 
+// serialises the readers that aren't reentrant, it is at file scope rather
+// than in openRideFile so it is constructed before any refresh thread uses it
+static QMutex serialize;
+
 RideFile *RideFileFactory::openRideFile(Context *context, QFile &file,
                                            QStringList &errors, QList<RideFile*> *rideList) const
 {
@@ -284,9 +339,14 @@ RideFile *RideFileFactory::openRideFile(Context *context, QFile &file,
     suffix.remove(0, dot + 1);
     RideFileReader *reader = readFuncs_.value(suffix.toLower());
     assert(reader);
+
+    // readers that keep their parse state in statics can
+    // only be used by one thread at a time
+    if (!reader->isReentrant()) serialize.lock();
 //qDebug()<<"open"<<file.fileName()<<"start:"<<QDateTime::currentDateTime().toString("hh:mm:ss.zzz");
     RideFile *result = reader->openRideFile(file, errors, rideList);
 //qDebug()<<"open"<<file.fileName()<<"end:"<<QDateTime::currentDateTime().toString("hh:mm:ss.zzz");
+    if (!reader->isReentrant()) serialize.unlock();
 
     // NULL returned to indicate openRide failed
     if (result) {
@@ -510,9 +570,10 @@ void RideFile::appendPoint(double secs, double cad, double hr, double km,
     if (!isfinite(watts) || watts<0) watts=0;
     if (!isfinite(interval) || interval<0) interval=0;
 
-    RideFilePoint* point = new RideFilePoint(secs, cad, hr, km, kph,
-                                             nm, watts, alt, lon, lat, headwind, slope, temp, lrbalance, interval);
+    RideFilePoint* point = pool_.allocate(RideFilePoint(secs, cad, hr, km, kph,
+                                             nm, watts, alt, lon, lat, headwind, slope, temp, lrbalance, interval));
     dataPoints_.append(point);
+    seriesValid_ = 0;
 
     dataPresent.secs     |= (secs != 0);
     dataPresent.cad      |= (cad != 0);
@@ -537,13 +598,75 @@ void RideFile::appendPoint(double secs, double cad, double hr, double km,
 
 void RideFile::appendPoint(const RideFilePoint &point)
 {
-    dataPoints_.append(new RideFilePoint(point.secs,point.cad,point.hr,point.km,point.kph,point.nm,point.watts,point.alt,point.lon,point.lat,
-                                         point.headwind, point.slope, point.temp, point.lrbalance, point.interval));
+    seriesValid_ = 0;
+    dataPoints_.append(pool_.allocate(point));
+}
+
+void RideFile::reservePoints(int count)
+{
+    if (count <= 0) return;
+    dataPoints_.reserve(dataPoints_.count() + count);
+    pool_.reserve(count);
+}
+
+//
+// RideFilePointPool
+//
+static const int poolMinBlock = 1024;  // points
+static const int poolMaxBlock = 65536; // points
+
+RideFilePoint *
+RideFilePointPool::allocate(const RideFilePoint &point)
+{
+    // need a new block? grow geometrically so even a very
+    // long ride only uses a handful of blocks
+    if (blocks.isEmpty() || used == blocks.last().size) {
+        int size = blocks.isEmpty() ? poolMinBlock : qMin(blocks.last().size * 2, poolMaxBlock);
+
+        // no room for a block, RideFile deletes points the pool doesn't own
+        if (!reserve(size)) return new RideFilePoint(point);
+    }
+    Block &block = blocks.last();
+    return new (&block.points[used++]) RideFilePoint(point);
+}
+
+bool
+RideFilePointPool::reserve(int count)
+{
+    // already enough room in the last block?
+    if (!blocks.isEmpty() && (blocks.last().size - used) >= count) return true;
+
+    Block block;
+    block.size = qMax(count, poolMinBlock);
+    block.points = static_cast<RideFilePoint*>(malloc(sizeof(RideFilePoint) * block.size));
+    if (block.points == NULL) return false; // carry on with the last block
+
+    blocks.append(block);
+    used = 0;
+    return true;
+}
+
+bool
+RideFilePointPool::owns(const RideFilePoint *point) const
+{
+    foreach (const Block &block, blocks)
+        if (point >= block.points && point < block.points + block.size) return true;
+    return false;
+}
+
+void
+RideFilePointPool::clear()
+{
+    // RideFilePoint has nothing to destruct, so just free the memory
+    foreach (const Block &block, blocks) free(block.points);
+    blocks.clear();
+    used = 0;
 }
 
 void
 RideFile::setDataPresent(SeriesType series, bool value)
 {
+    seriesValid_ = 0;
     switch (series) {
         case secs : dataPresent.secs = value; break;
         case cad : dataPresent.cad = value; break;
@@ -566,7 +689,7 @@ RideFile::setDataPresent(SeriesType series, bool value)
 }
 
 bool
-RideFile::isDataPresent(SeriesType series)
+RideFile::isDataPresent(SeriesType series) const
 {
     switch (series) {
         case secs : return dataPresent.secs; break;
@@ -592,6 +715,7 @@ RideFile::isDataPresent(SeriesType series)
 void
 RideFile::setPointValue(int index, SeriesType series, double value)
 {
+    seriesValid_ = 0;
     switch (series) {
         case secs : dataPoints_[index]->secs = value; break;
         case cad : dataPoints_[index]->cad = value; break;
@@ -645,6 +769,44 @@ RideFile::getPointValue(int index, SeriesType series) const
     return dataPoints_[index]->value(series);
 }
 
+RideFileSeries
+RideFile::series(SeriesType series) const
+{
+    // derived series (NP, xPower et al) are not stored
+    switch (series) {
+        case secs : case cad : case hr : case km : case kph :
+        case nm : case watts : case alt : case lon : case lat :
+        case headwind : case slope : case temp : case interval :
+        case lrbalance : break;
+        default: return RideFileSeries();
+    }
+
+    // time is always there, anything else only if it was recorded
+    if (series != secs && !isDataPresent(series)) return RideFileSeries();
+
+    // the mean max computers (amongst others) will ask
+    // for series concurrently from their own threads
+    QMutexLocker locker(&seriesLock_);
+
+    QVector<double> &column = series_[series];
+    if ((seriesValid_ & (1u << series)) == 0) {
+
+        column.resize(dataPoints_.count());
+        double *to = column.data();
+        foreach (const RideFilePoint *point, dataPoints_) *to++ = point->value(series);
+
+        seriesValid_ |= (1u << series);
+    }
+    return RideFileSeries(column.constData(), column.count());
+}
+
+void
+RideFile::invalidateSeries()
+{
+    QMutexLocker locker(&seriesLock_);
+    seriesValid_ = 0;
+}
+
 QVariant
 RideFile::getPointFromValue(double value, SeriesType series) const
 {
@@ -766,26 +928,31 @@ RideFile::minimumFor(SeriesType series)
 void
 RideFile::deletePoint(int index)
 {
-    delete dataPoints_[index];
+    seriesValid_ = 0;
+    if (!pool_.owns(dataPoints_[index])) delete dataPoints_[index];
     dataPoints_.remove(index);
 }
 
 void
 RideFile::deletePoints(int index, int count)
 {
-    for(int i=index; i<(index+count); i++) delete dataPoints_[i];
+    seriesValid_ = 0;
+    for(int i=index; i<(index+count); i++)
+        if (!pool_.owns(dataPoints_[i])) delete dataPoints_[i];
     dataPoints_.remove(index, count);
 }
 
 void
 RideFile::insertPoint(int index, RideFilePoint *point)
 {
+    seriesValid_ = 0;
     dataPoints_.insert(index, point);
 }
 
 void
 RideFile::appendPoints(QVector <struct RideFilePoint *> newRows)
 {
+    seriesValid_ = 0;
     dataPoints_ += newRows;
 }
 
@@ -800,6 +967,7 @@ void
 RideFile::emitReverted()
 {
     weight_ = 0;
+    invalidateSeries();
     emit reverted();
 }
 
@@ -807,6 +975,7 @@ void
 RideFile::emitModified()
 {
     weight_ = 0;
+    invalidateSeries();
     emit modified();
 }
 
@@ -821,17 +990,28 @@ RideFile::getWeight()
     }
 
     // withings?
-    QList<SummaryMetrics> measures = context->athlete->metricDB->getAllMeasuresFor(QDateTime::fromString("Jan 1 00:00:00 1900"), startTime());
-    int i = measures.count()-1;
-    if (i) {
-        while (i>=0) {
-            if ((weight_ = measures[i].getText("Weight", "0.0").toDouble()) > 0) {
-               return weight_;
-            }
-            i--;
-        }
+    return getWeight(context->athlete->metricDB->getAllMeasuresFor(QDateTime::fromString("Jan 1 00:00:00 1900"), startTime()));
+}
+
+// as above, but the caller has already fetched the measures so we do
+// not touch the metric db -- used when computing off the gui thread
+double
+RideFile::getWeight(const QList<SummaryMetrics> &measures)
+{
+    if (weight_) return weight_; // cached value
+
+    // ride
+    if ((weight_ = getTag("Weight", "0.0").toDouble()) > 0) {
+        return weight_;
     }
 
+    // withings? most recent measure on or before the ride
+    for (int i=measures.count()-1; i>=0; i--) {
+        if (measures[i].getDateTime() > startTime()) continue;
+        if ((weight_ = measures[i].getText("Weight", "0.0").toDouble()) > 0) {
+           return weight_;
+        }
+    }
 
     // global options
     weight_ = appsettings->cvalue(context->athlete->cyclist, GC_WEIGHT, "75.0").toString().toDouble(); // default to 75kg
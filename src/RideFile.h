@@ -27,23 +27,29 @@
 #include <QMap>
 #include <QVector>
 #include <QObject>
+#include <QMutex>
 
 class RideItem;
 class RideFile;
 struct RideFilePoint;
 struct RideFileDataPresent;
 struct RideFileInterval;
+struct RideFileSeries;
 class EditorData;      // attached to a RideFile
 class RideFileCommand; // for manipulating ride data
+class SummaryMetrics;  // for weight measures
 class Context;      // for context; cyclist, homedir
 
-// This file defines four classes:
+// This file defines five classes:
 //
 // RideFile, as the name suggests, represents the data stored in a ride file,
 // regardless of what type of file it is (.raw, .srm, .csv).
 //
 // RideFilePoint represents the data for a single sample in a RideFile.
 //
+// RideFileSeries is a read-only columnar view of a single data series
+// across all the samples in a RideFile.
+//
 // RideFileReader is an abstract base class for function-objects that take a
 // filename and return a RideFile object representing the ride stored in the
 // corresponding file.
@@ -62,6 +68,24 @@ struct RideFileDataPresent
         headwind(false), slope(false), temp(false), lrbalance(false), interval(false) {}
 };
 
+// A contiguous, read-only view of one data series (e.g. watts) for every
+// sample in the ride. Hot loops that only need one channel should stream
+// through this rather than chasing RideFilePoint pointers. The view is
+// only valid until the ride is next modified.
+struct RideFileSeries
+{
+    const double *data;
+    int count;
+
+    RideFileSeries() : data(NULL), count(0) {}
+    RideFileSeries(const double *data, int count) : data(data), count(count) {}
+
+    double operator[](int i) const { return data[i]; }
+    const double *begin() const { return data; }
+    const double *end() const { return data + count; }
+    bool isEmpty() const { return count == 0; }
+};
+
 struct RideFileInterval
 {
     double start, stop;
@@ -87,6 +111,34 @@ struct RideFileCalibration
     bool operator< (RideFileCalibration right) const { return start < right.start; }
 };
 
+// RideFilePointPool owns the points created by RideFile::appendPoint. They
+// are carved out of large blocks rather than allocated one at a time and
+// are all released together when the ride is deleted. Points that are
+// deleted from the ride are not reused, they are simply orphaned until then.
+class RideFilePointPool
+{
+    public:
+        RideFilePointPool() : used(0) {}
+        ~RideFilePointPool() { clear(); }
+
+        RideFilePoint *allocate(const RideFilePoint &point);
+        bool reserve(int count);          // make room for count more points, false if out of memory
+        bool owns(const RideFilePoint *point) const;
+        void clear();                     // release all the blocks
+
+    private:
+        struct Block {
+            RideFilePoint *points;
+            int size;
+        };
+        QVector<Block> blocks;
+        int used; // points used from the last block
+
+        // not copyable
+        RideFilePointPool(const RideFilePointPool &);
+        RideFilePointPool &operator=(const RideFilePointPool &);
+};
+
 class RideFile : public QObject // QObject to emit signals
 {
     Q_OBJECT
@@ -102,6 +154,10 @@ class RideFile : public QObject // QObject to emit signals
         // Constructor / Destructor
         RideFile();
         RideFile(const QDateTime &startTime, double recIntSecs);
+
+        // a read-only view of the points from..to-1 of ride, they are
+        // shared not copied, so it must not outlive the ride or be edited
+        RideFile(const RideFile *ride, int from, int to);
         virtual ~RideFile();
 
         // Working with DATASERIES
@@ -133,9 +189,18 @@ class RideFile : public QObject // QObject to emit signals
         void appendPoint(const RideFilePoint &);
         const QVector<RideFilePoint*> &dataPoints() const { return dataPoints_; }
 
+        // readers that know how many samples are coming (e.g. from
+        // the file header) can make room for them all up front
+        void reservePoints(int count);
+
+        // Working with SERIES -- columnar copy of the datapoints built on
+        // demand, a series that is not present returns an empty view
+        RideFileSeries series(SeriesType series) const;
+        void invalidateSeries(); // call if you change datapoints directly
+
         // Working with DATAPRESENT flags
         inline const RideFileDataPresent *areDataPresent() const { return &dataPresent; }
-        bool isDataPresent(SeriesType series);
+        bool isDataPresent(SeriesType series) const;
 
         // Working with FIRST CLASS variables
         const QDateTime &startTime() const { return startTime_; }
@@ -180,6 +245,8 @@ class RideFile : public QObject // QObject to emit signals
 
         Context *context;
         double getWeight();
+        double getWeight(const QList<SummaryMetrics> &measures);
+        bool isWeightKnown() const { return weight_ > 0; } // getWeight() won't touch the metric db
 
         // METRIC OVERRIDES
         QMap<QString,QMap<QString,QString> > metricOverrides;
@@ -222,6 +289,7 @@ class RideFile : public QObject // QObject to emit signals
         double recIntSecs_;    // recording interval in seconds
         QVector<RideFilePoint*> dataPoints_;
         QVector<RideFilePoint*> referencePoints_;
+        RideFilePointPool pool_; // owns points added via appendPoint
         RideFilePoint* minPoint;
         RideFilePoint* maxPoint;
         RideFilePoint* avgPoint;
@@ -236,6 +304,13 @@ class RideFile : public QObject // QObject to emit signals
         double weight_; // cached to save calls to getWeight();
         double totalCount;
 
+        // columnar series, one array per stored series type
+        // rebuilt lazily when the datapoints have been modified
+        mutable QMutex seriesLock_;
+        mutable QVector<double> series_[none];
+        mutable unsigned int seriesValid_; // bitmask by SeriesType
+        bool view_; // dataPoints_ belong to another ride
+
         QVariant getPointFromValue(double value, SeriesType series) const;
         void updateMin(RideFilePoint* point);
         void updateMax(RideFilePoint* point);
@@ -263,6 +338,9 @@ struct RideFileReader {
     // if hasWrite capability should re-implement writeRideFile and hasWrite
     virtual bool hasWrite() const { return false; }
     virtual bool writeRideFile(Context *, const RideFile *, QFile &) const { return false; }
+
+    // can openRideFile be called from several threads at once?
+    virtual bool isReentrant() const { return false; }
 };
 
 class RideFileFactory {
@@ -17,6 +17,7 @@
  */
 
 #include "RideFileCache.h"
+#include "RideFileCacheIndex.h"
 #include "MainWindow.h"
 #include "Context.h"
 #include "Athlete.h"
@@ -24,13 +25,119 @@
 #include "HrZones.h"
 
 #include <math.h> // for pow()
+#include <string.h> // for memcpy()
 #include <QDebug>
 #include <QFileInfo>
+#include <QHash>
 #include <QMessageBox>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QApplication>
 #include <QtAlgorithms> // for qStableSort
 
 static const int maxcache = 25; // lets max out at 25 caches
 
+// the metric refresh updates cpx files from worker threads
+// so the athlete's aggregate cache needs to be protected
+static QMutex cpxCacheLock;
+
+// best() and tiz() are called for every ride when a filter is evaluated
+// so rather than open and read the .cpx each time we keep the most
+// recently used ones mapped and just index into them. A file is mapped
+// again if its size or modification time changes, and is released before
+// it is rewritten or deleted since that is unsafe (and fails on Windows)
+// whilst it is mapped. Each mapping holds a file open, so we keep the
+// number of them down.
+static const int cpxMapMaxFiles = 128;
+static const qint64 cpxMapMaxBytes = 64 * 1024 * 1024;
+
+class CpxMappings
+{
+    public:
+        CpxMappings() : bytes(0), clock(0) {}
+        ~CpxMappings() { while (!maps.isEmpty()) release(maps.begin().key()); }
+
+        // the mapped file or NULL if it can't be, hold lock whilst using it
+        const uchar *map(const QString &cacheFileName, qint64 &size);
+        void release(const QString &cacheFileName);
+
+        QMutex lock;
+
+    private:
+        struct mapping {
+            QFile *file;
+            uchar *data;
+            qint64 size;
+            QDateTime modified;
+            quint64 used;
+        };
+        QHash<QString, mapping> maps;
+        qint64 bytes;
+        quint64 clock; // for least recently used
+};
+static CpxMappings cpxMappings;
+
+const uchar *
+CpxMappings::map(const QString &cacheFileName, qint64 &size)
+{
+    QFileInfo info(cacheFileName);
+
+    // already mapped and still current?
+    QHash<QString, mapping>::iterator it = maps.find(cacheFileName);
+    if (it != maps.end()) {
+        if (info.exists() && info.size() == it->size && info.lastModified() == it->modified) {
+            it->used = ++clock;
+            size = it->size;
+            return it->data;
+        }
+        release(cacheFileName);
+    }
+
+    if (!info.exists() || info.size() < (qint64) sizeof(RideFileCacheHeader)) return NULL;
+
+    QFile *file = new QFile(cacheFileName);
+    uchar *data = file->open(QIODevice::ReadOnly) ? file->map(0, info.size()) : NULL;
+    if (data == NULL) {
+        delete file;
+        return NULL;
+    }
+
+    // make room, dropping the least recently used
+    while (!maps.isEmpty() && (maps.count() >= cpxMapMaxFiles || bytes + info.size() > cpxMapMaxBytes)) {
+        QHash<QString, mapping>::iterator oldest = maps.begin();
+        for (it = maps.begin(); it != maps.end(); it++)
+            if (it->used < oldest->used) oldest = it;
+        release(oldest.key());
+    }
+
+    mapping add;
+    add.file = file;
+    add.data = data;
+    add.size = info.size();
+    add.modified = info.lastModified();
+    add.used = ++clock;
+    maps.insert(cacheFileName, add);
+    bytes += add.size;
+
+    size = add.size;
+    return data;
+}
+
+void
+CpxMappings::release(const QString &cacheFileName)
+{
+    QHash<QString, mapping>::iterator it = maps.find(cacheFileName);
+    if (it == maps.end()) return;
+
+    bytes -= it->size;
+    it->file->unmap(it->data);
+    it->file->close();
+    delete it->file;
+    maps.erase(it);
+}
+
 // cache from ride
 RideFileCache::RideFileCache(Context *context, QString fileName, RideFile *passedride, bool check) :
                context(context), rideFileName(fileName), ride(passedride)
@@ -61,30 +168,13 @@ RideFileCache::RideFileCache(Context *context, QString fileName, RideFile *passe
     // Get info for ride file and cache file
     QFileInfo rideFileInfo(rideFileName);
     cacheFileName = rideFileInfo.path() + "/" + rideFileInfo.baseName() + ".cpx";
-    QFileInfo cacheFileInfo(cacheFileName);
 
     // is it up-to-date?
-    if (cacheFileInfo.exists() && rideFileInfo.lastModified() <= cacheFileInfo.lastModified() &&
-        cacheFileInfo.size() >= (int)sizeof(struct RideFileCacheHeader)) {
-        // we have a file, it is more recent than the ride file
-        // but is it the latest version?
-        RideFileCacheHeader head;
-        QFile cacheFile(cacheFileName);
-        if (cacheFile.open(QIODevice::ReadOnly) == true) {
-
-            // read the header
-            QDataStream inFile(&cacheFile);
-            inFile.readRawData((char *) &head, sizeof(head));
-            cacheFile.close();
+    if (isCurrent(rideFileName)) {
 
-            // is it as recent as we are?
-            if (head.version == RideFileCacheVersion) {
-
-                // WE'RE GOOD
-                if (check == false) readCache(); // if check is false we aren't just checking
-                return;
-            }
-        }
+        // WE'RE GOOD
+        if (check == false) readCache(); // if check is false we aren't just checking
+        return;
     }
 
     // NEED TO UPDATE!!
@@ -112,6 +202,32 @@ RideFileCache::RideFileCache(Context *context, QString fileName, RideFile *passe
     }
 }
 
+bool
+RideFileCache::isCurrent(QString rideFileName)
+{
+    QFileInfo rideFileInfo(rideFileName);
+    QFileInfo cacheFileInfo(rideFileInfo.path() + "/" + rideFileInfo.baseName() + ".cpx");
+
+    if (cacheFileInfo.exists() && rideFileInfo.lastModified() <= cacheFileInfo.lastModified() &&
+        cacheFileInfo.size() >= (int)sizeof(struct RideFileCacheHeader)) {
+        // we have a file, it is more recent than the ride file
+        // but is it the latest version?
+        RideFileCacheHeader head;
+        QFile cacheFile(cacheFileInfo.filePath());
+        if (cacheFile.open(QIODevice::ReadOnly) == true) {
+
+            // read the header
+            QDataStream inFile(&cacheFile);
+            inFile.readRawData((char *) &head, sizeof(head));
+            cacheFile.close();
+
+            // is it as recent as we are?
+            return head.version == RideFileCacheVersion;
+        }
+    }
+    return false;
+}
+
 int
 RideFileCache::decimalsFor(RideFile::SeriesType series)
 {
@@ -283,8 +399,9 @@ RideFileCache::refreshCache()
 {
     static bool writeerror=false;
 
-    // update cache!
-    QFile cacheFile(cacheFileName);
+    // the cache is written alongside and then renamed over the old one
+    // so best() and tiz() never map it whilst it is being rewritten
+    QFile cacheFile(cacheFileName + ".tmp");
 
     if (cacheFile.open(QIODevice::WriteOnly) == true) {
 
@@ -300,8 +417,23 @@ RideFileCache::refreshCache()
         // all done now, phew
         cacheFile.close();
 
+        // can't replace it whilst it is mapped
+        {
+            QMutexLocker locker(&cpxMappings.lock);
+            cpxMappings.release(cacheFileName);
+            QFile::remove(cacheFileName);
+            if (!QFile::rename(cacheFileName + ".tmp", cacheFileName)) {
+                qDebug()<<"cannot replace cache file"<<cacheFileName;
+                QFile::remove(cacheFileName + ".tmp");
+            }
+        }
+
+        // the index periods containing this ride are out of date
+        context->athlete->cpxIndex->rideChanged(QFileInfo(rideFileName).fileName());
+
         // invalidate any incore cache of aggregate
         // that contains this ride in its date range
+        QMutexLocker locker(&cpxCacheLock);
         QDate date = ride->startTime().date();
         for (int i=0; i<context->athlete->cpxCache.count();) {
             if (date >= context->athlete->cpxCache.at(i)->start &&
@@ -312,7 +444,7 @@ RideFileCache::refreshCache()
         }
 
 
-    } else if (writeerror == false) {
+    } else if (writeerror == false && QThread::currentThread() == QApplication::instance()->thread()) {
 
         // popup the first time...
         writeerror = true;
@@ -330,10 +462,91 @@ RideFileCache::refreshCache()
     }
 }
 
-// this function is a candidate for supporting
-// threaded calculations, each of the computes
-// in here could go in its own thread. Users
-// with many cores would benefit enormously
+// The mean-max computers are run on the global thread pool rather
+// than a thread each, so when many rides are being refreshed at once
+// we don't create thousands of threads or oversubscribe the cpu.
+//
+// The calling thread takes computers off the list too, so we still
+// make progress if the pool is busy with other rides, and won't
+// deadlock if we are called from a pool thread ourselves.
+class MeanMaxTasks
+{
+    public:
+        MeanMaxTasks() : refs(1), next(0), done(0) {}
+        ~MeanMaxTasks() { qDeleteAll(computers); }
+
+        void add(MeanMaxComputer *computer) { computers << computer; }
+        void start();
+        void wait();
+
+    private:
+        friend class MeanMaxWorker;
+
+        bool runOne();
+        void deref() { if (!refs.deref()) delete this; }
+
+        QList<MeanMaxComputer*> computers;
+        QAtomicInt refs, next;
+
+        QMutex lock;
+        QWaitCondition finished;
+        int done;
+};
+
+class MeanMaxWorker : public QRunnable
+{
+    public:
+        MeanMaxWorker(MeanMaxTasks *tasks) : tasks(tasks) {}
+        void run() {
+            while (tasks->runOne()) ;
+            tasks->deref();
+        }
+
+    private:
+        MeanMaxTasks *tasks;
+};
+
+// run the next unclaimed computer, false if there are none left
+bool
+MeanMaxTasks::runOne()
+{
+    int index = next.fetchAndAddOrdered(1);
+    if (index >= computers.count()) return false;
+
+    computers[index]->run();
+
+    QMutexLocker locker(&lock);
+    if (++done == computers.count()) finished.wakeAll();
+    return true;
+}
+
+void
+MeanMaxTasks::start()
+{
+    // leave one for the calling thread
+    QThreadPool *pool = QThreadPool::globalInstance();
+    int workers = qMin(computers.count() - 1, pool->maxThreadCount());
+
+    for (int i=0; i<workers; i++) {
+        refs.ref(); // dropped by the worker when it is done
+        pool->start(new MeanMaxWorker(this));
+    }
+}
+
+// help out then wait for them all to complete, the workers may
+// still hold a reference after that so we delete on the last deref
+void
+MeanMaxTasks::wait()
+{
+    while (runOne()) ;
+
+    lock.lock();
+    while (done < computers.count()) finished.wait(&lock);
+    lock.unlock();
+
+    deref();
+}
+
 void RideFileCache::RideFileCache::compute()
 {
     if (ride == NULL) {
@@ -341,15 +554,17 @@ void RideFileCache::RideFileCache::compute()
     }
 
     // all the mean maxes
-    MeanMaxComputer thread1(ride, wattsMeanMax, RideFile::watts); thread1.start();
-    MeanMaxComputer thread2(ride, hrMeanMax, RideFile::hr); thread2.start();
-    MeanMaxComputer thread3(ride, cadMeanMax, RideFile::cad); thread3.start();
-    MeanMaxComputer thread4(ride, nmMeanMax, RideFile::nm); thread4.start();
-    MeanMaxComputer thread5(ride, kphMeanMax, RideFile::kph); thread5.start();
-    MeanMaxComputer thread6(ride, xPowerMeanMax, RideFile::xPower); thread6.start();
-    MeanMaxComputer thread7(ride, npMeanMax, RideFile::NP); thread7.start();
-    MeanMaxComputer thread8(ride, vamMeanMax, RideFile::vam); thread8.start();
-    MeanMaxComputer thread9(ride, wattsKgMeanMax, RideFile::wattsKg); thread9.start();
+    MeanMaxTasks *tasks = new MeanMaxTasks;
+    tasks->add(new MeanMaxComputer(ride, wattsMeanMax, RideFile::watts));
+    tasks->add(new MeanMaxComputer(ride, hrMeanMax, RideFile::hr));
+    tasks->add(new MeanMaxComputer(ride, cadMeanMax, RideFile::cad));
+    tasks->add(new MeanMaxComputer(ride, nmMeanMax, RideFile::nm));
+    tasks->add(new MeanMaxComputer(ride, kphMeanMax, RideFile::kph));
+    tasks->add(new MeanMaxComputer(ride, xPowerMeanMax, RideFile::xPower));
+    tasks->add(new MeanMaxComputer(ride, npMeanMax, RideFile::NP));
+    tasks->add(new MeanMaxComputer(ride, vamMeanMax, RideFile::vam));
+    tasks->add(new MeanMaxComputer(ride, wattsKgMeanMax, RideFile::wattsKg));
+    tasks->start();
 
     // all the different distributions
     computeDistribution(wattsDistribution, RideFile::watts);
@@ -359,16 +574,8 @@ void RideFileCache::RideFileCache::compute()
     computeDistribution(kphDistribution, RideFile::kph);
     computeDistribution(wattsKgDistribution, RideFile::wattsKg);
 
-    // wait for them threads
-    thread1.wait();
-    thread2.wait();
-    thread3.wait();
-    thread4.wait();
-    thread5.wait();
-    thread6.wait();
-    thread7.wait();
-    thread8.wait();
-    thread9.wait();
+    // wait for the mean maxes, tasks is deleted when done
+    tasks->wait();
 }
 
 //----------------------------------------------------------------------
@@ -476,7 +683,7 @@ void RideFileCache::RideFileCache::compute()
 
    6. candidate is the mean max for 60 seconds.
 
-   Enhancements that are not implemented:
+   Enhancements:
 
      - The two-minute overlapping sections can be reused for 59
        seconds, etc.  The algorithm will degrade to exhaustive search
@@ -490,6 +697,15 @@ void RideFileCache::RideFileCache::compute()
        useful optimization if the windows are reused per the previous
        idea.
 
+   Both of these are now implemented in all_max_means() below, which
+   computes every duration in one go. Durations are grouped into bands
+   that share one set of sections, sorted once by energy. And since the
+   data is never negative the best energy for n seconds is at least
+   the best for n-1 seconds, so each duration starts with that as its
+   candidate and only examines the few sections that could beat it.
+   The results are identical to calling divided_max_mean() for each
+   duration, which is retained for data that has negative values.
+
 */
 
 data_t *
@@ -509,22 +725,106 @@ MeanMaxComputer::integrate_series(cpintdata &data)
     return integrated;
 }
 
-data_t
-MeanMaxComputer::partial_max_mean(data_t *dataseries_i, int start, int end, int length, int *offset)
+// The windowed difference max below is the innermost loop of every
+// mean-max computation, so there are SSE2 and AVX versions of it too,
+// selected at runtime. They only find the max, which is the same whatever
+// order the differences are examined in, and the offset of the (first)
+// max is then found with a scalar scan. So the results are identical.
+typedef data_t (*window_max_kernel)(const data_t *, int, int, int);
+
+static data_t
+window_max_scalar(const data_t *dataseries_i, int start, int stop, int length)
 {
-    int i=0;
     data_t candidate=0;
+    for (int i=start; i<stop; i++) {
+        data_t test_energy=dataseries_i[length+i]-dataseries_i[i];
+        if (test_energy>candidate) candidate=test_energy;
+    }
+    return candidate;
+}
 
-    int best_i=0;
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GC_WINDOW_MAX_SSE2 1
 
-    for (i=start; i<(1+end-length); i++) {
-        data_t test_energy=dataseries_i[length+i]-dataseries_i[i];
-        if (test_energy>candidate) {
-            candidate=test_energy;
-            best_i=i;
+// NOTE: _mm_max_pd returns its second operand when either is a NaN
+//       so we always pass the running max second, to ignore NaNs
+//       like the scalar comparison does
+static data_t
+window_max_sse2(const data_t *dataseries_i, int start, int stop, int length)
+{
+    __m128d best = _mm_setzero_pd();
+    int i=start;
+    for (; i+2<=stop; i+=2) {
+        __m128d test_energy = _mm_sub_pd(_mm_loadu_pd(dataseries_i+length+i), _mm_loadu_pd(dataseries_i+i));
+        best = _mm_max_pd(test_energy, best);
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, best);
+    data_t candidate = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+
+    data_t tail = window_max_scalar(dataseries_i, i, stop, length);
+    return tail > candidate ? tail : candidate;
+}
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || \
+     (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#include <immintrin.h>
+#define GC_WINDOW_MAX_AVX 1
+
+__attribute__((target("avx"))) static data_t
+window_max_avx(const data_t *dataseries_i, int start, int stop, int length)
+{
+    __m256d best = _mm256_setzero_pd();
+    int i=start;
+    for (; i+4<=stop; i+=4) {
+        __m256d test_energy = _mm256_sub_pd(_mm256_loadu_pd(dataseries_i+length+i), _mm256_loadu_pd(dataseries_i+i));
+        best = _mm256_max_pd(test_energy, best);
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, best);
+    data_t candidate = 0;
+    for (int j=0; j<4; j++) if (lanes[j] > candidate) candidate = lanes[j];
+
+    data_t tail = window_max_scalar(dataseries_i, i, stop, length);
+    return tail > candidate ? tail : candidate;
+}
+#endif
+
+static window_max_kernel
+window_max_select()
+{
+#ifdef GC_WINDOW_MAX_AVX
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx")) return window_max_avx;
+#endif
+#ifdef GC_WINDOW_MAX_SSE2
+    return window_max_sse2;
+#else
+    return window_max_scalar;
+#endif
+}
+static const window_max_kernel window_max = window_max_select();
+
+data_t
+MeanMaxComputer::partial_max_mean(data_t *dataseries_i, int start, int end, int length, int *offset)
+{
+    data_t candidate=window_max(dataseries_i, start, 1+end-length, length);
+
+    // where was it? the first one, as the scalar search used to find
+    if (offset) {
+        int best_i=0;
+        if (candidate > 0) {
+            for (int i=start; i<(1+end-length); i++) {
+                if (dataseries_i[length+i]-dataseries_i[i] == candidate) {
+                    best_i=i;
+                    break;
+                }
+            }
         }
+        *offset=best_i;
     }
-    if (offset) *offset=best_i;
 
     return candidate;
 }
@@ -557,7 +857,7 @@ MeanMaxComputer::divided_max_mean(data_t *dataseries_i, int datalength, int leng
         if (energy < candidate) {
           continue;
         }
-        data_t window_mm=partial_max_mean(dataseries_i, start, end, length, &this_offset);
+        data_t window_mm=partial_max_mean(dataseries_i, start, end, length, offset ? &this_offset : NULL);
 
         if (window_mm>candidate) {
             candidate=window_mm;
@@ -575,7 +875,7 @@ MeanMaxComputer::divided_max_mean(data_t *dataseries_i, int datalength, int leng
 
         if (energy >= candidate) {
 
-            data_t window_mm=partial_max_mean(dataseries_i, start, end, length, &this_offset);
+            data_t window_mm=partial_max_mean(dataseries_i, start, end, length, offset ? &this_offset : NULL);
 
             if (window_mm>candidate) {
                 candidate=window_mm;
@@ -588,6 +888,62 @@ MeanMaxComputer::divided_max_mean(data_t *dataseries_i, int datalength, int leng
 }
 
 
+// a section of the ride and its energy, sorted most energetic first
+struct mmsection {
+    data_t energy;
+    int start;
+    bool operator< (const mmsection &right) const { return energy > right.energy; }
+};
+
+void
+MeanMaxComputer::all_max_means(data_t *dataseries_i, int datalength, QVector<data_t> &energies)
+{
+    energies.fill(0, datalength);
+
+    QVector<mmsection> sections;
+    data_t candidate=0;
+
+    for (int low=1; low<datalength;) {
+
+        // every duration in low-high is wholly contained in at
+        // least one of the overlapping sections of this band
+        int shift = low > 180 ? 180 : low;
+        int high = qMin(low + shift - 1, datalength - 1);
+        int window_length = qMin(high + shift - 1, datalength);
+
+        // put down as many sections as will fit without overrunning data
+        sections.resize(0);
+        int start;
+        for (start=0; start+window_length<=datalength; start+=shift) {
+            mmsection add;
+            add.start = start;
+            add.energy = dataseries_i[start+window_length] - dataseries_i[start];
+            sections << add;
+        }
+
+        // if they don't extend to the end of the data, tack one on
+        if (start - shift + window_length < datalength) {
+            mmsection add;
+            add.start = datalength - window_length;
+            add.energy = dataseries_i[datalength] - dataseries_i[add.start];
+            sections << add;
+        }
+        qSort(sections);
+
+        // candidate carries over from the last (shorter) duration
+        for (int length=low; length<=high; length++) {
+
+            for (int i=0; i<sections.count() && sections[i].energy > candidate; i++) {
+                data_t window_mm=partial_max_mean(dataseries_i, sections[i].start,
+                                                  sections[i].start + window_length, length, NULL);
+                if (window_mm > candidate) candidate = window_mm;
+            }
+            energies[length] = candidate;
+        }
+        low = high + 1;
+    }
+}
+
 void
 MeanMaxComputer::run()
 {
@@ -624,18 +980,17 @@ MeanMaxComputer::run()
     cpintdata data;
     data.rec_int_ms = (int) round(ride->recIntSecs() * 1000.0);
     double lastsecs = 0;
-    bool first = true;
     double offset = 0;
-    foreach (const RideFilePoint *p, ride->dataPoints()) {
 
-        // get offset to apply on all samples if first sample
-        if (first == true) {
-            offset = p->secs;
-            first = false;
-        }
+    // stream the two columns we need rather than visit every point
+    RideFileSeries times = ride->series(RideFile::secs);
+    RideFileSeries values = ride->series(baseSeries);
+    if (times.count) offset = times[0];
+
+    for (int n=0; n<times.count; n++) {
 
         // drag back to start at 0s
-        double psecs = p->secs - offset;
+        double psecs = times[n] - offset;
 
         // fill in any gaps in recording - use same dodgy rounding as before
         int count = (psecs - lastsecs - ride->recIntSecs()) / ride->recIntSecs();
@@ -648,7 +1003,7 @@ MeanMaxComputer::run()
         lastsecs = psecs;
 
         double secs = round(psecs * 1000.0) / 1000;
-        if (secs > 0) data.points.append(cpintpoint(secs, (int) round(p->value(baseSeries))));
+        if (secs > 0) data.points.append(cpintpoint(secs, (int) round(values[n])));
     }
 
     // don't bother with insufficient data
@@ -765,10 +1120,17 @@ MeanMaxComputer::run()
 
     data_t *dataseries_i = integrate_series(data);
 
+    // the single pass needs non-negative data
+    bool negative = false;
+    for (int i=0; i<data.points.size() && !negative; i++)
+        if (data.points[i].value < 0) negative = true;
+
+    QVector<data_t> energies;
+    if (!negative) all_max_means(dataseries_i, data.points.size(), energies);
+
     for (int i=1; i<data.points.size(); i++) {
 
-        int offset;
-        data_t c=divided_max_mean(dataseries_i,data.points.size(),i,&offset);
+        data_t c= negative ? divided_max_mean(dataseries_i,data.points.size(),i,NULL) : energies[i];
 
         // snaffle it away
         int sec = i*ride->recIntSecs();
@@ -835,21 +1197,23 @@ RideFileCache::computeDistribution(QVector<float> &array, RideFile::SeriesType s
     // which for longs is handily zero
     array.resize(max-min);
 
-    foreach(RideFilePoint *dp, ride->dataPoints()) {
-        double value = dp->value(baseSeries);
-        if (series == RideFile::wattsKg) {
-            value /= ride->getWeight();
-        }
-
-        float lvalue = value * pow(10, decimals);
+    RideFileSeries values = ride->series(baseSeries);
+    for (int n=0; n<values.count; n++) {
+        double value = values[n];
 
         // watts time in zone
         if (series == RideFile::watts && zoneRange != -1)
-            wattsTimeInZone[context->athlete->zones()->whichZone(zoneRange, dp->value(series))] += ride->recIntSecs();
+            wattsTimeInZone[context->athlete->zones()->whichZone(zoneRange, value)] += ride->recIntSecs();
 
         // hr time in zone
         if (series == RideFile::hr && hrZoneRange != -1)
-            hrTimeInZone[context->athlete->hrZones()->whichZone(hrZoneRange, dp->value(series))] += ride->recIntSecs();
+            hrTimeInZone[context->athlete->hrZones()->whichZone(hrZoneRange, value)] += ride->recIntSecs();
+
+        if (series == RideFile::wattsKg) {
+            value /= ride->getWeight();
+        }
+
+        float lvalue = value * pow(10, decimals);
 
         int offset = lvalue - min;
         if (offset >= 0 && offset < array.size()) array[offset] += ride->recIntSecs();
@@ -859,7 +1223,9 @@ RideFileCache::computeDistribution(QVector<float> &array, RideFile::SeriesType s
 //
 // AGGREGATE FOR A GIVEN DATE RANGE
 //
-static QDate dateFromFileName(const QString filename) {
+QDate
+RideFileCache::dateFromFileName(const QString filename)
+{
     QRegExp rx("^(\\d\\d\\d\\d)_(\\d\\d)_(\\d\\d)_\\d\\d_\\d\\d_\\d\\d\\..*$");
     if (rx.exactMatch(filename)) {
         QDate date(rx.cap(1).toInt(), rx.cap(2).toInt(), rx.cap(3).toInt());
@@ -869,7 +1235,9 @@ static QDate dateFromFileName(const QString filename) {
 }
 
 // select and update bests
-static void meanMaxAggregate(QVector<double> &into, QVector<double> &other, QVector<QDate>&dates, QDate rideDate)
+// other is a ride (no dates, they are all rideDate) or an aggregate
+static void meanMaxAggregate(QVector<double> &into, QVector<double> &other, QVector<QDate>&dates,
+                             QVector<QDate> &otherDates, QDate rideDate)
 {
     if (into.size() < other.size()) {
         into.resize(other.size());
@@ -879,7 +1247,7 @@ static void meanMaxAggregate(QVector<double> &into, QVector<double> &other, QVec
     for (int i=0; i<other.size(); i++)
         if (other[i] > into[i]) {
             into[i] = other[i];
-            dates[i] = rideDate;
+            dates[i] = i < otherDates.size() ? otherDates[i] : rideDate;
         }
 }
 
@@ -891,12 +1259,93 @@ static void distAggregate(QVector<double> &into, QVector<double> &other)
 
 }
 
-RideFileCache::RideFileCache(Context *context, QDate start, QDate end, bool filter, QStringList files)
+// an empty aggregate, used by the index for weeks, months and years
+RideFileCache::RideFileCache(Context *context) : context(context), rideFileName(""), ride(0)
+{
+    wattsTimeInZone.resize(10);
+    hrTimeInZone.resize(10);
+}
+
+// add a ride, or another aggregate, to this aggregate
+void
+RideFileCache::aggregate(RideFileCache &other, QDate rideDate)
+{
+    meanMaxAggregate(wattsMeanMaxDouble, other.wattsMeanMaxDouble, wattsMeanMaxDate, other.wattsMeanMaxDate, rideDate);
+    meanMaxAggregate(hrMeanMaxDouble, other.hrMeanMaxDouble, hrMeanMaxDate, other.hrMeanMaxDate, rideDate);
+    meanMaxAggregate(cadMeanMaxDouble, other.cadMeanMaxDouble, cadMeanMaxDate, other.cadMeanMaxDate, rideDate);
+    meanMaxAggregate(nmMeanMaxDouble, other.nmMeanMaxDouble, nmMeanMaxDate, other.nmMeanMaxDate, rideDate);
+    meanMaxAggregate(kphMeanMaxDouble, other.kphMeanMaxDouble, kphMeanMaxDate, other.kphMeanMaxDate, rideDate);
+    meanMaxAggregate(xPowerMeanMaxDouble, other.xPowerMeanMaxDouble, xPowerMeanMaxDate, other.xPowerMeanMaxDate, rideDate);
+    meanMaxAggregate(npMeanMaxDouble, other.npMeanMaxDouble, npMeanMaxDate, other.npMeanMaxDate, rideDate);
+    meanMaxAggregate(vamMeanMaxDouble, other.vamMeanMaxDouble, vamMeanMaxDate, other.vamMeanMaxDate, rideDate);
+    meanMaxAggregate(wattsKgMeanMaxDouble, other.wattsKgMeanMaxDouble, wattsKgMeanMaxDate, other.wattsKgMeanMaxDate, rideDate);
+
+    distAggregate(wattsDistributionDouble, other.wattsDistributionDouble);
+    distAggregate(hrDistributionDouble, other.hrDistributionDouble);
+    distAggregate(cadDistributionDouble, other.cadDistributionDouble);
+    distAggregate(nmDistributionDouble, other.nmDistributionDouble);
+    distAggregate(kphDistributionDouble, other.kphDistributionDouble);
+    distAggregate(xPowerDistributionDouble, other.xPowerDistributionDouble);
+    distAggregate(npDistributionDouble, other.npDistributionDouble);
+    distAggregate(wattsKgDistributionDouble, other.wattsKgDistributionDouble);
+
+    // cumulate timeinzones
+    for (int i=0; i<10; i++) {
+        hrTimeInZone[i] += other.hrTimeInZone[i];
+        wattsTimeInZone[i] += other.wattsTimeInZone[i];
+    }
+}
+
+// write / read an aggregate, the index keeps them on disk
+void
+RideFileCache::serializeAggregate(QDataStream &out)
+{
+    out << wattsMeanMaxDouble << wattsMeanMaxDate
+        << hrMeanMaxDouble << hrMeanMaxDate
+        << cadMeanMaxDouble << cadMeanMaxDate
+        << nmMeanMaxDouble << nmMeanMaxDate
+        << kphMeanMaxDouble << kphMeanMaxDate
+        << xPowerMeanMaxDouble << xPowerMeanMaxDate
+        << npMeanMaxDouble << npMeanMaxDate
+        << vamMeanMaxDouble << vamMeanMaxDate
+        << wattsKgMeanMaxDouble << wattsKgMeanMaxDate;
+
+    out << wattsDistributionDouble << hrDistributionDouble << cadDistributionDouble
+        << nmDistributionDouble << kphDistributionDouble << xPowerDistributionDouble
+        << npDistributionDouble << wattsKgDistributionDouble;
+
+    out << wattsTimeInZone << hrTimeInZone;
+}
+
+bool
+RideFileCache::readAggregate(QDataStream &in)
+{
+    in >> wattsMeanMaxDouble >> wattsMeanMaxDate
+       >> hrMeanMaxDouble >> hrMeanMaxDate
+       >> cadMeanMaxDouble >> cadMeanMaxDate
+       >> nmMeanMaxDouble >> nmMeanMaxDate
+       >> kphMeanMaxDouble >> kphMeanMaxDate
+       >> xPowerMeanMaxDouble >> xPowerMeanMaxDate
+       >> npMeanMaxDouble >> npMeanMaxDate
+       >> vamMeanMaxDouble >> vamMeanMaxDate
+       >> wattsKgMeanMaxDouble >> wattsKgMeanMaxDate;
+
+    in >> wattsDistributionDouble >> hrDistributionDouble >> cadDistributionDouble
+       >> nmDistributionDouble >> kphDistributionDouble >> xPowerDistributionDouble
+       >> npDistributionDouble >> wattsKgDistributionDouble;
+
+    in >> wattsTimeInZone >> hrTimeInZone;
+
+    return in.status() == QDataStream::Ok && wattsTimeInZone.size() == 10 && hrTimeInZone.size() == 10;
+}
+
+RideFileCache::RideFileCache(Context *context, QDate start, QDate end, bool filter, const RideSet &files)
                : start(start), end(end), context(context), rideFileName(""), ride(0) 
 {
 
     // Oh lets get from the cache if we can -- but not if filtered
     if (!filter && !context->isfiltered) {
+        QMutexLocker locker(&cpxCacheLock);
         foreach(RideFileCache *p, context->athlete->cpxCache) {
             if (p->start == start && p->end == end) {
                 *this = *p;
@@ -934,43 +1383,29 @@ RideFileCache::RideFileCache(Context *context, QDate start, QDate end, bool filt
     // and less intrusive than a popup box
     context->mainWindow->setCursor(Qt::WaitCursor);
 
-    // Iterate over the ride files (not the cpx files since they /might/ not
-    // exist, or /might/ be out of date.
-    foreach (QString rideFileName, RideFileFactory::instance().listRideFiles(context->athlete->home)) {
-        QDate rideDate = dateFromFileName(rideFileName);
-        if (((filter == true && files.contains(rideFileName)) || filter == false) &&
-            rideDate >= start && rideDate <= end) {
-
-            // skip globally filtered values
-            if (context->isfiltered && !context->filters.contains(rideFileName)) continue;
-
-            // get its cached values (will refresh if needed...)
-            RideFileCache rideCache(context, context->athlete->home.absolutePath() + "/" + rideFileName);
-
-            // lets aggregate
-            meanMaxAggregate(wattsMeanMaxDouble, rideCache.wattsMeanMaxDouble, wattsMeanMaxDate, rideDate);
-            meanMaxAggregate(hrMeanMaxDouble, rideCache.hrMeanMaxDouble, hrMeanMaxDate, rideDate);
-            meanMaxAggregate(cadMeanMaxDouble, rideCache.cadMeanMaxDouble, cadMeanMaxDate, rideDate);
-            meanMaxAggregate(nmMeanMaxDouble, rideCache.nmMeanMaxDouble, nmMeanMaxDate, rideDate);
-            meanMaxAggregate(kphMeanMaxDouble, rideCache.kphMeanMaxDouble, kphMeanMaxDate, rideDate);
-            meanMaxAggregate(xPowerMeanMaxDouble, rideCache.xPowerMeanMaxDouble, xPowerMeanMaxDate, rideDate);
-            meanMaxAggregate(npMeanMaxDouble, rideCache.npMeanMaxDouble, npMeanMaxDate, rideDate);
-            meanMaxAggregate(vamMeanMaxDouble, rideCache.vamMeanMaxDouble, vamMeanMaxDate, rideDate);
-            meanMaxAggregate(wattsKgMeanMaxDouble, rideCache.wattsKgMeanMaxDouble, wattsKgMeanMaxDate, rideDate);
-
-            distAggregate(wattsDistributionDouble, rideCache.wattsDistributionDouble);
-            distAggregate(hrDistributionDouble, rideCache.hrDistributionDouble);
-            distAggregate(cadDistributionDouble, rideCache.cadDistributionDouble);
-            distAggregate(nmDistributionDouble, rideCache.nmDistributionDouble);
-            distAggregate(kphDistributionDouble, rideCache.kphDistributionDouble);
-            distAggregate(xPowerDistributionDouble, rideCache.xPowerDistributionDouble);
-            distAggregate(npDistributionDouble, rideCache.npDistributionDouble);
-            distAggregate(wattsKgDistributionDouble, rideCache.wattsKgDistributionDouble);
-
-            // cumulate timeinzones
-            for (int i=0; i<10; i++) {
-                hrTimeInZone[i] += rideCache.hrTimeInZone[i];
-                wattsTimeInZone[i] += rideCache.wattsTimeInZone[i];
+    if (!filter && !context->isfiltered) {
+
+        // the index merges precomputed weeks, months and years
+        // and only reads the cpx files at the ends of the range
+        context->athlete->cpxIndex->aggregate(this, start, end);
+
+    } else {
+
+        // Iterate over the ride files (not the cpx files since they /might/ not
+        // exist, or /might/ be out of date.
+        foreach (QString rideFileName, RideFileFactory::instance().listRideFiles(context->athlete->home)) {
+            QDate rideDate = dateFromFileName(rideFileName);
+            if (((filter == true && files.contains(rideFileName)) || filter == false) &&
+                rideDate >= start && rideDate <= end) {
+
+                // skip globally filtered values
+                if (context->isfiltered && !context->filters.contains(rideFileName)) continue;
+
+                // get its cached values (will refresh if needed...)
+                RideFileCache rideCache(context, context->athlete->home.absolutePath() + "/" + rideFileName);
+
+                // lets aggregate
+                aggregate(rideCache, rideDate);
             }
         }
     }
@@ -980,6 +1415,7 @@ RideFileCache::RideFileCache(Context *context, QDate start, QDate end, bool filt
 
     // lets add to the cache for others to re-use -- but not if filtered
     if (!context->isfiltered && !filter) {
+        QMutexLocker locker(&cpxCacheLock);
         if (context->athlete->cpxCache.count() > maxcache) {
             delete(context->athlete->cpxCache.at(0));
             context->athlete->cpxCache.removeAt(0);
@@ -1214,78 +1650,105 @@ static long countForMeanMax(RideFileCacheHeader head, RideFile::SeriesType serie
 
     return 0;
 }
-double 
-RideFileCache::best(Context *context, QString filename, RideFile::SeriesType series, int duration)
+// lookup in a mapped cache file, called with cpxMappings.lock held
+static double
+mappedBest(const QString &cacheFileName, RideFile::SeriesType series, int duration)
 {
-    // read the header
-    QFileInfo rideFileInfo(context->athlete->home.absolutePath() + "/" + filename);
-    QString cacheFileName(context->athlete->home.absolutePath() + "/" + rideFileInfo.baseName() + ".cpx");
-    QFileInfo cacheFileInfo(cacheFileName);
+    qint64 size;
+    const uchar *data = cpxMappings.map(cacheFileName, size);
+    if (data == NULL) return 0;
 
-    // head
     RideFileCacheHeader head;
-    QFile cacheFile(cacheFileName);
+    memcpy(&head, data, sizeof(head));
 
-    if (cacheFile.open(QIODevice::ReadOnly | QIODevice::Unbuffered) == true) {
-        QDataStream inFile(&cacheFile);
-        inFile.readRawData((char *) &head, sizeof(head));
+    // out of date or not enough samples
+    if (head.version != RideFileCacheVersion || duration < 1 || duration > countForMeanMax(head, series))
+        return 0;
 
-        // out of date or not enough samples
-        if (head.version != RideFileCacheVersion || duration > countForMeanMax(head, series)) {
-            cacheFile.close();
-            return 0;
-        }
+    // jump to correct offset
+    qint64 offset = sizeof(head) + offsetForMeanMax(head, series) + (sizeof(float) * (duration-1));
+    if (offset + (qint64) sizeof(float) > size) return 0;
 
-        // jump to correct offset
-        long offset = offsetForMeanMax(head, series) + (sizeof(float) * (duration-1));
-        inFile.skipRawData(offset);
+    float readhere = 0;
+    memcpy(&readhere, data + offset, sizeof(float));
 
-        float readhere = 0;
-        inFile.readRawData((char*)&readhere, sizeof(float));
-        cacheFile.close();
+    double divisor = pow(10, RideFileCache::decimalsFor(series)); // ? 10 : 1;
+    return readhere / divisor; // will convert to double
+}
 
-        double divisor = pow(10, decimalsFor(series)); // ? 10 : 1;
-        return readhere / divisor; // will convert to double
-    }
+static int
+mappedTiz(const QString &cacheFileName, RideFile::SeriesType series, int zone)
+{
+    if (zone < 1 || zone > 10) return 0;
 
-    return 0;
+    qint64 size;
+    const uchar *data = cpxMappings.map(cacheFileName, size);
+    if (data == NULL) return 0;
+
+    RideFileCacheHeader head;
+    memcpy(&head, data, sizeof(head));
+
+    // out of date
+    if (head.version != RideFileCacheVersion) return 0;
+
+    // jump to correct offset
+    qint64 offset = sizeof(head) + offsetForTiz(head, series) + (sizeof(float) * (zone-1));
+    if (offset + (qint64) sizeof(float) > size) return 0;
+
+    float readhere = 0;
+    memcpy(&readhere, data + offset, sizeof(float));
+
+    return readhere;
+}
+
+static QString
+cacheFileNameFor(Context *context, const QString &filename)
+{
+    return context->athlete->home.absolutePath() + "/" + QFileInfo(filename).baseName() + ".cpx";
+}
+
+double
+RideFileCache::best(Context *context, QString filename, RideFile::SeriesType series, int duration)
+{
+    QMutexLocker locker(&cpxMappings.lock);
+    return mappedBest(cacheFileNameFor(context, filename), series, duration);
 }
 
 int 
 RideFileCache::tiz(Context *context, QString filename, RideFile::SeriesType series, int zone)
 {
-    if (zone < 1 || zone > 10) return 0;
-
-    // read the header
-    QFileInfo rideFileInfo(context->athlete->home.absolutePath() + "/" + filename);
-    QString cacheFileName(context->athlete->home.absolutePath() + "/" + rideFileInfo.baseName() + ".cpx");
-    QFileInfo cacheFileInfo(cacheFileName);
+    QMutexLocker locker(&cpxMappings.lock);
+    return mappedTiz(cacheFileNameFor(context, filename), series, zone);
+}
 
-    // head
-    RideFileCacheHeader head;
-    QFile cacheFile(cacheFileName);
+QVector<double>
+RideFileCache::best(Context *context, const QStringList &filenames, RideFile::SeriesType series, int duration)
+{
+    QVector<double> returning(filenames.count());
 
-    if (cacheFile.open(QIODevice::ReadOnly | QIODevice::Unbuffered) == true) {
-        QDataStream inFile(&cacheFile);
-        inFile.readRawData((char *) &head, sizeof(head));
+    QMutexLocker locker(&cpxMappings.lock);
+    for (int i=0; i<filenames.count(); i++)
+        returning[i] = mappedBest(cacheFileNameFor(context, filenames[i]), series, duration);
 
-        // out of date 
-        if (head.version != RideFileCacheVersion) {
-            cacheFile.close();
-            return 0;
-        }
+    return returning;
+}
 
-        // jump to correct offset
-        long offset = offsetForTiz(head, series) + (sizeof(float) * (zone-1));
-        inFile.skipRawData(offset);
+QVector<int>
+RideFileCache::tiz(Context *context, const QStringList &filenames, RideFile::SeriesType series, int zone)
+{
+    QVector<int> returning(filenames.count());
 
-        float readhere = 0;
-        inFile.readRawData((char*)&readhere, sizeof(float));
-        cacheFile.close();
+    QMutexLocker locker(&cpxMappings.lock);
+    for (int i=0; i<filenames.count(); i++)
+        returning[i] = mappedTiz(cacheFileNameFor(context, filenames[i]), series, zone);
 
-        return readhere; // will convert to double
-    }
+    return returning;
+}
 
-    return 0;
+void
+RideFileCache::releaseMapping(QString cacheFileName)
+{
+    QMutexLocker locker(&cpxMappings.lock);
+    cpxMappings.release(cacheFileName);
 }
 
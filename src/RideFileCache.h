@@ -19,6 +19,7 @@
 #ifndef _GC_RideFileCache_h
 #define _GC_RideFileCache_h 1
 #include "RideFile.h"
+#include "RideSet.h"
 #include <QString>
 #include <QDataStream>
 #include <QVector>
@@ -124,18 +125,30 @@ class RideFileCache
 
         // Construct a ridefile cache that represents the data
         // across a date range. This is used to provide aggregated data.
-        RideFileCache(Context *context, QDate start, QDate end, bool filter = false, QStringList files = QStringList());
+        RideFileCache(Context *context, QDate start, QDate end, bool filter = false, const RideSet &files = RideSet());
 
         // not actually a copy constructor -- but we call it IN the constructor.
         RideFileCache(RideFileCache *other) { *this = *other; }
 
         // get a single best or time in zone value from the cache file
-        // intended to be very fast (using lseek to jump direct to the value requested
+        // intended to be very fast (the cache files are mapped and indexed directly)
         static double best(Context *context, QString fileName, RideFile::SeriesType series, int duration);
         static int tiz(Context *context, QString fileName, RideFile::SeriesType series, int zone);
 
+        // the same for many rides at once e.g. every ride in the metric db
+        // returns a value for each file, zero where there is no cache
+        static QVector<double> best(Context *context, const QStringList &fileNames, RideFile::SeriesType series, int duration);
+        static QVector<int> tiz(Context *context, const QStringList &fileNames, RideFile::SeriesType series, int zone);
+
+        // the .cpx files are mapped by best() and tiz() so they
+        // must be released before they are rewritten or deleted
+        static void releaseMapping(QString cacheFileName);
+
         static int decimalsFor(RideFile::SeriesType series);
 
+        // is the .cpx for this ride file present and up to date?
+        static bool isCurrent(QString rideFileName);
+
         // get data
         QVector<double> &meanMaxArray(RideFile::SeriesType); // return meanmax array for the given series
         QVector<QDate> &meanMaxDates(RideFile::SeriesType series); // the dates of the bests
@@ -149,6 +162,15 @@ class RideFileCache
 
     protected:
 
+        friend class RideFileCacheIndex;
+
+        // an empty aggregate and adding rides or other aggregates to it
+        RideFileCache(Context *context);
+        void aggregate(RideFileCache &other, QDate rideDate);
+        void serializeAggregate(QDataStream &out);
+        bool readAggregate(QDataStream &in);
+        static QDate dateFromFileName(const QString filename);
+
         void refreshCache();              // compute arrays and update cache
         void readCache();                 // just read from saved file and setup arrays
         void serialize(QDataStream *out); // write to file
@@ -258,8 +280,9 @@ struct cpintdata {
     cpintdata() : rec_int_ms(0) {}
 };
 
-// the mean-max computer ... runs in a thread
-class MeanMaxComputer : public QThread
+// the mean-max computer ... one for each series, they are run
+// as tasks on the global thread pool (see MeanMaxTasks)
+class MeanMaxComputer
 {
     public:
         MeanMaxComputer(RideFile *ride, QVector<float>&array, RideFile::SeriesType series)
@@ -273,6 +296,9 @@ class MeanMaxComputer : public QThread
         data_t partial_max_mean(data_t *dataseries_i, int start, int end, int length, int *offset);
         data_t divided_max_mean(data_t *dataseries_i, int datalength, int length, int *offset);
 
+        // all durations at once, sharing sections across durations
+        void all_max_means(data_t *dataseries_i, int datalength, QVector<data_t> &energies);
+
         RideFile *ride;
         QVector<float> &array;
         QVector<data_t> integratedArray;
@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2026 GoldenCheetah Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "RideFileCacheIndex.h"
+#include "RideFileCache.h"
+#include "Context.h"
+#include "Athlete.h"
+
+#include <QFile>
+#include <QDataStream>
+
+RideFileCacheIndex::RideFileCacheIndex(Context *context) : context(context), lock(QMutex::Recursive)
+{
+}
+
+//
+// PERIODS
+//
+QDate
+RideFileCacheIndex::periodEnd(PeriodLevel level, QDate from) const
+{
+    QDate monthEnd(from.year(), from.month(), from.daysInMonth());
+
+    switch (level) {
+    case year : return QDate(from.year(), 12, 31);
+    case month : return monthEnd;
+    default:
+    case week :
+        {
+            // sunday, unless the month ends first
+            QDate sunday = from.addDays(7 - from.dayOfWeek());
+            return sunday < monthEnd ? sunday : monthEnd;
+        }
+    }
+}
+
+QString
+RideFileCacheIndex::periodFileName(PeriodLevel level, QDate from) const
+{
+    QString name;
+    switch (level) {
+    case year : name = from.toString("yyyy"); break;
+    case month : name = from.toString("yyyy_MM"); break;
+    default:
+    case week : name = from.toString("yyyy_MM_dd"); break;
+    }
+    return context->athlete->home.absolutePath() + "/" + name + ".cpxi";
+}
+
+//
+// AGGREGATE FOR A DATE RANGE
+//
+void
+RideFileCacheIndex::aggregate(RideFileCache *into, QDate start, QDate end)
+{
+    QMutexLocker locker(&lock);
+
+    // what rides do we have?
+    rides.clear();
+    foreach (QString rideFileName, RideFileFactory::instance().listRideFiles(context->athlete->home)) {
+        QDate rideDate = RideFileCache::dateFromFileName(rideFileName);
+        if (rideDate.isValid()) rides[rideDate] << rideFileName;
+    }
+    if (rides.isEmpty()) return;
+
+    // no point walking days before the first ride or after the last
+    QDate first = rides.constBegin().key();
+    QDate last = (rides.constEnd()-1).key();
+    if (start < first) start = first;
+    if (end > last) end = last;
+
+    // take the biggest period that starts here and fits in the range
+    QDate date = start;
+    while (date <= end) {
+
+        if (date.month() == 1 && date.day() == 1 && periodEnd(year, date) <= end) {
+
+            mergePeriod(into, year, date);
+            date = date.addYears(1);
+
+        } else if (date.day() == 1 && periodEnd(month, date) <= end) {
+
+            mergePeriod(into, month, date);
+            date = date.addMonths(1);
+
+        } else if ((date.dayOfWeek() == 1 || date.day() == 1) && periodEnd(week, date) <= end) {
+
+            mergePeriod(into, week, date);
+            date = periodEnd(week, date).addDays(1);
+
+        } else {
+
+            mergeDay(into, date);
+            date = date.addDays(1);
+        }
+    }
+}
+
+void
+RideFileCacheIndex::mergePeriod(RideFileCache *into, PeriodLevel level, QDate from)
+{
+    // nothing to do if there are no rides in the period
+    QMap<QDate, QStringList>::const_iterator first = rides.lowerBound(from);
+    if (first == rides.constEnd() || first.key() > periodEnd(level, from)) return;
+
+    RideFileCache node(context);
+    if (!readPeriod(&node, level, from)) {
+        buildPeriod(&node, level, from);
+        writePeriod(&node, level, from);
+    }
+    into->aggregate(node, QDate());
+}
+
+void
+RideFileCacheIndex::buildPeriod(RideFileCache *node, PeriodLevel level, QDate from)
+{
+    QDate to = periodEnd(level, from);
+
+    switch (level) {
+    case year :
+        for (QDate date = from; date <= to; date = date.addMonths(1))
+            mergePeriod(node, month, date);
+        break;
+
+    case month :
+        for (QDate date = from; date <= to; date = periodEnd(week, date).addDays(1))
+            mergePeriod(node, week, date);
+        break;
+
+    case week :
+        for (QDate date = from; date <= to; date = date.addDays(1))
+            mergeDay(node, date);
+        break;
+    }
+}
+
+void
+RideFileCacheIndex::mergeDay(RideFileCache *into, QDate date)
+{
+    foreach (QString rideFileName, rides.value(date)) {
+
+        // get its cached values (will refresh if needed...)
+        RideFileCache rideCache(context, context->athlete->home.absolutePath() + "/" + rideFileName);
+        into->aggregate(rideCache, date);
+    }
+}
+
+//
+// PERSISTANCE
+//
+bool
+RideFileCacheIndex::readPeriod(RideFileCache *node, PeriodLevel level, QDate from)
+{
+    QFile file(periodFileName(level, from));
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_4_6);
+
+    // stale if either we or the cpx files have changed format
+    quint32 version, cacheVersion;
+    in >> version >> cacheVersion;
+    if (in.status() != QDataStream::Ok || version != RideFileCacheIndexVersion ||
+        cacheVersion != RideFileCacheVersion) return false;
+
+    // don't leave a partial period in node if it's truncated
+    RideFileCache period(context);
+    if (!period.readAggregate(in)) return false;
+
+    *node = period;
+    return true;
+}
+
+void
+RideFileCacheIndex::writePeriod(RideFileCache *node, PeriodLevel level, QDate from)
+{
+    QFile file(periodFileName(level, from));
+    if (!file.open(QIODevice::WriteOnly)) return;
+    file.resize(0);
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_6);
+
+    out << (quint32) RideFileCacheIndexVersion << (quint32) RideFileCacheVersion;
+    node->serializeAggregate(out);
+
+    file.close();
+
+    // don't leave a partial period behind
+    if (out.status() != QDataStream::Ok) file.remove();
+}
+
+void
+RideFileCacheIndex::rideChanged(QString rideFileName)
+{
+    QDate date = RideFileCache::dateFromFileName(rideFileName);
+    if (!date.isValid()) return;
+
+    QMutexLocker locker(&lock);
+
+    // the week containing it starts on monday, or the first of the month
+    QDate weekStart = date.addDays(1 - date.dayOfWeek());
+    if (weekStart.month() != date.month()) weekStart = QDate(date.year(), date.month(), 1);
+
+    QFile::remove(periodFileName(week, weekStart));
+    QFile::remove(periodFileName(month, QDate(date.year(), date.month(), 1)));
+    QFile::remove(periodFileName(year, QDate(date.year(), 1, 1)));
+}
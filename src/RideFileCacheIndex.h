@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2026 GoldenCheetah Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _GC_RideFileCacheIndex_h
+#define _GC_RideFileCacheIndex_h 1
+#include "GoldenCheetah.h"
+
+#include <QDate>
+#include <QMap>
+#include <QMutex>
+#include <QStringList>
+
+class Context;
+class RideFileCache;
+
+// The RideFileCacheIndex holds the aggregated mean-max, distribution
+// and time in zone arrays for each year, month and week that has rides
+// in it, so a date range can be aggregated by merging a handful of
+// periods rather than reading the .cpx for every ride in the range.
+//
+// The periods nest, a year is made of months and a month is made of
+// weeks, but since weeks don't line up with months a week here is the
+// part of a week (Monday to Sunday) that falls within its month.
+//
+// Each period is kept in the athlete's home directory as a .cpxi file
+// named for the first day of the period e.g. 2013.cpxi, 2013_07.cpxi
+// or 2013_07_22.cpxi. They are built as they are needed, and when the
+// .cpx for a ride is rewritten, or a ride is added or deleted, just the
+// week, month and year containing the ride are removed.
+static const unsigned int RideFileCacheIndexVersion = 1;
+// revision history:
+// version  date         description
+// 1        16-Oct-26    Initial - mean-max with dates, distributions and TIZ
+
+class RideFileCacheIndex
+{
+    public:
+        RideFileCacheIndex(Context *context);
+
+        // aggregate all the rides from start to end inclusive
+        void aggregate(RideFileCache *into, QDate start, QDate end);
+
+        // the cpx for this ride has been updated or it has been
+        // added or deleted, so the periods containing it are stale
+        void rideChanged(QString rideFileName);
+
+    private:
+
+        enum periodlevel { year, month, week };
+        typedef enum periodlevel PeriodLevel;
+
+        QDate periodEnd(PeriodLevel level, QDate from) const;
+        QString periodFileName(PeriodLevel level, QDate from) const;
+
+        // merge a period from disk, building it if needed
+        void mergePeriod(RideFileCache *into, PeriodLevel level, QDate from);
+        void buildPeriod(RideFileCache *node, PeriodLevel level, QDate from);
+        bool readPeriod(RideFileCache *node, PeriodLevel level, QDate from);
+        void writePeriod(RideFileCache *node, PeriodLevel level, QDate from);
+
+        // merge the rides for a single day
+        void mergeDay(RideFileCache *into, QDate date);
+
+        Context *context;
+
+        // rides by date, refreshed for each aggregate
+        QMap<QDate, QStringList> rides;
+
+        // we are updated from the metric refresh threads and
+        // building a period can cause rides to be refreshed
+        QMutex lock;
+};
+#endif // _GC_RideFileCacheIndex_h
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2026 GoldenCheetah Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "RideFileOpenQueue.h"
+#include "Context.h"
+#include <QCoreApplication>
+
+RideFileOpenQueue::RideFileOpenQueue(Context *context, QStringList filenames)
+    : context(context), filenames(filenames), nextIndex(0), taken(0), aborted(false)
+{
+    // one opener per core, they can get a couple of rides
+    // ahead of the gui before they have to wait
+    workers = qMin(qMax(1, QThread::idealThreadCount()), filenames.count());
+    capacity = qMax(1, workers * 2);
+
+    for (int n=0; n<workers; n++) {
+        RideFileOpener *opener = new RideFileOpener(this);
+        openers << opener;
+        opener->start();
+    }
+}
+
+RideFileOpenQueue::~RideFileOpenQueue()
+{
+    abort();
+
+    // they will exit once they finish the file they are on
+    foreach (RideFileOpener *opener, openers) {
+        opener->wait();
+        delete opener;
+    }
+}
+
+// an archive hands back the ride as the first in the list too
+void
+RideFileOpenQueue::free(RideFileOpenItem &item)
+{
+    if (item.ride && !item.rides.contains(item.ride)) delete item.ride;
+    qDeleteAll(item.rides);
+    item.ride = NULL;
+    item.rides.clear();
+}
+
+bool
+RideFileOpenQueue::next(RideFileOpenItem &item)
+{
+    QMutexLocker locker(&lock);
+    if (aborted || nextIndex >= filenames.count()) return false;
+    item.index = nextIndex++;
+    item.name = filenames[item.index];
+    return true;
+}
+
+void
+RideFileOpenQueue::done(RideFileOpenItem &item)
+{
+    QMutexLocker locker(&lock);
+
+    // the one the gui is waiting for never waits here, so
+    // we can't deadlock, and never hold more than capacity
+    while (!aborted && item.index >= taken + capacity) notFull.wait(&lock);
+
+    if (aborted) free(item);
+    else results.insert(item.index, item);
+    notEmpty.wakeOne();
+}
+
+void
+RideFileOpenQueue::finished()
+{
+    QMutexLocker locker(&lock);
+    workers--;
+    notEmpty.wakeOne();
+}
+
+bool
+RideFileOpenQueue::take(RideFileOpenItem &item, int msecs)
+{
+    QMutexLocker locker(&lock);
+    if (aborted) return false;
+    if (!results.contains(taken) && workers) notEmpty.wait(&lock, msecs);
+    if (aborted || !results.contains(taken)) return false;
+    item = results.take(taken++);
+    notFull.wakeAll();
+    return true;
+}
+
+bool
+RideFileOpenQueue::isFinished()
+{
+    QMutexLocker locker(&lock);
+    return taken == filenames.count() || (aborted && workers == 0);
+}
+
+void
+RideFileOpenQueue::abort()
+{
+    QMutexLocker locker(&lock);
+    aborted = true;
+
+    // nothing more is handed back, even if it is ready
+    QMutableMapIterator<int, RideFileOpenItem> i(results);
+    while (i.hasNext()) free(i.next().value());
+    results.clear();
+
+    notFull.wakeAll();
+    notEmpty.wakeAll();
+}
+
+void
+RideFileOpener::run()
+{
+    RideFileOpenItem item;
+    while (queue->next(item)) {
+
+        // parse and auto-process it
+        QFile file(item.name);
+        item.ride = RideFileFactory::instance().openRideFile(queue->context, file, item.errors, &item.rides);
+
+        // they belong to the gui thread from now on
+        QThread *gui = QCoreApplication::instance()->thread();
+        if (item.ride) item.ride->moveToThread(gui);
+        foreach (RideFile *ride, item.rides) ride->moveToThread(gui);
+
+        // hand back to the gui
+        queue->done(item);
+        item = RideFileOpenItem();
+    }
+    queue->finished();
+}
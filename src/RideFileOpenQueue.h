@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2026 GoldenCheetah Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _GC_RideFileOpenQueue_h
+#define _GC_RideFileOpenQueue_h
+#include "GoldenCheetah.h"
+
+#include "RideFile.h"
+#include <QList>
+#include <QMap>
+#include <QStringList>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+
+class Context;
+class RideFileOpener;
+
+// Opening a lot of rides is a pipeline; a pool of RideFileOpener threads
+// parse and auto-process each file with RideFileFactory::openRideFile and
+// the RideFileOpenQueue hands them back to the gui thread, which updates
+// the dialog and writes them away.
+//
+// They are handed back in the order they were given, however long each one
+// takes to parse, and only a few are held in memory at any one time.
+struct RideFileOpenItem
+{
+    int index;              // into the list of filenames given
+    QString name;           // full path of the file
+    RideFile *ride;         // NULL if it could not be opened
+    QList<RideFile*> rides; // when it is an archive of rides
+    QStringList errors;     // or warnings when the ride was opened
+
+    RideFileOpenItem() : index(-1), ride(NULL) {}
+};
+
+class RideFileOpenQueue
+{
+    public:
+        RideFileOpenQueue(Context *context, QStringList filenames);
+        ~RideFileOpenQueue(); // aborts, waits for the openers and frees what wasn't taken
+
+        // gui side, the item taken owns its rides
+        bool take(RideFileOpenItem &item, int msecs); // wait for the next one in order
+        bool isFinished();                            // all taken, or aborted and stopped
+        void abort();                                 // stop opening files, and drop those not taken
+
+        static void free(RideFileOpenItem &item);     // delete its rides
+
+    private:
+        friend class RideFileOpener;
+
+        // opener side
+        bool next(RideFileOpenItem &item);      // false when nothing left to do
+        void done(RideFileOpenItem &item);      // blocks whilst too far ahead
+        void finished();                        // opener is exiting
+
+        Context *context;
+        QStringList filenames;
+        QList<RideFileOpener*> openers;
+
+        QMutex lock;
+        QWaitCondition notFull, notEmpty;
+
+        QMap<int, RideFileOpenItem> results; // by index
+        int nextIndex, taken, workers, capacity;
+        bool aborted;
+};
+
+class RideFileOpener : public QThread
+{
+    public:
+        RideFileOpener(RideFileOpenQueue *queue) : queue(queue) {}
+        void run();
+
+    private:
+        RideFileOpenQueue *queue;
+};
+
+#endif // _GC_RideFileOpenQueue_h
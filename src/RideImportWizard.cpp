@@ -20,6 +20,7 @@
 #include "MainWindow.h"
 #include "RideItem.h"
 #include "RideFile.h"
+#include "RideFileOpenQueue.h"
 #include "RideImportWizard.h"
 #include "Context.h"
 #include "Athlete.h"
@@ -260,190 +261,202 @@ RideImportWizard::process()
     QApplication::processEvents();
 
     // Pass 2 - Read in with the relevant RideFileReader method
+    //          the files are parsed on a pool of threads and handed back
+    //          in order. Archives are replaced with a row for each ride
+    //          they contain and those are parsed in the next round.
 
     phaseLabel->setText(tr("Step 2 of 4: Validating Files"));
-   for (int i=0; i< filenames.count(); i++) {
 
+    QList<int> rows;
+    for (int i=0; i< filenames.count(); i++)
+        if (!tableWidget->item(i,5)->text().startsWith(tr("Error"))) rows << i;
+
+    while (!rows.isEmpty() && !aborted) {
+
+        QStringList names;
+        foreach (int row, rows) names << filenames[row];
+
+        RideFileOpenQueue queue(context, names);
+        QList<int> unpacked;  // rows added for the rides in archives
+        int added = 0;        // rows below an archive move down
+
+        while (!queue.isFinished()) {
+
+            RideFileOpenItem item;
+            if (queue.take(item, 100)) {
+
+                int i = rows[item.index] + added;
+                tableWidget->setCurrentCell(i,5);
+
+                // is this an archive of files?
+                if (item.rides.count() > 1) {
+
+                    int here = i;
+
+                    QList<RideFile*> rides = item.rides;
+                    // remove current filename from state arrays and tableview
+                    filenames.removeAt(here);
+                    blanks.removeAt(here);
+                    tableWidget->removeRow(here);
+
+                    // resize dialog according to the number of rows we expect
+                    int willhave = filenames.count() + rides.count();
+                    resize(920 + ((willhave > 16 ? 24 : 0) +
+                        ((willhave > 9 && willhave < 17) ? 8 : 0)),
+                        118 + ((willhave > 16 ? 17*20 : (willhave+1) * 20)));
+
+
+                    // ok so create a temporary file and add to the tableWidget
+                    int counter = 0;
+                    foreach(RideFile *extracted, rides) {
+
+                        // write as a temporary file, using the original
+                        // filename with "-n" appended
+                        QString fulltarget = QDir::tempPath() + "/" + QFileInfo(item.name).baseName() + QString("-%1.tcx").arg(counter+1);
+                        TcxFileReader reader;
+                        QFile target(fulltarget);
+                        reader.writeRideFile(context, extracted, target);
+                        deleteMe.append(fulltarget);
+                        delete extracted;
+
+                        // now add each temporary file ...
+                        filenames.insert(here+counter, fulltarget);
+                        blanks.insert(here+counter, true); // by default editable
+                        tableWidget->insertRow(here+counter);
+                        unpacked << here+counter; // to parse next round
+
+                        QTableWidgetItem *t;
+
+                        // Filename
+                        t = new QTableWidgetItem();
+                        t->setText(fulltarget);
+                        t->setFlags(t->flags() & (~Qt::ItemIsEditable));
+                        tableWidget->setItem(here+counter,0,t);
+
+                        // Date
+                        t = new QTableWidgetItem();
+                        t->setText(tr(""));
+                        t->setFlags(t->flags()  | Qt::ItemIsEditable);
+                        t->setBackgroundColor(Qt::red);
+                        tableWidget->setItem(here+counter,1,t);
+
+                        // Time
+                        t = new QTableWidgetItem();
+                        t->setText(tr(""));
+                        t->setFlags(t->flags() | Qt::ItemIsEditable);
+                        tableWidget->setItem(here+counter,2,t);
+
+                        // Duration
+                        t = new QTableWidgetItem();
+                        t->setText(tr(""));
+                        t->setFlags(t->flags() & (~Qt::ItemIsEditable));
+                        tableWidget->setItem(here+counter,3,t);
+
+                        // Distance
+                        t = new QTableWidgetItem();
+                        t->setText(tr(""));
+                        t->setFlags(t->flags() & (~Qt::ItemIsEditable));
+                        tableWidget->setItem(here+counter,4,t);
+
+                        // Import Status
+                        t = new QTableWidgetItem();
+                        t->setText(tr(""));
+                        t->setFlags(t->flags() & (~Qt::ItemIsEditable));
+                        tableWidget->setItem(here+counter,5,t);
+
+                        counter++;
+
+                        tableWidget->adjustSize();
+                    }
+                    QApplication::processEvents();
 
-        // does the status say Queued?
-        if (!tableWidget->item(i,5)->text().startsWith(tr("Error"))) {
 
-              QStringList errors;
-              QFile thisfile(filenames[i]);
-
-              tableWidget->item(i,5)->setText(tr("Parsing..."));
-              tableWidget->setCurrentCell(i,5);
-              QApplication::processEvents();
-
-              if (aborted) { done(0); }
-              this->repaint();
-              QApplication::processEvents();
-
-              QList<RideFile*> rides;
-              RideFile *ride = RideFileFactory::instance().openRideFile(context, thisfile, errors, &rides);
-
-              // is this an archive of files?
-              if (rides.count() > 1) {
-
-                 int here = i;
-
-                 // remove current filename from state arrays and tableview
-                 filenames.removeAt(here);
-                 blanks.removeAt(here);
-                 tableWidget->removeRow(here);
-
-                 // resize dialog according to the number of rows we expect
-                 int willhave = filenames.count() + rides.count();
-                 resize(920 + ((willhave > 16 ? 24 : 0) +
-                     ((willhave > 9 && willhave < 17) ? 8 : 0)),
-                     118 + ((willhave > 16 ? 17*20 : (willhave+1) * 20)));
-
-
-                 // ok so create a temporary file and add to the tableWidget
-                 int counter = 0;
-                 foreach(RideFile *extracted, rides) {
-
-                     // write as a temporary file, using the original
-                     // filename with "-n" appended
-                     QString fulltarget = QDir::tempPath() + "/" + QFileInfo(thisfile).baseName() + QString("-%1.tcx").arg(counter+1);
-                     TcxFileReader reader;
-                     QFile target(fulltarget);
-                     reader.writeRideFile(context, extracted, target);
-                     deleteMe.append(fulltarget);
-                     delete extracted;
-                     
-                     // now add each temporary file ...
-                     filenames.insert(here, fulltarget);
-                     blanks.insert(here, true); // by default editable
-                     tableWidget->insertRow(here+counter);
-
-                     QTableWidgetItem *t;
-
-                     // Filename
-                     t = new QTableWidgetItem();
-                     t->setText(fulltarget);
-                     t->setFlags(t->flags() & (~Qt::ItemIsEditable));
-                     tableWidget->setItem(here+counter,0,t);
-
-                     // Date
-                     t = new QTableWidgetItem();
-                     t->setText(tr(""));
-                     t->setFlags(t->flags()  | Qt::ItemIsEditable);
-                     t->setBackgroundColor(Qt::red);
-                     tableWidget->setItem(here+counter,1,t);
-
-                     // Time
-                     t = new QTableWidgetItem();
-                     t->setText(tr(""));
-                     t->setFlags(t->flags() | Qt::ItemIsEditable);
-                     tableWidget->setItem(here+counter,2,t);
-
-                     // Duration
-                     t = new QTableWidgetItem();
-                     t->setText(tr(""));
-                     t->setFlags(t->flags() & (~Qt::ItemIsEditable));
-                     tableWidget->setItem(here+counter,3,t);
-
-                     // Distance
-                     t = new QTableWidgetItem();
-                     t->setText(tr(""));
-                     t->setFlags(t->flags() & (~Qt::ItemIsEditable));
-                     tableWidget->setItem(here+counter,4,t);
-
-                     // Import Status
-                     t = new QTableWidgetItem();
-                     t->setText(tr(""));
-                     t->setFlags(t->flags() & (~Qt::ItemIsEditable));
-                     tableWidget->setItem(here+counter,5,t);
-
-                     counter++;
-
-                     tableWidget->adjustSize();
-                 }
-                 QApplication::processEvents();
-
-
-                 // progress bar needs to adjust...
-                 progressBar->setMaximum(filenames.count()*4);
-
-                 // then go back one and re-parse from there
-                 rides.clear();
-   
-                 i--;
-                 goto next; // buttugly I know, but count em across 100,000 lines of code
-
-              }
-
-              // did it parse ok?
-              if (ride) {
-
-                   // ride != NULL but !errors.isEmpty() means they're just warnings
-                   if (errors.isEmpty())
-                       tableWidget->item(i,5)->setText(tr("Validated"));
-                   else
-                       tableWidget->item(i,5)->setText(tr("Warning - ") + errors.join(tr(" ")));
-
-                   // Set Date and Time
-                   if (ride->startTime().isNull()) {
-
-                       // Poo. The user needs to supply the date/time for this ride
-                       blanks[i] = true;
-                       tableWidget->item(i,1)->setText(tr(""));
-                       tableWidget->item(i,2)->setText(tr(""));
-
-                   } else {
-
-                       // Cool, the date and time was extrcted from the source file
-                       blanks[i] = false;
-                       tableWidget->item(i,1)->setText(ride->startTime().toString(tr("dd MMM yyyy")));
-                       tableWidget->item(i,2)->setText(ride->startTime().toString(tr("hh:mm:ss ap")));
-                   }
-
-                   tableWidget->item(i,1)->setTextAlignment(Qt::AlignRight); // put in the middle
-                   tableWidget->item(i,2)->setTextAlignment(Qt::AlignRight); // put in the middle
-
-                   // time and distance from tags (.gc files)
-                   QMap<QString,QString> lookup;
-                   lookup = ride->metricOverrides.value("total_distance");
-                   double km = lookup.value("value", "0.0").toDouble();
-
-                   lookup = ride->metricOverrides.value("workout_time");
-                   int secs = lookup.value("value", "0.0").toDouble();
-
-                   // show duration by looking at last data point
-                   if (!ride->dataPoints().isEmpty() && ride->dataPoints().last() != NULL) {
-                       if (!secs) secs = ride->dataPoints().last()->secs;
-                       if (!km) km = ride->dataPoints().last()->km;
-                   }
-
-                   QChar zero = QLatin1Char ( '0' );
-                   QString time = QString("%1:%2:%3").arg(secs/3600,2,10,zero)
-                       .arg(secs%3600/60,2,10,zero)
-                       .arg(secs%60,2,10,zero);
-                   tableWidget->item(i,3)->setText(time);
-                   tableWidget->item(i,3)->setTextAlignment(Qt::AlignHCenter); // put in the middle
-
-                   // show distance by looking at last data point
-                   QString dist = context->athlete->useMetricUnits
-                       ? QString ("%1 km").arg(km, 0, 'f', 1)
-                       : QString ("%1 mi").arg(km * MILES_PER_KM, 0, 'f', 1);
-                   tableWidget->item(i,4)->setText(dist);
-                   tableWidget->item(i,4)->setTextAlignment(Qt::AlignRight); // put in the middle
-
-                   delete ride;
-               } else {
-                   // nope - can't handle this file
-                   tableWidget->item(i,5)->setText(tr("Error - ") + errors.join(tr(" ")));
-               }
+                    added += rides.count() - 1;
+                    item.rides.clear();
+                    if (item.ride && !rides.contains(item.ride)) delete item.ride;
+
+                    // progress bar needs to adjust...
+                    progressBar->setMaximum(filenames.count()*4);
+
+                // did it parse ok?
+                } else if (item.ride) {
+
+                    RideFile *ride = item.ride;
+
+                    // ride != NULL but !item.errors.isEmpty() means they're just warnings
+                    if (item.errors.isEmpty())
+                        tableWidget->item(i,5)->setText(tr("Validated"));
+                    else
+                        tableWidget->item(i,5)->setText(tr("Warning - ") + item.errors.join(tr(" ")));
+
+                    // Set Date and Time
+                    if (ride->startTime().isNull()) {
+
+                        // Poo. The user needs to supply the date/time for this ride
+                        blanks[i] = true;
+                        tableWidget->item(i,1)->setText(tr(""));
+                        tableWidget->item(i,2)->setText(tr(""));
+
+                    } else {
+
+                        // Cool, the date and time was extrcted from the source file
+                        blanks[i] = false;
+                        tableWidget->item(i,1)->setText(ride->startTime().toString(tr("dd MMM yyyy")));
+                        tableWidget->item(i,2)->setText(ride->startTime().toString(tr("hh:mm:ss ap")));
+                    }
+
+                    tableWidget->item(i,1)->setTextAlignment(Qt::AlignRight); // put in the middle
+                    tableWidget->item(i,2)->setTextAlignment(Qt::AlignRight); // put in the middle
+
+                    // time and distance from tags (.gc files)
+                    QMap<QString,QString> lookup;
+                    lookup = ride->metricOverrides.value("total_distance");
+                    double km = lookup.value("value", "0.0").toDouble();
+
+                    lookup = ride->metricOverrides.value("workout_time");
+                    int secs = lookup.value("value", "0.0").toDouble();
+
+                    // show duration by looking at last data point
+                    if (!ride->dataPoints().isEmpty() && ride->dataPoints().last() != NULL) {
+                        if (!secs) secs = ride->dataPoints().last()->secs;
+                        if (!km) km = ride->dataPoints().last()->km;
+                    }
+
+                    QChar zero = QLatin1Char ( '0' );
+                    QString time = QString("%1:%2:%3").arg(secs/3600,2,10,zero)
+                        .arg(secs%3600/60,2,10,zero)
+                        .arg(secs%60,2,10,zero);
+                    tableWidget->item(i,3)->setText(time);
+                    tableWidget->item(i,3)->setTextAlignment(Qt::AlignHCenter); // put in the middle
+
+                    // show distance by looking at last data point
+                    QString dist = context->athlete->useMetricUnits
+                        ? QString ("%1 km").arg(km, 0, 'f', 1)
+                        : QString ("%1 mi").arg(km * MILES_PER_KM, 0, 'f', 1);
+                    tableWidget->item(i,4)->setText(dist);
+                    tableWidget->item(i,4)->setTextAlignment(Qt::AlignRight); // put in the middle
+
+                    RideFileOpenQueue::free(item);
+                    progressBar->setValue(progressBar->value()+1);
+
+                } else {
+                    // nope - can't handle this file
+                    tableWidget->item(i,5)->setText(tr("Error - ") + item.errors.join(tr(" ")));
+                    progressBar->setValue(progressBar->value()+1);
+                }
+            }
+
+            QApplication::processEvents();
+            if (aborted) queue.abort(); // the openers finish the file they are on
+            this->repaint();
         }
-        progressBar->setValue(progressBar->value()+1);
-        QApplication::processEvents();
-        if (aborted) { done(0); }
-        this->repaint();
 
-        next:;
+        // now parse the rides we took out of archives
+        rows = unpacked;
     }
 
+    if (aborted) { done(0); return 0; }
+
     // Pass 3 - get missing date and times for imported files
     //         Actually allow us to edit date on ANY ride, we
     //         make sure that the ride date/time is set from
@@ -755,6 +768,17 @@ RideImportWizard::abortClicked()
 
     QChar zero = QLatin1Char ( '0' );
 
+    // gc and json files are parsed and serialized with the new
+    // ride date/time, we read them all on a pool of threads now
+    QStringList converts;
+    for (int i=0; i< filenames.count(); i++) {
+        if (tableWidget->item(i,5)->text().startsWith(tr("Error"))) continue;
+        if (filenames[i].endsWith(".gc", Qt::CaseInsensitive) ||
+            filenames[i].endsWith(".json", Qt::CaseInsensitive))
+            converts << filenames[i];
+    }
+    RideFileOpenQueue queue(context, converts);
+
     for (int i=0; i< filenames.count(); i++) {
 
         if (tableWidget->item(i,5)->text().startsWith(tr("Error"))) continue; // skip error
@@ -762,7 +786,7 @@ RideImportWizard::abortClicked()
         tableWidget->item(i,5)->setText(tr("Saving..."));
         tableWidget->setCurrentCell(i,5);
         QApplication::processEvents();
-        if (aborted) { done(0); }
+        if (aborted) { done(0); return; }
         this->repaint();
 
         // Setup the ridetime as a QDateTime
@@ -786,6 +810,11 @@ RideImportWizard::abortClicked()
         if (filenames[i].endsWith(".gc", Qt::CaseInsensitive) ||
             filenames[i].endsWith(".json", Qt::CaseInsensitive)) {
 
+            // they come back in the same order
+            RideFileOpenItem item;
+            while (!queue.take(item, 100) && !aborted) QApplication::processEvents();
+            if (aborted) { done(0); return; }
+
             QStringList duplicates;
 
             // CHECK FOR DUPLICATE
@@ -799,36 +828,39 @@ RideImportWizard::abortClicked()
                     removeDuplicate(duplicate); // we do not use removeRide coz it clashes
                 }
 
-                // read the file (again)
-                QStringList errors;
-                QFile thisfile(filenames[i]);
-                RideFile *ride(RideFileFactory::instance().openRideFile(context, thisfile, errors));
-
-                // update ridedatetime
-                ride->setStartTime(ridedatetime);
+                // the file was read (again) above
+                RideFile *ride = item.ride;
 
-                // serialize
-                if (filenames[i].endsWith(".gc")) {
-                    GcFileReader reader;
-                    QFile target(fulltarget);
-                    reader.writeRideFile(context, ride, target);
+                if (ride == NULL) {
+                    tableWidget->item(i,5)->setText(tr("Error - ") + item.errors.join(tr(" ")));
                 } else {
-                    JsonFileReader reader;
-                    QFile target(fulltarget);
-                    reader.writeRideFile(context, ride, target);
-                }
 
-                // clear
-                delete ride;
+                    // update ridedatetime
+                    ride->setStartTime(ridedatetime);
 
-                if (duplicates.count()) {
-                    tableWidget->item(i,5)->setText(tr("File Overwritten"));
-                } else {
-                    tableWidget->item(i,5)->setText(tr("File Saved"));
-                    context->athlete->addRide(QFileInfo(fulltarget).fileName(), true);
+                    // serialize
+                    if (filenames[i].endsWith(".gc")) {
+                        GcFileReader reader;
+                        QFile target(fulltarget);
+                        reader.writeRideFile(context, ride, target);
+                    } else {
+                        JsonFileReader reader;
+                        QFile target(fulltarget);
+                        reader.writeRideFile(context, ride, target);
+                    }
+
+                    if (duplicates.count()) {
+                        tableWidget->item(i,5)->setText(tr("File Overwritten"));
+                    } else {
+                        tableWidget->item(i,5)->setText(tr("File Saved"));
+                        context->athlete->addRide(QFileInfo(fulltarget).fileName(), true);
+                    }
                 }
             }
 
+            // clear
+            RideFileOpenQueue::free(item);
+
         } else {
             // for native file formats the filename IS the ride date time so
             // no need to write -- we just copy
@@ -881,7 +913,7 @@ RideImportWizard::abortClicked()
             }
         }
         QApplication::processEvents();
-        if (aborted) { done(0); }
+        if (aborted) { done(0); return; }
         progressBar->setValue(progressBar->value()+1);
         this->repaint();
     }
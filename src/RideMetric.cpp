@@ -20,9 +20,142 @@
 #include "Zones.h"
 #include "HrZones.h"
 
+#include <QCoreApplication>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+
 RideMetricFactory *RideMetricFactory::_instance;
 QVector<QString> RideMetricFactory::noDeps;
 
+// the levels are built once all the metrics have been added,
+// a metric's level is one more than its deepest dependency
+void
+RideMetricFactory::buildLevels()
+{
+    checkDependencies();
+
+    dependencyIds.resize(metricNames.count());
+    for (int id=0; id<metricNames.count(); id++) {
+        dependencyIds[id].clear();
+        foreach(const QString &dependency, dependencies(metricNames[id]))
+            dependencyIds[id] << metricIds.value(dependency);
+    }
+
+    QVector<int> level(metricNames.count(), -1);
+    levels.clear();
+    for (int id=0; id<metricNames.count(); id++) {
+        int l = levelOf(id, level);
+        if (levels.count() <= l) levels.resize(l+1);
+        levels[l] << id;
+    }
+}
+
+int
+RideMetricFactory::levelOf(int id, QVector<int> &level) const
+{
+    if (level[id] >= 0) return level[id];
+    level[id] = metricNames.count(); // visiting, a cycle trips the assert below
+
+    int l = 0;
+    foreach(int dependency, dependencyIds[id]) {
+        assert(level[dependency] != metricNames.count());
+        l = qMax(l, levelOf(dependency, level) + 1);
+    }
+    return level[id] = l;
+}
+
+// The metrics within a level are computed on the global thread pool,
+// the calling thread takes them off the list too so it still makes
+// progress if the pool is busy, see MeanMaxTasks in RideFileCache.cpp
+class MetricTasks
+{
+    public:
+        MetricTasks(const RideFile *ride, const Zones *zones, int zoneRange,
+                    const HrZones *hrZones, int hrZoneRange,
+                    const QHash<QString,RideMetric*> &deps, const Context *context) :
+            ride(ride), zones(zones), zoneRange(zoneRange), hrZones(hrZones), hrZoneRange(hrZoneRange),
+            deps(deps), context(context), refs(1), next(0), done(0) {}
+
+        void add(RideMetric *metric) { metrics << metric; }
+        void start();
+        void wait();
+
+    private:
+        friend class MetricWorker;
+
+        bool runOne();
+        void deref() { if (!refs.deref()) delete this; }
+
+        const RideFile *ride;
+        const Zones *zones;
+        int zoneRange;
+        const HrZones *hrZones;
+        int hrZoneRange;
+        const QHash<QString,RideMetric*> &deps;
+        const Context *context;
+
+        QList<RideMetric*> metrics;
+        QAtomicInt refs, next;
+
+        QMutex lock;
+        QWaitCondition finished;
+        int done;
+};
+
+class MetricWorker : public QRunnable
+{
+    public:
+        MetricWorker(MetricTasks *tasks) : tasks(tasks) {}
+        void run() {
+            while (tasks->runOne()) ;
+            tasks->deref();
+        }
+
+    private:
+        MetricTasks *tasks;
+};
+
+bool
+MetricTasks::runOne()
+{
+    int index = next.fetchAndAddOrdered(1);
+    if (index >= metrics.count()) return false;
+
+    metrics[index]->compute(ride, zones, zoneRange, hrZones, hrZoneRange, deps, context);
+
+    QMutexLocker locker(&lock);
+    if (++done == metrics.count()) finished.wakeAll();
+    return true;
+}
+
+void
+MetricTasks::start()
+{
+    QThreadPool *pool = QThreadPool::globalInstance();
+    int workers = qMin(metrics.count() - 1, pool->maxThreadCount());
+
+    for (int i=0; i<workers; i++) {
+        refs.ref(); // dropped by the worker when it is done
+        pool->start(new MetricWorker(this));
+    }
+}
+
+void
+MetricTasks::wait()
+{
+    while (runOne()) ;
+
+    lock.lock();
+    while (done < metrics.count()) finished.wait(&lock);
+    lock.unlock();
+
+    deref();
+}
+
 QHash<QString,RideMetricPtr>
 RideMetric::computeMetrics(const Context *context, const RideFile *ride, const Zones *zones, const HrZones *hrZones,
                            const QStringList &metrics)
@@ -31,39 +164,67 @@ RideMetric::computeMetrics(const Context *context, const RideFile *ride, const Z
     int hrZoneRange = hrZones->whichRange(ride->startTime().date());
 
     const RideMetricFactory &factory = RideMetricFactory::instance();
-    QStringList todo = metrics;
-    QHash<QString,RideMetric*> done;
+
+    // the metrics asked for and all they depend upon
+    QVector<bool> wanted(factory.metricCount(), false);
+    QVector<bool> needed(factory.metricCount(), false);
+    QVector<int> todo;
+    foreach (QString symbol, metrics) {
+        int id = factory.metricId(symbol);
+        if (id < 0 || wanted[id]) continue;
+        wanted[id] = needed[id] = true;
+        todo << id;
+    }
     while (!todo.isEmpty()) {
-        QString symbol = todo.takeFirst();
-        if (!factory.haveMetric(symbol)) continue;
-        const QVector<QString> &deps = factory.dependencies(symbol);
-        bool ready = true;
-        foreach (QString dep, deps) {
-            if (!done.contains(dep)) {
-                ready = false;
-                if (!todo.contains(dep))
-                    todo.append(dep);
-            }
+        int id = todo.last();
+        todo.pop_back();
+        foreach (int dependency, factory.dependencies(id)) {
+            if (needed[dependency]) continue;
+            needed[dependency] = true;
+            todo << dependency;
         }
-        if (ready) {
-            RideMetric *m = factory.newMetric(symbol);
-            //if (!ride->dataPoints().isEmpty())
+    }
+
+    // the weight reads the metric db if it isn't known yet, which
+    // must be on the gui thread, so the metrics can only be run on
+    // the pool if it is or the caller has already got the weight
+    bool parallel = ride->isWeightKnown();
+    if (!parallel && ride->context && QThread::currentThread() == QCoreApplication::instance()->thread()) {
+        const_cast<RideFile*>(ride)->getWeight();
+        parallel = true;
+    }
+
+    QHash<QString,RideMetric*> done;
+    foreach (const QVector<int> &level, factory.metricLevels()) {
+
+        // each level only needs the ones before it
+        QList<RideMetric*> computing;
+        foreach (int id, level)
+            if (needed[id]) computing << factory.newMetric(id);
+
+        if (parallel && computing.count() > 1) {
+            MetricTasks *tasks = new MetricTasks(ride, zones, zoneRange, hrZones, hrZoneRange, done, context);
+            foreach (RideMetric *m, computing) tasks->add(m);
+            tasks->start();
+            tasks->wait();
+        } else {
+            foreach (RideMetric *m, computing)
                 m->compute(ride, zones, zoneRange, hrZones, hrZoneRange, done, context);
-            if (ride->metricOverrides.contains(symbol))
-                m->override(ride->metricOverrides.value(symbol));
-            done.insert(symbol, m);
         }
-        else {
-            if (!todo.contains(symbol))
-                todo.append(symbol);
+
+        foreach (RideMetric *m, computing) {
+            if (ride->metricOverrides.contains(m->symbol()))
+                m->override(ride->metricOverrides.value(m->symbol()));
+            done.insert(m->symbol(), m);
         }
     }
+
+    // the dependencies that weren't asked for are thrown away
     QHash<QString,RideMetricPtr> result;
     foreach (QString symbol, metrics) {
-        result.insert(symbol, QSharedPointer<RideMetric>(done.value(symbol)));
-        done.remove(symbol);
+        if (result.contains(symbol)) continue;
+        result.insert(symbol, QSharedPointer<RideMetric>(done.take(symbol)));
     }
-    foreach (QString symbol, done.keys())
-        delete done.value(symbol);
+    qDeleteAll(done);
     return result;
 }
@@ -174,10 +174,19 @@ class RideMetricFactory {
 
     QVector<QString> metricNames;
     QVector<RideMetric::MetricType> metricTypes;
+    QHash<QString,int> metricIds;
     QHash<QString,RideMetric*> metrics;
     QHash<QString,QVector<QString>*> dependencyMap;
     bool dependenciesChecked;
 
+    // the metrics by id in dependency order; each level only depends
+    // upon the levels before it, so the metrics within a level can be
+    // computed in any order or all at once. Built by initialize().
+    QVector<QVector<int> > levels;
+    QVector<QVector<int> > dependencyIds;
+    void buildLevels();
+    int levelOf(int id, QVector<int> &level) const;
+
     RideMetricFactory() : dependenciesChecked(false) {}
     RideMetricFactory(const RideMetricFactory &other);
     RideMetricFactory &operator=(const RideMetricFactory &other);
@@ -204,9 +213,13 @@ class RideMetricFactory {
     void initialize() {
         foreach(const QString &metricName, metrics.keys())
             metrics[metricName]->initialize();
+        buildLevels();
     }
 
     const QString &metricName(int i) const { return metricNames[i]; }
+
+    // the index of a metric, for array storage (e.g. SummaryMetrics), -1 if unknown
+    int metricId(const QString &symbol) const { return metricIds.value(symbol, -1); }
     const RideMetric::MetricType &metricType(int i) const { return metricTypes[i]; }
     const RideMetric *rideMetric(QString name) const { return metrics.value(name, NULL); }
 
@@ -224,6 +237,7 @@ class RideMetricFactory {
                    const QVector<QString> *deps = NULL) {
         assert(!metrics.contains(metric.symbol()));
         metrics.insert(metric.symbol(), metric.clone());
+        metricIds.insert(metric.symbol(), metricNames.size());
         metricNames.append(metric.symbol());
         metricTypes.append(metric.type());
         if (deps) {
@@ -241,6 +255,11 @@ class RideMetricFactory {
         QVector<QString> *result = dependencyMap.value(symbol);
         return result ? *result : noDeps;
     }
+
+    // as above, by metric id
+    const QVector<QVector<int> > &metricLevels() const { return levels; }
+    const QVector<int> &dependencies(int id) const { return dependencyIds[id]; }
+    RideMetric *newMetric(int id) const { return metrics.value(metricNames[id])->clone(); }
 };
 
 #endif // _GC_RideMetric_h
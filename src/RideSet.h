@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2026 GoldenCheetah Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _GC_RideSet_h
+#define _GC_RideSet_h 1
+
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+// A set of ride filenames, as returned by a search or filter.
+//
+// The charts check every ride they plot against the filter, so
+// contains() needs to be quick; it is a hash lookup rather than
+// scanning a list. The files are also kept in the order they were
+// given for anything that needs them as a list.
+class RideSet
+{
+    public:
+        RideSet() {}
+        RideSet(const QStringList &files) : list(files), set(files.toSet()) {}
+
+        bool contains(const QString &fileName) const { return set.contains(fileName); }
+        int count() const { return list.count(); }
+        bool isEmpty() const { return list.isEmpty(); }
+        void clear() { list.clear(); set.clear(); }
+
+        const QStringList &files() const { return list; }
+
+    private:
+        QStringList list;
+        QSet<QString> set;
+};
+
+#endif // _GC_RideSet_h
@@ -27,6 +27,7 @@
 #include "Units.h"
 #include "Zones.h"
 #include "MetricAggregator.h"
+#include "IntervalMetricsCache.h"
 #include "DBAccess.h"
 #include <QtGui>
 #include <QtXml/QtXml>
@@ -94,6 +95,11 @@ RideSummaryWindow::RideSummaryWindow(Context *context, bool ridesummary) :
         connect(context, SIGNAL(rideDeleted(RideItem*)), this, SLOT(refresh()));
         connect(context, SIGNAL(filterChanged()), this, SLOT(refresh()));
 
+        // the rides for the date range are fetched in the background
+        queryId = 0;
+        connect(context->athlete->metricDB->query(), SIGNAL(results(int, QList<SummaryMetrics>, QList<SummaryMetrics>)),
+                this, SLOT(queryResults(int, QList<SummaryMetrics>, QList<SummaryMetrics>)));
+
         // date settings
         connect(dateSetting, SIGNAL(useCustomRange(DateRange)), this, SLOT(useCustomRange(DateRange)));
         connect(dateSetting, SIGNAL(useThruToday()), this, SLOT(useThruToday()));
@@ -115,7 +121,7 @@ RideSummaryWindow::clearFilter()
 void
 RideSummaryWindow::setFilter(QStringList list)
 {
-    filters = list;
+    filters = RideSet(list);
     filtered = true;
     refresh();
 }
@@ -452,7 +458,7 @@ RideSummaryWindow::htmlSummary() const
     if (ridesummary) {
 
         //
-        // Interval Summary (recalculated on every refresh since they are not cached at present)
+        // Interval Summary (cached, see IntervalMetricsCache)
         //
         if (ride->intervals().size() > 0) {
             bool firstRow = true;
@@ -467,23 +473,13 @@ RideSummaryWindow::htmlSummary() const
             summary += "cellspacing=0 border=0>";
             bool even = false;
             foreach (RideFileInterval interval, ride->intervals()) {
-                RideFile f(ride->startTime(), ride->recIntSecs());
-                f.context = context; // hack, until we refactor athlete and mainwindow
-                for (int i = ride->intervalBegin(interval); i>= 0 &&i < ride->dataPoints().size(); ++i) {
-                    const RideFilePoint *p = ride->dataPoints()[i];
-                    if (p->secs >= interval.stop)
-                        break;
-                    f.appendPoint(p->secs, p->cad, p->hr, p->km, p->kph, p->nm,
-                                p->watts, p->alt, p->lon, p->lat, p->headwind,
-                                p->slope, p->temp, p->lrbalance, 0);
-                }
-                if (f.dataPoints().size() == 0) {
-                    // Interval empty, do not compute any metrics
-                    continue;
-                }
 
                 QHash<QString,RideMetricPtr> metrics =
-                    RideMetric::computeMetrics(context, &f, context->athlete->zones(), context->athlete->hrZones(), intervalMetrics);
+                    context->athlete->intervalCache->metrics(rideItem, interval.start, interval.stop, intervalMetrics);
+                if (metrics.isEmpty()) {
+                    // Interval empty, no metrics
+                    continue;
+                }
                 if (firstRow) {
                     summary += "<tr>";
                     summary += "<td align=\"center\" valign=\"bottom\">Interval Name</td>";
@@ -704,16 +700,25 @@ void RideSummaryWindow::dateRangeChanged(DateRange dr)
     if (dr.from == current.from && dr.to == current.to) return;
     else current = dr;
 
+    DateRange use = myDateRange;
     if (useCustom) {
-        data = context->athlete->metricDB->getAllMetricsFor(custom);
+        use = custom;
     } else if (useToToday) {
-
-        DateRange use = myDateRange;
         QDate today = QDate::currentDate();
         if (use.to > today) use.to = today;
-        data = context->athlete->metricDB->getAllMetricsFor(use);
+    }
+
+    // refreshed when the data arrives
+    queryId = context->athlete->metricDB->query()->getAllMetricsFor(this, QDateTime(use.from, QTime(0,0,0)),
+                                                                     QDateTime(use.to, QTime(23,59,59)));
+}
 
-    } else data = context->athlete->metricDB->getAllMetricsFor(myDateRange);
+void
+RideSummaryWindow::queryResults(int id, QList<SummaryMetrics> metrics, QList<SummaryMetrics>)
+{
+    // not ours, or we've asked for another date range since
+    if (id != queryId) return;
 
+    data = metrics;
     refresh();
 }
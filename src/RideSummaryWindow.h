@@ -82,6 +82,7 @@ class RideSummaryWindow : public GcChartWindow
         void refresh();
         void rideSelected();
         void dateRangeChanged(DateRange);
+        void queryResults(int id, QList<SummaryMetrics> metrics, QList<SummaryMetrics>);
         void rideItemChanged();
         void metadataChanged();
 
@@ -107,6 +108,7 @@ class RideSummaryWindow : public GcChartWindow
 
         QList<SummaryMetrics> data; // when in date range mode
         DateRange current;
+        int queryId; // the data we are waiting for
 
         DateSettingsEdit *dateSetting;
         bool useCustom;
@@ -115,7 +117,7 @@ class RideSummaryWindow : public GcChartWindow
 #ifdef GC_HAVE_LUCENE
         SearchFilterBox *searchBox;
 #endif
-        QStringList filters; // empty when no lucene
+        RideSet filters; // empty when no lucene
         bool filtered; // are we using a filter?
 };
 
@@ -35,6 +35,7 @@ GSettings::value(const QObject * /*me*/, const QString key, const QVariant def)
     //qDebug()<<p->property("instanceName").toString();
     //}
 
+        QMutexLocker locker(&lock);
         return QSettings::value(key, def);
 }
 
@@ -183,11 +183,16 @@
 #define TRAIN_MULTI               "train/multi"
 
 #include <QSettings>
+#include <QMutex>
 #include <QFileInfo>
 
 // wrap the standard QSettings so we can offer members
 // to get global or cyclist specific settings
 // via value() and cvalue()
+//
+// The ride readers and data processors read settings on the metric
+// refresh and ride import threads too, and a QSettings can't be shared
+// between threads, so access to it is locked.
 class GSettings : public QSettings
 {
     public:
@@ -198,17 +203,22 @@ class GSettings : public QSettings
     // standard access to global config
     QVariant value(const QObject *me, const QString key, const QVariant def = 0) const ;
     void setValue(QString key, QVariant value) {
+        QMutexLocker locker(&lock);
         QSettings::setValue(key,value);
     }
 
     // access to cyclist specific config
     QVariant cvalue(QString cyclist, QString key, QVariant def = 0) {
+        QMutexLocker locker(&lock);
         return QSettings::value(cyclist+"/"+key, def);
     }
     void setCValue(QString cyclist, QString key, QVariant value) {
+        QMutexLocker locker(&lock);
         QSettings::setValue(cyclist + "/" + key,value);
     }
 
+    private:
+    mutable QMutex lock;
 };
 
 extern GSettings *appsettings;
@@ -254,6 +254,9 @@ RideFile *SrmFileReader::openRideFile(QFile &file, QStringList &errorStrings, QL
     if (markercnt > 0)
         mrknum = 1;
 
+    // we know how many samples there are
+    result->reservePoints(datacnt);
+
     for (int i = 0; i < datacnt; ++i) {
         int cad, hr, watts;
         double kph, alt;
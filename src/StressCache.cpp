@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2026 GoldenCheetah Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "StressCache.h"
+#include "Context.h"
+#include "Athlete.h"
+#include "MetricAggregator.h"
+#include "DBAccess.h"
+#include "Season.h"
+
+#include <QFile>
+#include <QDataStream>
+#include <math.h>
+
+StressCache::StressCache(Context *context) : context(context), loaded(false)
+{
+}
+
+//
+// SERIES
+//
+bool
+StressCache::series(QString metric, int shortTermDays, int longTermDays, QDate end, StressSeries &into)
+{
+    QMutexLocker locker(&lock);
+    load();
+
+    QString fileName = QString("%1/%2-%3-%4.stress").arg(context->athlete->home.absolutePath())
+                                                     .arg(metric).arg(shortTermDays).arg(longTermDays);
+
+    // start again if the season seeds have been changed
+    QMap<QDate, int> now = seeds();
+    if (entries.contains(fileName) && entries.value(fileName).seeds != now) entries.remove(fileName);
+
+    if (!entries.contains(fileName)) {
+
+        // from the first ride, or seed if earlier
+        const MetricStore &store = context->athlete->metricDB->metricStore();
+        if (store.count() == 0) return false;
+
+        Entry add;
+        add.fileName = fileName;
+        add.seeds = now;
+        add.series.origin = store.rideDates().first().date();
+        if (!now.isEmpty() && now.constBegin().key() < add.series.origin)
+            add.series.origin = now.constBegin().key();
+
+        entries.insert(fileName, add);
+    }
+
+    Entry &entry = entries[fileName];
+    int days = entry.series.lts.count();
+    extend(entry, metric, shortTermDays, longTermDays, end);
+    if (entry.series.lts.count() != days) writeEntry(entry);
+
+    into = entry.series;
+    return true;
+}
+
+void
+StressCache::extend(Entry &entry, QString metric, int shortTermDays, int longTermDays, QDate end)
+{
+    StressSeries &series = entry.series;
+
+    int from = series.lts.count();
+    int to = series.origin.daysTo(end) + 1;
+    if (to <= from) return;
+
+    series.scores.resize(to);
+    series.lts.resize(to);
+    series.sts.resize(to);
+    for (int d=from; d<to; d++) series.scores[d] = 0;
+
+    // the daily scores, two rides on the same day are added together
+    const MetricStore &store = context->athlete->metricDB->metricStore();
+    const QVector<double> *scores = store.column(metric);
+    if (scores) {
+        int first, last;
+        store.range(series.origin.addDays(from), end, first, last);
+        for (int i=first; i<last; i++)
+            series.scores[series.origin.daysTo(store.rideDates().at(i).date())] += scores->at(i);
+    }
+
+    // stress = today's score * (1 - exp(-1/days)) + yesterday's stress * exp(-1/days)
+    // see StressCalculator::calculate()
+    double lte = (double)exp(-1.0/longTermDays);
+    double ste = (double)exp(-1.0/shortTermDays);
+
+    for (int d=from; d<to; d++) {
+
+        // if its seeded leave it alone
+        int seed = entry.seeds.value(series.origin.addDays(d), 0);
+        if (seed > 0) {
+            series.lts[d] = series.sts[d] = seed;
+            continue;
+        }
+
+        double lastLTS = d ? series.lts[d-1] : 0;
+        double lastSTS = d ? series.sts[d-1] : 0;
+        series.lts[d] = (series.scores[d] * (1.0 - lte)) + (lastLTS * lte);
+        series.sts[d] = (series.scores[d] * (1.0 - ste)) + (lastSTS * ste);
+    }
+}
+
+QMap<QDate, int>
+StressCache::seeds() const
+{
+    QMap<QDate, int> returning;
+    foreach(Season x, context->athlete->seasons->seasons)
+        if (x.getSeed()) returning.insert(x.getStart(), x.getSeed());
+    return returning;
+}
+
+//
+// INVALIDATION
+//
+void
+StressCache::rideChanged(QDate date)
+{
+    if (!date.isValid()) return;
+
+    QMutexLocker locker(&lock);
+    load();
+
+    QMutableMapIterator<QString, Entry> i(entries);
+    while (i.hasNext()) {
+        i.next();
+        Entry &entry = i.value();
+
+        int days = entry.series.origin.daysTo(date);
+        if (days <= 0) {
+
+            // before it starts, so the origin might have moved
+            QFile::remove(entry.fileName);
+            i.remove();
+
+        } else if (days < entry.series.lts.count()) {
+
+            entry.series.scores.resize(days);
+            entry.series.lts.resize(days);
+            entry.series.sts.resize(days);
+            writeEntry(entry);
+        }
+    }
+}
+
+void
+StressCache::clear()
+{
+    QMutexLocker locker(&lock);
+    load();
+
+    foreach(const Entry &entry, entries) QFile::remove(entry.fileName);
+    entries.clear();
+}
+
+//
+// PERSISTANCE
+//
+void
+StressCache::load()
+{
+    if (loaded) return;
+    loaded = true;
+
+    QStringList filters;
+    filters << "*.stress";
+    foreach(QString name, context->athlete->home.entryList(filters, QDir::Files)) {
+
+        Entry entry;
+        QString fileName = context->athlete->home.absolutePath() + "/" + name;
+        if (readEntry(fileName, entry)) entries.insert(fileName, entry);
+        else QFile::remove(fileName);
+    }
+}
+
+bool
+StressCache::readEntry(QString fileName, Entry &entry)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_4_6);
+
+    quint32 version;
+    in >> version;
+    if (in.status() != QDataStream::Ok || version != StressCacheVersion) return false;
+
+    entry.fileName = fileName;
+    in >> entry.seeds >> entry.series.origin >> entry.series.scores >> entry.series.lts >> entry.series.sts;
+
+    return in.status() == QDataStream::Ok && entry.series.origin.isValid() &&
+           entry.series.scores.count() == entry.series.lts.count() &&
+           entry.series.sts.count() == entry.series.lts.count();
+}
+
+void
+StressCache::writeEntry(Entry &entry)
+{
+    QFile file(entry.fileName);
+    if (!file.open(QIODevice::WriteOnly)) return;
+    file.resize(0);
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_6);
+
+    out << (quint32) StressCacheVersion;
+    out << entry.seeds << entry.series.origin << entry.series.scores << entry.series.lts << entry.series.sts;
+
+    file.close();
+
+    // don't leave a partial series behind
+    if (out.status() != QDataStream::Ok) file.remove();
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2026 GoldenCheetah Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _GC_StressCache_h
+#define _GC_StressCache_h 1
+#include "GoldenCheetah.h"
+
+#include <QDate>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+class Context;
+
+// The StressCache holds the daily score, LTS and STS for each score
+// type (BikeScore, TSS, TRIMP et al) and short/long term constants the
+// PMC has been plotted with, from the first ride (or season seed) up to
+// the last day plotted, so the StressCalculator doesn't have to
+// recompute the whole history for every redraw.
+//
+// Since each day only depends on the days before it, when a ride is
+// added, changed or deleted only the days from its date onwards are
+// discarded; they are recomputed from the metric store when next asked
+// for. The series are kept in the athlete's home directory as .stress
+// files e.g. coggan_tss-7-42.stress. It is only used when the rides
+// are not filtered.
+static const unsigned int StressCacheVersion = 1;
+// revision history:
+// version  date         description
+// 1        16-Oct-26    Initial - daily score, lts and sts
+
+struct StressSeries
+{
+    QDate origin;   // the first day
+    QVector<double> scores, lts, sts; // a value for each day from origin
+};
+
+class StressCache
+{
+    public:
+        StressCache(Context *context);
+
+        // the series for this metric, computed up to at least end
+        // returns false if there are no rides
+        bool series(QString metric, int shortTermDays, int longTermDays, QDate end, StressSeries &into);
+
+        // a ride on this date has been added, changed or deleted
+        void rideChanged(QDate date);
+
+        // everything is stale e.g. the metrics have been rebuilt
+        void clear();
+
+    private:
+
+        struct Entry {
+            QString fileName;
+            QMap<QDate, int> seeds; // season seeds it was computed with
+            StressSeries series;
+        };
+
+        void load();
+        bool readEntry(QString fileName, Entry &entry);
+        void writeEntry(Entry &entry);
+        void extend(Entry &entry, QString metric, int shortTermDays, int longTermDays, QDate end);
+        QMap<QDate, int> seeds() const;
+
+        Context *context;
+        bool loaded;
+        QMap<QString, Entry> entries; // by file name
+
+        // we are updated from the metric refresh as rides are imported
+        QMutex lock;
+};
+#endif // _GC_StressCache_h
@@ -5,6 +5,7 @@
 #include "RideMetric.h"
 #include "RideItem.h"
 #include "Context.h"
+#include "StressCache.h"
 
 #include <stdio.h>
 
@@ -64,8 +65,48 @@ double StressCalculator::min(void) {
 
 
 
-void StressCalculator::calculateStress(Context *context, QString, const QString &metric, bool isfilter, QStringList filter)
+void StressCalculator::calculateStress(Context *context, QString, const QString &metric, bool isfilter, const RideSet &filter)
 {
+    // when not filtered we just take a slice of the athlete's daily stress
+    if (!isfilter && !context->isfiltered) {
+        StressSeries series;
+        if (!context->athlete->stressCache->series(metric, shortTermDays, longTermDays, endDate.date(), series))
+            return; // no ride files found
+
+        int maxarray = startDate.daysTo(endDate) +2; // from zero plus tomorrows SB!
+        stsvalues.fill(0, maxarray);
+        ltsvalues.fill(0, maxarray);
+        sbvalues.fill(0, maxarray);
+        xdays.fill(0, maxarray);
+        list.fill(0, maxarray);
+        ltsramp.fill(0, maxarray);
+        stsramp.fill(0, maxarray);
+
+        int offset = series.origin.daysTo(startDate.date());
+        for (int i=0; i<maxarray; i++) {
+
+            xdays[i] = i+1;
+
+            int d = offset + i;
+            if (d >= 0 && d < series.lts.count()) {
+                list[i] = series.scores[d];
+                ltsvalues[i] = series.lts[d];
+                stsvalues[i] = series.sts[d];
+                if (d > 0) {
+                    ltsramp[i] = series.lts[d] - series.lts[d-1];
+                    stsramp[i] = series.sts[d] - series.sts[d-1];
+                }
+            }
+
+            // SB (stress balance) is for the day before unless showing today
+            int sb = showSBToday ? d : d-1;
+            if (sb >= 0 && sb < series.lts.count()) sbvalues[i] = series.lts[sb] - series.sts[sb];
+        }
+
+        days = startDate.daysTo(endDate) + 1; // include today
+        return;
+    }
+
     // get all metric data from the year 1900 - 3000
     QList<SummaryMetrics> results;
 
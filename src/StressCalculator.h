@@ -16,6 +16,7 @@
 #include <QDateTime>
 #include <QTreeWidgetItem>
 #include "Settings.h"
+#include "RideSet.h"
 #include "MetricAggregator.h"
 
 class StressCalculator:public QObject {
@@ -53,7 +54,7 @@ class StressCalculator:public QObject {
 
 	StressCalculator(QString cyclist, QDateTime startDate, QDateTime endDate, int shortTermDays, int longTermDays);
 
-	void calculateStress(Context *, QString, const QString &metric, bool filter = false, QStringList files = QStringList());
+	void calculateStress(Context *, QString, const QString &metric, bool filter = false, const RideSet &files = RideSet());
 
 	// x axes:
 	double *getSTSvalues() { return stsvalues.data(); }
@@ -57,13 +57,29 @@ const RideMetric *metricForSymbol(QString symbol)
     return factory.rideMetric(symbol);
 }
 
+int
+SummaryMetrics::metricCount()
+{
+    return RideMetricFactory::instance().metricCount();
+}
+
+void
+SummaryMetrics::setForSymbol(QString symbol, double v)
+{
+    int id = RideMetricFactory::instance().metricId(symbol);
+    if (id >= 0) setForMetric(id, v);
+    else value.insert(symbol, v);
+}
+
 double
 SummaryMetrics::getForSymbol(QString symbol, bool metric) const
 {
-    if (metric) return value.value(symbol, 0.0);
+    int id = RideMetricFactory::instance().metricId(symbol);
+    double metricValue = id >= 0 ? getForMetric(id) : value.value(symbol, 0.0);
+
+    if (metric) return metricValue;
     else {
         const RideMetric *m = metricForSymbol(symbol);
-        double metricValue = value.value(symbol, 0.0);
         metricValue *= m->conversion();
         metricValue += m->conversionSum();
         return metricValue;
@@ -114,7 +130,7 @@ SummaryMetrics::getUnitsForSymbol(QString symbol, bool UseMetric) const
     else return QString("units");
 }
 
-QString SummaryMetrics::getAggregated(Context *context, QString name, const QList<SummaryMetrics> &results, const QStringList &filters, 
+QString SummaryMetrics::getAggregated(Context *context, QString name, const QList<SummaryMetrics> &results, const RideSet &filters, 
                                       bool filtered, bool useMetricUnits, bool nofmt)
 {
     // get the metric details, so we can convert etc
@@ -125,16 +141,20 @@ QString SummaryMetrics::getAggregated(Context *context, QString name, const QLis
     double rvalue = 0;
     double rcount = 0; // using double to avoid rounding issues with int when dividing
 
+    // lookup the metrics once, not for every ride
+    int id = RideMetricFactory::instance().metricId(name);
+    int workoutTime = RideMetricFactory::instance().metricId("workout_time");
+
     // loop through and aggregate
-    foreach (SummaryMetrics rideMetrics, results) {
+    foreach (const SummaryMetrics &rideMetrics, results) {
 
         // skip filtered rides
         if (filtered && !filters.contains(rideMetrics.getFileName())) continue;
         if (context->isfiltered && !context->filters.contains(rideMetrics.getFileName())) continue;
 
         // get this value
-        double value = rideMetrics.getForSymbol(name);
-        double count = rideMetrics.getForSymbol("workout_time"); // for averaging
+        double value = rideMetrics.getForMetric(id);
+        double count = rideMetrics.getForMetric(workoutTime); // for averaging
 
         
         // check values are bounded, just in case
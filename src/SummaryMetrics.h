@@ -19,9 +19,11 @@
 #ifndef SUMMARYMETRICS_H_
 #define SUMMARYMETRICS_H_
 #include "GoldenCheetah.h"
+#include "RideSet.h"
 
 #include <QString>
 #include <QMap>
+#include <QVector>
 #include <QDateTime>
 #include <QApplication>
 class Context;
@@ -45,12 +47,20 @@ class SummaryMetrics
         QDateTime getDateTime() const { return rideDate; }
         void setDateTime(QDateTime dateTime) { this->rideDate = dateTime; }
 
-        // metric values
-        void setForSymbol(QString symbol, double v) { value.insert(symbol, v); }
+        // metric values, ride metrics are held in an array by their
+        // RideMetricFactory::metricId() and anything else in a map
+        void setForSymbol(QString symbol, double v);
         double getForSymbol(QString symbol, bool metric=true) const;
 
+        // fast access by id, for loops over many rides
+        void setForMetric(int id, double v) {
+            if (metricValues.size() <= id) metricValues.resize(metricCount());
+            metricValues[id] = v;
+        }
+        double getForMetric(int id) const { return id >= 0 && id < metricValues.size() ? metricValues[id] : 0.0; }
+
         void setText(QString name, QString v) { text.insert(name, v); }
-        QString getText(QString name, QString fallback) { return text.value(name, fallback); }
+        QString getText(QString name, QString fallback) const { return text.value(name, fallback); }
 
         // convert to string, using format supplied
         // replaces ${...:units} or ${...} with unit string
@@ -66,16 +76,20 @@ class SummaryMetrics
         // when passed a list of summary metrics and a name return aggregated value as a string
         static QString getAggregated(Context *context, QString name, 
                                      const QList<SummaryMetrics> &results,
-                                     const QStringList &filters, bool filtered,
+                                     const RideSet &filters, bool filtered,
                                      bool useMetricUnits, bool nofmt = false);
 
-        QMap<QString, double> &values() { return value; }
+        QVector<double> &metrics() { return metricValues; }
+        QMap<QString, double> &values() { return value; } // not ride metrics
         QMap<QString, QString> &texts() { return text; }
 
 	private:
+        static int metricCount();
+
 	    QString fileName;
         QString id;
         QDateTime rideDate;
+        QVector<double> metricValues;
         QMap<QString, double> value;
         QMap<QString, QString> text;
 };
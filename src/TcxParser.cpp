@@ -23,9 +23,6 @@
 #include "TcxParser.h"
 #include "TimeUtils.h"
 
-// use stc strtod to bypass Qt toDouble() issues
-#include <stdlib.h>
-
 TcxParser::TcxParser (RideFile* rideFile, QList<RideFile*> *rides) : rideFile(rideFile), rides(rides)
 {
     isGarminSmartRecording = appsettings->value(NULL, GC_GARMIN_SMARTRECORD,Qt::Checked);
@@ -38,11 +35,40 @@ TcxParser::TcxParser (RideFile* rideFile, QList<RideFile*> *rides) : rideFile(ri
 }
 
 bool
-TcxParser::startElement( const QString&, const QString&, const QString& qName, const QXmlAttributes& qAttributes)
+TcxParser::parse(QIODevice &device)
 {
-    buffer.clear();
+    XmlTokenizer xml(&device);
+    xml.addTag("Activity", Activity);
+    xml.addTag("Lap", Lap);
+    xml.addTag("Trackpoint", Trackpoint);
+    xml.addTag("Time", Time);
+    xml.addTag("DistanceMeters", DistanceMeters);
+    xml.addTag("Watts", Watts);
+    xml.addTag("ns3:Watts", Watts);
+    xml.addTag("Speed", Speed);
+    xml.addTag("ns3:Speed", Speed);
+    xml.addTag("Value", Value);
+    xml.addTag("Cadence", Cadence);
+    xml.addTag("AltitudeMeters", AltitudeMeters);
+    xml.addTag("LongitudeDegrees", LongitudeDegrees);
+    xml.addTag("LatitudeDegrees", LatitudeDegrees);
+
+    forever {
+        switch (xml.next()) {
+        case XmlTokenizer::StartElement: startElement(xml); break;
+        case XmlTokenizer::EndElement: endElement(xml); break;
+        case XmlTokenizer::EndDocument: return true;
+        case XmlTokenizer::Invalid: return false;
+        }
+    }
+}
 
-    if (qName == "Activity") {
+void
+TcxParser::startElement(const XmlTokenizer &xml)
+{
+    switch (xml.tag()) {
+
+    case Activity:
 
         lap = 0;
 
@@ -57,21 +83,23 @@ TcxParser::startElement( const QString&, const QString&, const QString& qName, c
 
         // if caller is looking for rides...
         if (rides) rides->append(rideFile);
+        break;
 
-    } else if (qName == "Lap") {
+    case Lap:
 
     // Use the time of the first lap as the time of the activity.
         if (lap == 0) {
 
-            start_time = convertToLocalTime(qAttributes.value("StartTime"));
+            start_time = convertToLocalTime(xml.attribute("StartTime"));
             rideFile->setStartTime(start_time);
 
             last_distance = 0.0;
             last_time = start_time;
         }
         lap++;
+        break;
 
-    } else if (qName == "Trackpoint") {
+    case Trackpoint:
 
         power = 0.0;
         cadence = 0.0;
@@ -85,39 +113,33 @@ TcxParser::startElement( const QString&, const QString&, const QString& qName, c
         //alt = 0.0; // TCX from FIT files have not alt point for each trackpoint
         distance = -1;  // nh - we set this to -1 so we can detect if there was a distance in the trackpoint.
         secs = 0;
+        break;
 
     }
-
-    return TRUE;
 }
 
-bool
-TcxParser::endElement( const QString&, const QString&, const QString& qName)
+void
+TcxParser::endElement(const XmlTokenizer &xml)
 {
-    if (qName == "Time") {
-        time = convertToLocalTime(buffer);
-        secs = start_time.secsTo(time);
+    switch (xml.tag()) {
 
-    } else if (qName == "DistanceMeters") { distance = buffer.toDouble() / 1000; }
-    else if (qName == "Watts" || qName == "ns3:Watts") { power = buffer.toDouble(); }
-    else if (qName == "Speed" || qName == "ns3:Speed") { speed = buffer.toDouble() * 3.6; }
-    else if (qName == "Value") { hr = buffer.toDouble(); }
-    else if (qName == "Cadence") { cadence = buffer.toDouble(); }
-    else if (qName == "AltitudeMeters") { alt = buffer.toDouble(); }
-    else if (qName == "LongitudeDegrees") {
+    case Time:
+        time = convertToLocalTime(xml.text());
+        secs = start_time.secsTo(time);
+        break;
 
-        char *p; 
-        setlocale(LC_NUMERIC,"C"); // strtod is locale dependent!
-        lon = strtod(buffer.toLatin1(), &p);
-        setlocale(LC_NUMERIC,"");
+    case DistanceMeters: distance = xml.number() / 1000; break;
+    case Watts: power = xml.number(); break;
+    case Speed: speed = xml.number() * 3.6; break;
+    case Value: hr = xml.number(); break;
+    case Cadence: cadence = xml.number(); break;
+    case AltitudeMeters: alt = xml.number(); break;
 
-    } else if (qName == "LatitudeDegrees") {
-        char *p;
-        setlocale(LC_NUMERIC,"C"); // strtod is locale dependent!
-        lat = strtod(buffer.toLatin1(), &p);
-        setlocale(LC_NUMERIC,"");
+    // the tokenizer's numbers don't depend on the locale
+    case LongitudeDegrees: lon = xml.number(); break;
+    case LatitudeDegrees: lat = xml.number(); break;
 
-    } else if (qName == "Trackpoint") {
+    case Trackpoint:
 
         // Some TCX files have Speed, some have Distance
         // Lets derive Speed from Distance or vice-versa
@@ -215,12 +237,6 @@ TcxParser::endElement( const QString&, const QString&, const QString& qName)
         }
         last_distance = distance;
         last_time = time;
+        break;
     }
-    return TRUE;
-}
-
-bool TcxParser::characters( const QString& str )
-{
-    buffer += str;
-    return TRUE;
 }
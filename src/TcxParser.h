@@ -24,26 +24,31 @@
 #include "RideFile.h"
 #include <QString>
 #include <QDateTime>
-#include <QXmlDefaultHandler>
+#include <QIODevice>
 #include "Settings.h"
+#include "XmlTokenizer.h"
 
-class TcxParser : public QXmlDefaultHandler
+class TcxParser
 {
 
 public:
 
     TcxParser(RideFile* rideFile, QList<RideFile*>*rides);
 
-    bool startElement( const QString&, const QString&, const QString&, const QXmlAttributes& );
-    bool endElement( const QString&, const QString&, const QString& );
-    bool characters( const QString& );
+    bool parse(QIODevice &device);
 
     RideFile*	rideFile;
     QList<RideFile*> *rides; // when parsed multiple rides
 
 private:
 
-    QString	buffer;
+    // the elements we look at
+    enum { Activity, Lap, Trackpoint, Time, DistanceMeters, Watts, Speed,
+           Value, Cadence, AltitudeMeters, LongitudeDegrees, LatitudeDegrees };
+
+    void startElement(const XmlTokenizer &xml);
+    void endElement(const XmlTokenizer &xml);
+
     QVariant isGarminSmartRecording;
     QVariant GarminHWM;
 
@@ -35,18 +35,20 @@ static int tcxFileReaderRegistered =
 
 RideFile *TcxFileReader::openRideFile(QFile &file, QStringList &errors, QList<RideFile*>*list) const
 {
-    (void) errors;
     RideFile *rideFile = new RideFile();
     rideFile->setRecIntSecs(1.0);
     rideFile->setDeviceType("Garmin");
     rideFile->setFileFormat("Garmin Training Centre (tcx)");
 
-    TcxParser handler(rideFile, list);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errors << "Could not open file.";
+        delete rideFile;
+        return NULL;
+    }
 
-    QXmlInputSource source (&file);
-    QXmlSimpleReader reader;
-    reader.setContentHandler (&handler);
-    reader.parse (source);
+    TcxParser handler(rideFile, list);
+    handler.parse(file);
+    file.close();
 
     return rideFile;
 }
@@ -28,6 +28,7 @@ struct TcxFileReader : public RideFileReader {
     QByteArray toByteArray(Context *context, const RideFile *ride, bool withAlt, bool withWatts, bool withHr, bool withCad) const;
     bool writeRideFile(Context *context, const RideFile *ride, QFile &file) const;
     bool hasWrite() const { return true; }
+    bool isReentrant() const { return true; }
 };
 
 #endif // _TcxRideFile_h
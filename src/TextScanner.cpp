@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2026 GoldenCheetah Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "TextScanner.h"
+
+#include <string.h>
+#include <ctype.h>
+
+TextScanner::TextScanner(QFile &file) :
+    file(file), mapped(NULL), merge(false), point('.'), fieldCount(0)
+{
+    // map the file so we scan it in place,
+    // if we can't map it then just read the whole thing in
+    qint64 size = file.size();
+    if (size) mapped = file.map(0, size);
+    if (mapped) {
+        data = reinterpret_cast<const char *>(mapped);
+    } else {
+        contents = file.readAll();
+        data = contents.constData();
+        size = contents.size();
+    }
+    dataEnd = data + size;
+
+    // skip a utf-8 byte order mark
+    if (size >= 3 && !memcmp(data, "\xEF\xBB\xBF", 3)) data += 3;
+    pos = lineBegin = lineEnd = data;
+
+    setSeparators(",");
+    fields.resize(64);
+}
+
+TextScanner::~TextScanner()
+{
+    if (mapped) file.unmap(mapped);
+}
+
+void
+TextScanner::setSeparators(const char *separators, bool merge)
+{
+    memset(separator, 0, sizeof(separator));
+    for (const char *p = separators; *p; p++) separator[(unsigned char)*p] = true;
+    this->merge = merge;
+    if (lineBegin != lineEnd) split();
+}
+
+bool
+TextScanner::nextLine()
+{
+    if (pos >= dataEnd) {
+        lineBegin = lineEnd = dataEnd;
+        fieldCount = 0;
+        return false;
+    }
+
+    // find the end of the line
+    const char *p = pos;
+    while (p < dataEnd && *p != '\n' && *p != '\r') p++;
+    lineBegin = pos;
+    lineEnd = p;
+
+    // and the start of the next
+    if (p < dataEnd && *p == '\r') p++;
+    if (p < dataEnd && *p == '\n' && (p == lineEnd || p[-1] == '\r')) p++;
+    pos = p;
+
+    split();
+    return true;
+}
+
+void
+TextScanner::rewind()
+{
+    pos = lineBegin = lineEnd = data;
+    fieldCount = 0;
+}
+
+void
+TextScanner::split()
+{
+    fieldCount = 0;
+    const char *p = lineBegin;
+
+    if (merge) while (p < lineEnd && separator[(unsigned char)*p]) p++;
+    if (p == lineEnd) return;
+
+    forever {
+        const char *begin = p;
+        while (p < lineEnd && !separator[(unsigned char)*p]) p++;
+
+        if (fields.size() < (fieldCount + 1) * 2) fields.resize(fields.size() * 2);
+        fields[fieldCount * 2] = begin;
+        fields[fieldCount * 2 + 1] = p;
+        fieldCount++;
+
+        if (p == lineEnd) break;
+        p++; // the separator
+        if (merge) {
+            while (p < lineEnd && separator[(unsigned char)*p]) p++;
+            if (p == lineEnd) break;
+        }
+    }
+}
+
+QString
+TextScanner::line() const
+{
+    return QString::fromLocal8Bit(lineBegin, lineEnd - lineBegin);
+}
+
+bool
+TextScanner::startsWith(const char *prefix) const
+{
+    int length = strlen(prefix);
+    return lineEnd - lineBegin >= length && !memcmp(lineBegin, prefix, length);
+}
+
+void
+TextScanner::unquote(const char *&begin, const char *&end) const
+{
+    while (begin < end && isspace((unsigned char)*begin)) begin++;
+    while (end > begin && isspace((unsigned char)end[-1])) end--;
+    if (end - begin >= 2 && *begin == '"' && end[-1] == '"') {
+        begin++;
+        end--;
+    }
+}
+
+QString
+TextScanner::text(int column) const
+{
+    if (column < 0 || column >= fieldCount) return QString();
+
+    const char *begin = fields[column * 2];
+    const char *end = fields[column * 2 + 1];
+    unquote(begin, end);
+    return QString::fromLocal8Bit(begin, end - begin);
+}
+
+double
+TextScanner::number(int column, double fallback) const
+{
+    if (column < 0 || column >= fieldCount) return fallback;
+
+    const char *begin = fields[column * 2];
+    const char *end = fields[column * 2 + 1];
+    unquote(begin, end);
+    return toDouble(begin, end, NULL, point);
+}
+
+int
+TextScanner::indexOf(const QString &text) const
+{
+    for (int i=0; i<fieldCount; i++)
+        if (this->text(i) == text) return i;
+    return -1;
+}
+
+//
+// NUMBERS
+//
+static const double powersOf10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+double
+TextScanner::toDouble(const char *begin, const char *end, bool *ok, char point)
+{
+    const char *p = begin;
+    while (p < end && isspace((unsigned char)*p)) p++;
+    while (end > p && isspace((unsigned char)end[-1])) end--;
+
+    if (ok) *ok = false;
+    if (p == end) return 0;
+
+    bool negative = false;
+    if (*p == '-' || *p == '+') negative = (*p++ == '-');
+
+    // up to 15 significant digits fit exactly in a double, and so
+    // do the powers of 10 up to 22, so mantissa * or / the power is
+    // correctly rounded. Anything else is left to Qt.
+    quint64 mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any = false;
+    for (; p < end && *p >= '0' && *p <= '9'; p++, any = true) {
+        if (mantissa || *p != '0') digits++;
+        mantissa = mantissa * 10 + (*p - '0');
+    }
+    if (p < end && *p == point) {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, any = true) {
+            if (mantissa || *p != '0') digits++;
+            mantissa = mantissa * 10 + (*p - '0');
+            exponent--;
+        }
+    }
+    if (any && p < end && (*p == 'e' || *p == 'E')) {
+        const char *e = p + 1;
+        bool negativeExponent = false;
+        if (e < end && (*e == '-' || *e == '+')) negativeExponent = (*e++ == '-');
+        int value = 0;
+        bool anyExponent = false;
+        for (; e < end && *e >= '0' && *e <= '9'; e++, anyExponent = true)
+            if (value < 10000) value = value * 10 + (*e - '0');
+        if (anyExponent) {
+            exponent += negativeExponent ? -value : value;
+            p = e;
+        }
+    }
+
+    if (!any || p != end || digits > 15 || exponent < -22 || exponent > 22) {
+        // not a plain number, or more than we can do exactly
+        QByteArray number(begin, end - begin);
+        if (point != '.') number.replace(point, '.');
+        bool parsed;
+        double value = number.toDouble(&parsed);
+        if (ok) *ok = parsed;
+        return parsed ? value : 0;
+    }
+
+    double value = (double)mantissa;
+    if (exponent < 0) value /= powersOf10[-exponent];
+    else value *= powersOf10[exponent];
+
+    if (ok) *ok = true;
+    return negative ? -value : value;
+}
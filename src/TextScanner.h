@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2026 GoldenCheetah Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _GC_TextScanner_h
+#define _GC_TextScanner_h
+#include "GoldenCheetah.h"
+
+#include <QFile>
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+// TextScanner reads delimited text ride files (CSV, TXT) a line at a
+// time without creating a QString for every line and every field.
+//
+// The whole file is mapped (or read in if it can't be) and each line is
+// split into field ranges in place. Numbers are parsed straight from the
+// bytes, so a sample costs no allocations at all. Readers look up the
+// columns they want once, from the headings line, and then ask for
+// them by index on each line.
+//
+// Lines may end with \n, \r\n or just \r (old Macintosh files). Fields are
+// not unquoted if they contain the separator, which none of the ride files
+// do, but double quotes around a field are ignored.
+class TextScanner
+{
+    public:
+        TextScanner(QFile &file); // must be open, and stay open while scanning
+        ~TextScanner();
+
+        // characters that separate fields, when merge is set a run of them
+        // is one separator and empty fields are skipped (e.g. spaces)
+        void setSeparators(const char *separators, bool merge = false);
+
+        // numbers use a decimal comma e.g. when separated by ';'
+        void setDecimalComma(bool comma) { point = comma ? ',' : '.'; }
+
+        // move to the next line, false at the end of the file
+        bool nextLine();
+        void rewind(); // back before the first line
+
+        // the current line
+        QString line() const;
+        bool isEmpty() const { return lineBegin == lineEnd; }
+        bool startsWith(const char *prefix) const;
+
+        // its fields, out of range columns are empty or the fallback
+        int count() const { return fieldCount; }
+        QString text(int column) const;
+        double number(int column, double fallback = 0.0) const;
+        int indexOf(const QString &text) const; // -1 if no field matches
+
+        // locale independent and without any temporaries, ok is set
+        // false if it isn't a number (and 0 is returned) like toDouble()
+        static double toDouble(const char *begin, const char *end, bool *ok = NULL, char point = '.');
+
+    private:
+
+        void split();
+        void unquote(const char *&begin, const char *&end) const;
+
+        QFile &file;
+        uchar *mapped;
+        QByteArray contents; // when it couldn't be mapped
+
+        const char *data, *dataEnd, *pos;
+        const char *lineBegin, *lineEnd;
+
+        bool separator[256];
+        bool merge;
+        char point;
+
+        QVector<const char *> fields; // begin and end of each field
+        int fieldCount;
+};
+#endif // _GC_TextScanner_h
@@ -141,6 +141,11 @@ TreeMapWindow::TreeMapWindow(Context *context) :
 
     connect(context, SIGNAL(configChanged()), this, SLOT(refresh()));
 
+    // the rides for the date range are fetched in the background
+    queryId = 0;
+    connect(context->athlete->metricDB->query(), SIGNAL(results(int, QList<SummaryMetrics>, QList<SummaryMetrics>)),
+            this, SLOT(queryResults(int, QList<SummaryMetrics>, QList<SummaryMetrics>)));
+
     // user clicked on a cell in the plot
     connect(ltmPlot, SIGNAL(clicked(QString,QString)), this, SLOT(cellClicked(QString,QString)));
 
@@ -228,16 +233,23 @@ TreeMapWindow::refresh()
         settings.field2 = field2->currentText();
         settings.data = &results;
 
-        // get the data
-        results.clear(); // clear any old data
-        results = context->athlete->metricDB->getAllMetricsFor(QDateTime(settings.from, QTime(0,0,0)),
-                                                   QDateTime(settings.to, QTime(0,0,0)));
-
-        refreshPlot();
+        // get the data, plotted when it arrives
+        queryId = context->athlete->metricDB->query()->getAllMetricsFor(this, QDateTime(settings.from, QTime(0,0,0)),
+                                                                         QDateTime(settings.to, QTime(0,0,0)));
     }
     repaint(); // get title repainted
 }
 
+void
+TreeMapWindow::queryResults(int id, QList<SummaryMetrics> metrics, QList<SummaryMetrics>)
+{
+    // not ours, or we've asked for another date range since
+    if (id != queryId) return;
+
+    results = metrics;
+    refreshPlot();
+}
+
 void
 TreeMapWindow::metricTreeWidgetSelectionChanged()
 {
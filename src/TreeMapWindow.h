@@ -120,6 +120,7 @@ class TreeMapWindow : public GcWindow
         void dateRangeChanged(DateRange);
         void metricTreeWidgetSelectionChanged();
         void refresh();
+        void queryResults(int id, QList<SummaryMetrics> metrics, QList<SummaryMetrics>);
         void fieldSelected(int);
         void cellClicked(QString, QString); // cell clicked
 
@@ -142,6 +143,7 @@ class TreeMapWindow : public GcWindow
         bool dirty;
         bool useCustom;
         bool useToToday;
+        int queryId; // the results we are waiting for
         DateRange custom; // custom date range supplied
         QList<KeywordDefinition> keywordDefinitions;
         QList<FieldDefinition>   fieldDefinitions;
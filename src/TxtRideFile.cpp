@@ -18,8 +18,8 @@
 
 #include "TxtRideFile.h"
 #include "Units.h"
+#include "TextScanner.h"
 #include <QRegExp>
-#include <QTextStream>
 #include <QVector>
 #include <QDebug>
 #include <algorithm> // for std::sort
@@ -56,7 +56,6 @@ RideFile *TxtFileReader::openRideFile(QFile &file, QStringList &errors, QList<Ri
                      // expect to see a section, or 'number of records = ' or
                      // column headings or raw data
 
-    QStringList headings; // the headings array
     int timeIndex = -1;
     int cadIndex = -1;
     int hrIndex = -1;
@@ -78,7 +77,7 @@ RideFile *TxtFileReader::openRideFile(QFile &file, QStringList &errors, QList<Ri
         errors << ("Could not open ride file: \"" + file.fileName() + "\"");
         return NULL;
     }
-    QTextStream in(&file);
+    TextScanner in(file);
 
     // Now we need to determine if this is a Wattbike export
     // or a Racermate export. We can do this by looking at
@@ -88,7 +87,10 @@ RideFile *TxtFileReader::openRideFile(QFile &file, QStringList &errors, QList<Ri
     // of multiple tokens, separated by a tab, which match
     // the pattern "name [units]"
     bool isWattBike = false;
-    QStringList tokens = in.readLine().split(QRegExp("[\t\n\r]"), QString::SkipEmptyParts);
+    in.setSeparators("\t", true);
+    in.nextLine();
+    QStringList tokens;
+    for (int i=0; i<in.count(); i++) tokens << in.text(i);
 
     if (tokens.count() > 1) {
         // ok, so we have a bunch of tokens, thats a good sign this
@@ -110,103 +112,91 @@ RideFile *TxtFileReader::openRideFile(QFile &file, QStringList &errors, QList<Ri
 
         // RACERMATE STYLE
 
-        file.close(); // start again (seek did weird things on Linux, bug (?)
-        if (!file.open(QFile::ReadOnly)) {
-            errors << ("Could not open ride file: \"" + file.fileName() + "\"");
-            return NULL;
-        }
-        QTextStream is(&file);
+        in.rewind(); // start again
+        in.setSeparators(" ,", true);
 
         // Lets construct our rideFile
         RideFile *rideFile = new RideFile();
         rideFile->setDeviceType("Computrainer/Velotron");
         rideFile->setFileFormat("Computrainer/Velotron text file (txt)");
 
-        while (!is.atEnd()) {
+        QRegExp sectionPattern("^\\[.*\\]$");
+        QRegExp unitsPattern("^UNITS += +\\(.*\\)$");
+        bool headings = false;
 
-            // the readLine() method doesn't handle old Macintosh CR line endings
-            // this workaround will load the the entire file if it has CR endings
-            // then split and loop through each line
-            // otherwise, there will be nothing to split and it will read each line as expected.
-            QString linesIn = is.readLine();
-            QStringList lines = linesIn.split('\r');
-            if(lines.isEmpty()) continue;
+        // the scanner copes with old Macintosh CR line endings
+        // and only the section and headings lines are looked at
+        // as text, samples are parsed from the fields in place
+        while (in.nextLine()) {
 
-            // loop through the lines we got
-            foreach (QString line, lines) {
+            // ignore blank lines
+            if (in.isEmpty()) continue;
 
-                QRegExp sectionPattern("^\\[.*\\]$");
-                QRegExp unitsPattern("^UNITS += +\\(.*\\)$");
-                QRegExp sepPattern("( +|,)");
+            // begin or end of section
+            if (in.startsWith("[") && sectionPattern.exactMatch(in.line())) {
+                deviceInfo += in.line();
+                deviceInfo += "\n";
 
-                // ignore blank lines
-                if (line == "") continue;
+                if (section == "") section = in.line();
+                else section = "";
+                continue;
+            }
 
-                // begin or end of section
-                if (sectionPattern.exactMatch(line)) {
-                    deviceInfo += line;
-                    deviceInfo += "\n";
+            // section Data
+            if (section != "") {
+                QString line = in.line();
 
-                    if (section == "") section = line;
-                    else section = "";
-                    continue;
-                }
+                // save it away
+                deviceInfo += line;
+                deviceInfo += "\n";
 
-                // section Data
-                if (section != "") {
-                    // save it away
-                    deviceInfo += line;
-                    deviceInfo += "\n";
-
-                    // look for UNITS line
-                    if (unitsPattern.exactMatch(line)) {
-                        if (unitsPattern.cap(1) != "METRIC") metric = false;
-                        else metric = true;
-                    }
-                    continue;
+                // look for UNITS line
+                if (unitsPattern.exactMatch(line)) {
+                    if (unitsPattern.cap(1) != "METRIC") metric = false;
+                    else metric = true;
                 }
+                continue;
+            }
 
-                // number of records, jsut ignore it
-                if (line.startsWith("number of")) continue;
-
-                // either a data line, or a headings line
-                if (headings.count() == 0) {
-                    headings = line.split(sepPattern, QString::SkipEmptyParts);
-
-                    // where are the values stored?
-                    timeIndex = headings.indexOf("ms");
-                    wattsIndex = headings.indexOf("watts");
-                    cadIndex = headings.indexOf("rpm");
-                    hrIndex = headings.indexOf("hr");
-                    kmIndex = headings.indexOf("KM");
-                    milesIndex = headings.indexOf("miles");
-                    kphIndex = headings.indexOf("speed");
-                    headwindIndex = headings.indexOf("wind");
-                    continue;
-                }
-                // right! we now have a record
-                QStringList values = line.split(sepPattern, QString::SkipEmptyParts);
-
-                // mmm... didn't get much data
-                if (values.count() < 2) continue;
-
-                // extract out each value.  Remove double quotes if they are there (Newer Racermate TXT files)
-                double secs = timeIndex > -1 ? values[timeIndex].remove("\"").toDouble() / (double) 1000 : 0.0;
-                double watts = wattsIndex > -1 ? values[wattsIndex].remove("\"").toDouble() : 0.0;
-                double cad = cadIndex > -1 ? values[cadIndex].remove("\"").toDouble() : 0.0;
-                double hr = hrIndex > -1 ? values[hrIndex].remove("\"").toDouble() : 0.0;
-                double km = kmIndex > -1 ? values[kmIndex].remove("\"").toDouble() : 0.0;
-                double kph = kphIndex > -1 ? values[kphIndex].remove("\"").toDouble() : 0.0;
-                double miles = milesIndex > -1 ? values[milesIndex].remove("\"").toDouble() : 0.0;
-                double headwind = headwindIndex > -1 ? values[headwindIndex].remove("\"").toDouble() : 0.0;
-                if (miles != 0) {
-                    // imperial!
-                    kph *= KM_PER_MILE;
-                    km = miles * KM_PER_MILE;
-                }
-                rideFile->appendPoint(secs, cad, hr, km, kph, 0.0, watts, 0.0, 0.0, 0.0, headwind, 0.0, RideFile::noTemp, 0.0, 0);
+            // number of records, jsut ignore it
+            if (in.startsWith("number of")) continue;
+
+            // either a data line, or a headings line
+            if (headings == false) {
+                if (in.count() == 0) continue;
+                headings = true;
+
+                // where are the values stored?
+                timeIndex = in.indexOf("ms");
+                wattsIndex = in.indexOf("watts");
+                cadIndex = in.indexOf("rpm");
+                hrIndex = in.indexOf("hr");
+                kmIndex = in.indexOf("KM");
+                milesIndex = in.indexOf("miles");
+                kphIndex = in.indexOf("speed");
+                headwindIndex = in.indexOf("wind");
+                continue;
+            }
 
+            // right! we now have a record
+            // mmm... didn't get much data
+            if (in.count() < 2) continue;
+
+            // extract out each value, double quotes are ignored if they are there (Newer Racermate TXT files)
+            double secs = timeIndex > -1 ? in.number(timeIndex) / (double) 1000 : 0.0;
+            double watts = in.number(wattsIndex);
+            double cad = in.number(cadIndex);
+            double hr = in.number(hrIndex);
+            double km = in.number(kmIndex);
+            double kph = in.number(kphIndex);
+            double miles = in.number(milesIndex);
+            double headwind = in.number(headwindIndex);
+            if (miles != 0) {
+                // imperial!
+                kph *= KM_PER_MILE;
+                km = miles * KM_PER_MILE;
             }
+            rideFile->appendPoint(secs, cad, hr, km, kph, 0.0, watts, 0.0, 0.0, 0.0, headwind, 0.0, RideFile::noTemp, 0.0, 0);
         }
         file.close();
 
@@ -349,13 +339,10 @@ RideFile *TxtFileReader::openRideFile(QFile &file, QStringList &errors, QList<Ri
         // lets loop through each row of data adding a sample
         // using the indexes we set above
         double rsecs = 0;
-        while (!in.atEnd()) {
-
-            QString line = in.readLine();
-            QStringList tokens = line.split(QRegExp("[\r\n\t]"), QString::SkipEmptyParts);
+        while (in.nextLine()) {
 
             // do we have as many columns as we expected?
-            if (tokens.count() == columns) {
+            if (in.count() == columns) {
 
                 double secs = 0.00f;
                 double km = 0.00f;
@@ -366,9 +353,6 @@ RideFile *TxtFileReader::openRideFile(QFile &file, QStringList &errors, QList<Ri
                 double watts = 0.00f;
 
                 if (timeIndex >= 0) {
-                    QTime time = QTime::fromString(tokens.at(timeIndex), "mm:ss:00");
-                    secs = QTime::fromString("00:00:00", "mm:ss:00").secsTo(time);
-
                     // its a bit shit, but the format appears to wrap round
                     // on the hour; 59:59:00 is followed by 00:00:00
                     // so we have a problem, since if there are gaps in
@@ -379,12 +363,12 @@ RideFile *TxtFileReader::openRideFile(QFile &file, QStringList &errors, QList<Ri
                     // for expediency, we use a counter for now:
                     secs = rsecs++;
                 }
-                if (kmIndex >= 0) km = tokens.at(kmIndex).toDouble() / 1000;
-                if (rpmIndex >= 0) rpm = tokens.at(rpmIndex).toDouble();
-                if (kphIndex >= 0) kph = tokens.at(kphIndex).toDouble();
-                if (bpmIndex >= 0) bpm = tokens.at(bpmIndex).toDouble();
-                if (torqIndex >= 0) torq = tokens.at(torqIndex).toDouble();
-                if (wattsIndex >= 0) watts = tokens.at(wattsIndex).toDouble();
+                if (kmIndex >= 0) km = in.number(kmIndex) / 1000;
+                if (rpmIndex >= 0) rpm = in.number(rpmIndex);
+                if (kphIndex >= 0) kph = in.number(kphIndex);
+                if (bpmIndex >= 0) bpm = in.number(bpmIndex);
+                if (torqIndex >= 0) torq = in.number(torqIndex);
+                if (wattsIndex >= 0) watts = in.number(wattsIndex);
 
                 rideFile->appendPoint(secs, rpm, bpm, km, kph, torq, watts, 0.0, 0.0, 0.0, 0.0, 0.0, RideFile::noTemp, 0.0, 0);
             }
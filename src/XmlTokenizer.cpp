@@ -0,0 +1,437 @@
+/*
+ * Copyright (c) 2026 GoldenCheetah Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "XmlTokenizer.h"
+#include "TextScanner.h"
+
+#include <QTextCodec>
+#include <string.h>
+#include <ctype.h>
+
+static const int BlockSize = 65536; // bytes read at a time
+static const int TagTableSize = 128; // enough for any of the readers
+
+XmlTokenizer::XmlTokenizer(QIODevice *device) :
+    device(device), codec(NULL), tagCount(0), pos(0), size(0), atEnd(false),
+    token(Invalid), tag_(Unknown), pendingEnd(false), attributeCount(0), leaf(false)
+{
+    tags.resize(TagTableSize);
+    for (int i=0; i<TagTableSize; i++) tags[i].id = Unknown;
+    attributes.resize(16);
+}
+
+// FNV-1a
+static inline unsigned int tagHash(const char *name, int length)
+{
+    unsigned int hash = 2166136261u;
+    for (int i=0; i<length; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void
+XmlTokenizer::addTag(const char *name, int id)
+{
+    int length = strlen(name);
+    if (tagCount == TagTableSize/2 || lookup(name, length) != Unknown) return;
+
+    unsigned int i = tagHash(name, length) & (TagTableSize-1);
+    while (tags[i].id != Unknown) i = (i+1) & (TagTableSize-1);
+    tags[i].name = QByteArray(name, length);
+    tags[i].id = id;
+    tagCount++;
+}
+
+int
+XmlTokenizer::lookup(const char *name, int length) const
+{
+    unsigned int i = tagHash(name, length) & (TagTableSize-1);
+    while (tags[i].id != Unknown) {
+        if (tags[i].name.size() == length && !memcmp(tags[i].name.constData(), name, length))
+            return tags[i].id;
+        i = (i+1) & (TagTableSize-1);
+    }
+    return Unknown;
+}
+
+//
+// READING
+//
+
+// read another block onto the end, first dropping whatever
+// we've finished with, false if there is nothing more to read
+bool
+XmlTokenizer::fill()
+{
+    if (atEnd) return false;
+
+    int discard = leaf ? qMin(pos, textRange.begin) : pos;
+    if (discard > 0) {
+        memmove(buf.data(), buf.constData() + discard, size - discard);
+        size -= discard;
+        pos -= discard;
+        textRange.begin -= discard;
+    }
+
+    if (buf.size() < size + BlockSize) buf.resize(size + BlockSize);
+    qint64 count = device->read(buf.data() + size, BlockSize);
+    if (count <= 0) {
+        atEnd = true;
+        return false;
+    }
+    size += count;
+    return true;
+}
+
+// offset from pos of the next c, -1 if there isn't one
+int
+XmlTokenizer::find(char c)
+{
+    int from = 0;
+    forever {
+        const char *found = static_cast<const char*>(memchr(at(pos + from), c, size - pos - from));
+        if (found) return found - at(pos);
+
+        from = size - pos;
+        if (!fill()) return -1;
+    }
+}
+
+int
+XmlTokenizer::find(const char *s)
+{
+    int length = strlen(s);
+    int from = 0;
+    forever {
+        for (int i=from; i <= size - pos - length; i++)
+            if (!memcmp(at(pos + i), s, length)) return i;
+
+        from = qMax(0, size - pos - length + 1);
+        if (!fill()) return -1;
+    }
+}
+
+// does s start at pos
+bool
+XmlTokenizer::lookingAt(const char *s)
+{
+    int length = strlen(s);
+    while (size - pos < length)
+        if (!fill()) return false;
+    return !memcmp(at(pos), s, length);
+}
+
+// offset from pos of the > that ends the tag,
+// allowing for a > in an attribute value
+int
+XmlTokenizer::tagEnd()
+{
+    char quote = 0;
+    int i = 1;
+    forever {
+        for (; pos + i < size; i++) {
+            char c = buf.at(pos + i);
+            if (quote) {
+                if (c == quote) quote = 0;
+            } else if (c == '"' || c == '\'') {
+                quote = c;
+            } else if (c == '>') {
+                return i;
+            }
+        }
+        if (!fill()) return -1;
+    }
+}
+
+//
+// TOKENS
+//
+XmlTokenizer::TokenType
+XmlTokenizer::next()
+{
+    attributeCount = 0;
+
+    if (pendingEnd) {
+        pendingEnd = leaf = false;
+        textRange.begin = textRange.end = 0;
+        return token = EndElement;
+    }
+
+    forever {
+
+        // anything up to the next tag is text
+        int lt = find('<');
+        if (lt < 0) {
+            tag_ = Unknown;
+            return token = EndDocument;
+        }
+        pos += lt;
+        if (pos + 1 >= size && !fill()) break;
+
+        char c = buf.at(pos + 1);
+        if (c == '/') {
+
+            int gt = find('>');
+            if (gt < 0) break;
+
+            // the name ends at the > or whitespace
+            int length = 2;
+            while (length < gt && !isspace((unsigned char)buf.at(pos + length))) length++;
+            nameRange.begin = pos + 2;
+            nameRange.end = pos + length;
+            tag_ = lookup(at(nameRange.begin), nameRange.end - nameRange.begin);
+
+            // only elements without children have text
+            if (leaf) textRange.end = pos;
+            else textRange.begin = textRange.end = pos;
+            leaf = false;
+
+            pos += gt + 1;
+            return token = EndElement;
+
+        } else if (c == '?') {
+
+            int end = find("?>");
+            if (end < 0) break;
+            declaration(end);
+            pos += end + 2;
+
+        } else if (c == '!') {
+
+            // comment, cdata or doctype -- cdata and comments in text
+            // are left in the element's text and sorted out by decode()
+            int end;
+            if (lookingAt("<!--")) {
+                end = find("-->");
+                if (end < 0) break;
+                pos += end + 3;
+            } else if (lookingAt("<![CDATA[")) {
+                end = find("]]>");
+                if (end < 0) break;
+                pos += end + 3;
+            } else {
+                end = find('>');
+                if (end < 0) break;
+                pos += end + 1;
+            }
+
+        } else {
+
+            int gt = tagEnd();
+            if (gt < 0) break;
+            startElement(gt);
+
+            pendingEnd = buf.at(pos + gt - 1) == '/';
+            pos += gt + 1;
+            leaf = true;
+            textRange.begin = textRange.end = pos;
+            return token = StartElement;
+        }
+    }
+
+    error = "unexpected end of file";
+    tag_ = Unknown;
+    return token = Invalid;
+}
+
+static inline bool isNameChar(char c)
+{
+    return !isspace((unsigned char)c) && c != '=' && c != '/' && c != '>';
+}
+
+// the name and attributes of the start tag from pos to the > at length
+void
+XmlTokenizer::startElement(int length)
+{
+    const char *p = at(pos);
+
+    int i = 1;
+    while (i < length && isNameChar(p[i])) i++;
+    nameRange.begin = pos + 1;
+    nameRange.end = pos + i;
+    tag_ = lookup(at(nameRange.begin), i - 1);
+
+    forever {
+        while (i < length && isspace((unsigned char)p[i])) i++;
+        if (i >= length || p[i] == '/') return;
+
+        Attribute attr;
+        attr.name.begin = pos + i;
+        while (i < length && isNameChar(p[i])) i++;
+        attr.name.end = pos + i;
+
+        while (i < length && isspace((unsigned char)p[i])) i++;
+        if (i >= length || p[i] != '=') return; // not well formed
+        i++;
+        while (i < length && isspace((unsigned char)p[i])) i++;
+        if (i >= length || (p[i] != '"' && p[i] != '\'')) return;
+
+        char quote = p[i++];
+        attr.value.begin = pos + i;
+        while (i < length && p[i] != quote) i++;
+        attr.value.end = pos + i;
+        i++;
+
+        if (attributeCount == attributes.count()) attributes.resize(attributeCount * 2);
+        attributes[attributeCount++] = attr;
+    }
+}
+
+// we only care about the encoding in <?xml ... ?>
+void
+XmlTokenizer::declaration(int length)
+{
+    if (length < 5 || memcmp(at(pos), "<?xml", 5)) return;
+
+    attributeCount = 0;
+    startElement(length);
+
+    const Attribute *encoding = findAttribute("encoding");
+    if (encoding) {
+        QByteArray name(at(encoding->value.begin), encoding->value.end - encoding->value.begin);
+        QTextCodec *found = QTextCodec::codecForName(name);
+        codec = (found && found->mibEnum() != 106) ? found : NULL; // 106 is utf-8
+    }
+    attributeCount = 0;
+}
+
+//
+// ATTRIBUTES AND TEXT
+//
+QString
+XmlTokenizer::name() const
+{
+    return toUnicode(at(nameRange.begin), nameRange.end - nameRange.begin);
+}
+
+const XmlTokenizer::Attribute *
+XmlTokenizer::findAttribute(const char *name) const
+{
+    int length = strlen(name);
+    for (int i=0; i<attributeCount; i++) {
+        const Attribute &attr = attributes[i];
+        if (attr.name.end - attr.name.begin == length && !memcmp(at(attr.name.begin), name, length))
+            return &attr;
+    }
+    return NULL;
+}
+
+bool
+XmlTokenizer::hasAttribute(const char *name) const
+{
+    return findAttribute(name) != NULL;
+}
+
+QString
+XmlTokenizer::attribute(const char *name, const QString &fallback) const
+{
+    const Attribute *attr = findAttribute(name);
+    return attr ? decode(attr->value) : fallback;
+}
+
+double
+XmlTokenizer::attributeNumber(const char *name, double fallback) const
+{
+    const Attribute *attr = findAttribute(name);
+    if (!attr) return fallback;
+
+    const char *begin = at(attr->value.begin);
+    const char *end = at(attr->value.end);
+    if (memchr(begin, '&', end - begin)) return decode(attr->value).toDouble();
+    return TextScanner::toDouble(begin, end);
+}
+
+QString
+XmlTokenizer::text() const
+{
+    return decode(textRange);
+}
+
+double
+XmlTokenizer::number(double fallback) const
+{
+    if (textRange.begin == textRange.end) return fallback;
+
+    const char *begin = at(textRange.begin);
+    const char *end = at(textRange.end);
+    if (memchr(begin, '&', end - begin) || memchr(begin, '<', end - begin))
+        return decode(textRange).toDouble();
+    return TextScanner::toDouble(begin, end);
+}
+
+QString
+XmlTokenizer::toUnicode(const char *data, int length) const
+{
+    return codec ? codec->toUnicode(data, length) : QString::fromUtf8(data, length);
+}
+
+// expand entities, drop comments and unwrap cdata
+QString
+XmlTokenizer::decode(const Range &range) const
+{
+    const char *p = at(range.begin);
+    int length = range.end - range.begin;
+
+    // nothing to do, which is nearly always the case
+    if (!memchr(p, '&', length) && !memchr(p, '<', length)) return toUnicode(p, length);
+
+    QString returning;
+    int from = 0;
+    for (int i=0; i<length; ) {
+
+        if (p[i] == '&') {
+
+            const char *semi = static_cast<const char*>(memchr(p + i, ';', length - i));
+            if (!semi) { i++; continue; }
+
+            returning += toUnicode(p + from, i - from);
+            QByteArray entity(p + i + 1, semi - p - i - 1);
+            if (entity == "lt") returning += QChar('<');
+            else if (entity == "gt") returning += QChar('>');
+            else if (entity == "amp") returning += QChar('&');
+            else if (entity == "quot") returning += QChar('"');
+            else if (entity == "apos") returning += QChar('\'');
+            else if (entity.startsWith("#")) {
+                uint code = entity.startsWith("#x") ? entity.mid(2).toUInt(0, 16) : entity.mid(1).toUInt();
+                returning += QString::fromUcs4(&code, 1);
+            }
+            i = from = semi - p + 1;
+
+        } else if (p[i] == '<') {
+
+            returning += toUnicode(p + from, i - from);
+            QByteArray rest = QByteArray::fromRawData(p + i, length - i);
+            if (rest.startsWith("<![CDATA[")) {
+                int end = rest.indexOf("]]>");
+                if (end < 0) end = rest.size();
+                returning += toUnicode(p + i + 9, end - 9);
+                i = from = qMin(i + end + 3, length);
+            } else {
+                int end = rest.indexOf("-->");
+                i = from = end < 0 ? length : i + end + 3;
+            }
+
+        } else {
+            i++;
+        }
+    }
+    returning += toUnicode(p + from, length - from);
+    return returning;
+}
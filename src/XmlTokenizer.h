@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2026 GoldenCheetah Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _GC_XmlTokenizer_h
+#define _GC_XmlTokenizer_h 1
+#include "GoldenCheetah.h"
+
+#include <QIODevice>
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+class QTextCodec;
+
+// XmlTokenizer is a pull parser for the XML ride file formats (TCX, GPX,
+// PWX and GC). The reader asks for the next start or end element rather
+// than being called back for everything in the file.
+//
+// It is a lot quicker than QXmlSimpleReader or QDomDocument since it
+// doesn't create a QString for every name, attribute and piece of text
+// it comes across. Element names the reader is interested in are added
+// up front with an id, so it can switch on them. Text and attributes are
+// only converted when asked for, and numbers are parsed straight from
+// the bytes in the file. The file is read a block at a time so memory
+// use doesn't grow with the size of the file.
+//
+// It is not a validating parser. Mismatched end elements aren't
+// reported, DTDs are skipped and only the predefined and character
+// entities are expanded. Text is only collected for elements that
+// contain no other elements, which is all the ride files need.
+class XmlTokenizer
+{
+    public:
+        enum TokenType { StartElement, EndElement, EndDocument, Invalid };
+        static const int Unknown = -1; // an element name that wasn't added
+
+        XmlTokenizer(QIODevice *device);
+
+        // give an element name an id, several names may share the
+        // same id e.g. with and without a namespace prefix
+        void addTag(const char *name, int id);
+
+        // the next start or end element, an empty element
+        // (<a/>) is returned as a start and then an end element
+        TokenType next();
+        TokenType tokenType() const { return token; }
+
+        // the current element
+        int tag() const { return tag_; }
+        QString name() const;
+
+        // attributes of the current start element
+        bool hasAttribute(const char *name) const;
+        QString attribute(const char *name, const QString &fallback = QString()) const;
+        double attributeNumber(const char *name, double fallback = 0.0) const;
+
+        // text of the current end element
+        QString text() const;
+        double number(double fallback = 0.0) const;
+
+        QString errorString() const { return error; }
+
+    private:
+
+        struct Range {
+            int begin, end;
+            Range() : begin(0), end(0) {}
+        };
+        struct Attribute {
+            Range name, value;
+        };
+        struct Tag {
+            QByteArray name;
+            int id;
+        };
+
+        bool fill();
+        int find(char c);
+        int find(const char *s);
+        bool lookingAt(const char *s);
+        int tagEnd();
+        void startElement(int length);
+        void declaration(int length);
+        int lookup(const char *name, int length) const;
+        const Attribute *findAttribute(const char *name) const;
+        QString decode(const Range &range) const;
+        QString toUnicode(const char *data, int length) const;
+        const char *at(int offset) const { return buf.constData() + offset; }
+
+        QIODevice *device;
+        QTextCodec *codec; // NULL when utf-8
+        QVector<Tag> tags; // open addressed by name hash
+        int tagCount;
+
+        // we keep from the start of the token being parsed, or
+        // the start of the text of the element we're in
+        QByteArray buf;
+        int pos, size;
+        bool atEnd;
+
+        TokenType token;
+        int tag_;
+        bool pendingEnd; // after <a/>
+        Range nameRange;
+        QVector<Attribute> attributes;
+        int attributeCount;
+        bool leaf; // no child elements yet, so we are collecting its text
+        Range textRange;
+        QString error;
+};
+#endif // _GC_XmlTokenizer_h
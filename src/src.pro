@@ -274,6 +274,7 @@ HEADERS += \
         FitlogRideFile.h \
         FitlogParser.h \
         FitRideFile.h \
+        GcbRideFile.h \
         GcCalendarModel.h \
         GcCrashDialog.h \
         GcPane.h \
@@ -295,6 +296,7 @@ HEADERS += \
         HrPwPlot.h \
         HrPwWindow.h \
         IntervalItem.h \
+        IntervalMetricsCache.h \
         IntervalSummaryWindow.h \
         IntervalTreeView.h \
         JouleDevice.h \
@@ -320,6 +322,7 @@ HEADERS += \
         MergeActivityWizard.h \
         MetadataWindow.h \
         MetricAggregator.h \
+        MetricQuery.h \
         NewCyclistDialog.h \
         NullController.h \
         Pages.h \
@@ -343,7 +346,9 @@ HEADERS += \
         RideEditor.h \
         RideFile.h \
         RideFileCache.h \
+        RideFileCacheIndex.h \
         RideFileCommand.h \
+        RideFileOpenQueue.h \
         RideFileTableModel.h \
         RideImportWizard.h \
         RideItem.h \
@@ -351,6 +356,7 @@ HEADERS += \
         RideMetric.h \
         RideNavigator.h \
         RideNavigatorProxy.h \
+        RideSet.h \
         RideWindow.h \
         RideWithGPSDialog.h \
         SaveDialogs.h \
@@ -373,6 +379,7 @@ HEADERS += \
         SmfRideFile.h \
         SrdRideFile.h \
         SrmRideFile.h \
+        StressCache.h \
         StressCalculator.h \
         SummaryMetrics.h \
         SummaryWindow.h \
@@ -381,6 +388,7 @@ HEADERS += \
         TabView.h \
         TcxParser.h \
         TcxRideFile.h \
+        TextScanner.h \
         TxtRideFile.h \
         TimeUtils.h \
         ToolsDialog.h \
@@ -396,6 +404,7 @@ HEADERS += \
         WkoRideFile.h \
         WorkoutPlotWindow.h \
         WorkoutWizard.h \
+        XmlTokenizer.h \
         ZeoDownload.h \
         Zones.h \
         ZoneScaleDraw.h
@@ -465,6 +474,7 @@ SOURCES += \
         FixSpikes.cpp \
         FixTorque.cpp \
         FixHRSpikes.cpp \
+        GcbRideFile.cpp \
         GcCrashDialog.cpp \
         GcPane.cpp \
         GcRideFile.cpp \
@@ -486,6 +496,7 @@ SOURCES += \
         HrPwPlot.cpp \
         HrPwWindow.cpp \
         IntervalItem.cpp \
+        IntervalMetricsCache.cpp \
         IntervalSummaryWindow.cpp \
         IntervalTreeView.cpp \
         JouleDevice.cpp \
@@ -511,6 +522,7 @@ SOURCES += \
         MergeActivityWizard.cpp \
         MetadataWindow.cpp \
         MetricAggregator.cpp \
+        MetricQuery.cpp \
         NewCyclistDialog.cpp \
         NullController.cpp \
         Pages.cpp \
@@ -535,7 +547,9 @@ SOURCES += \
         RideEditor.cpp \
         RideFile.cpp \
         RideFileCache.cpp \
+        RideFileCacheIndex.cpp \
         RideFileCommand.cpp \
+        RideFileOpenQueue.cpp \
         RideFileTableModel.cpp \
         RideImportWizard.cpp \
         RideItem.cpp \
@@ -564,6 +578,7 @@ SOURCES += \
         SmfRideFile.cpp \
         SrdRideFile.cpp \
         SrmRideFile.cpp \
+        StressCache.cpp \
         StressCalculator.cpp \
         SummaryMetrics.cpp \
         SummaryWindow.cpp \
@@ -573,6 +588,7 @@ SOURCES += \
         TacxCafRideFile.cpp \
         TcxParser.cpp \
         TcxRideFile.cpp \
+        TextScanner.cpp \
         TxtRideFile.cpp \
         TimeInZone.cpp \
         TimeUtils.cpp \
@@ -590,10 +606,24 @@ SOURCES += \
         WkoRideFile.cpp \
         WorkoutPlotWindow.cpp \
         WorkoutWizard.cpp \
+        XmlTokenizer.cpp \
         ZeoDownload.cpp \
         Zones.cpp \
         main.cpp \
 
+# qmake CONFIG+=unittests builds the unit tests instead, run them from here
+unittests {
+    TARGET = GoldenCheetahTests
+    CONFIG += qtestlib
+    INCLUDEPATH += ../test/unittests
+    HEADERS += ../test/unittests/TestDataFilter.h \
+               ../test/unittests/TestJsonRideFile.h
+    SOURCES -= main.cpp
+    SOURCES += ../test/unittests/TestDataFilter.cpp \
+               ../test/unittests/TestJsonRideFile.cpp \
+               ../test/unittests/TestMain.cpp
+}
+
 RESOURCES = application.qrc \
             RideWindow.qrc
 
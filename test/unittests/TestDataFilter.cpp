@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2026 GoldenCheetah Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "TestDataFilter.h"
+#include "DataFilter.h"
+#include "DBAccess.h"
+#include "SummaryMetrics.h"
+
+#include <QtTest>
+
+void TestDataFilter::init()
+{
+    // just the metrics and a text field, there is no athlete
+    df = new DataFilter(NULL, NULL);
+    df->lookupMap.insert("Notes", "Notes");
+    df->lookupType.insert("Notes", false);
+}
+
+void TestDataFilter::cleanup()
+{
+    delete df;
+}
+
+void TestDataFilter::textDuration()
+{
+    QVERIFY(!df->parseFilter("best(power, Notes) > 100").isEmpty());
+    QVERIFY(!df->parseFilter("tiz(hr, Notes) > 100").isEmpty());
+}
+
+void TestDataFilter::mismatchedDuration()
+{
+    QVERIFY(!df->parseFilter("best(power, Notes + 1) > 100").isEmpty());
+    QVERIFY(!df->parseFilter("best(power, \"x\" > 3) > 1").isEmpty());
+    QVERIFY(!df->parseFilter("tiz(hr, Notes contains 3) > 1").isEmpty());
+}
+
+void TestDataFilter::mismatchedProgram()
+{
+    // best(power, Notes + 1) as the parser would build it, the duration
+    // compiles as a string operation so best() would pop an empty stack
+    Leaf *notes = new Leaf();
+    notes->type = Leaf::Symbol;
+    notes->lvalue.n = new QString("Notes");
+
+    Leaf *one = new Leaf();
+    one->type = Leaf::Integer;
+    one->lvalue.i = 1;
+
+    Leaf *sum = new Leaf();
+    sum->type = Leaf::Operation;
+    sum->lvalue.l = notes;
+    sum->rvalue.l = one;
+
+    Leaf *power = new Leaf();
+    power->type = Leaf::Symbol;
+    power->lvalue.n = new QString("power");
+
+    Leaf *best = new Leaf();
+    best->type = Leaf::Function;
+    best->function = "best";
+    best->series = power;
+    best->seriesType = RideFile::watts;
+    best->lvalue.l = sum;
+
+    DataFilterProgram program;
+    program.compile(df, best);
+    program.prepare(NULL, QStringList());
+
+    // it is false for every ride, rather than being run
+    SummaryMetrics ride;
+    ride.setFileName("2013_05_27_08_56_35.json");
+    ride.setText("Notes", "interval session");
+    QCOMPARE(program.run(NULL, ride, 0, ride.getFileName()), 0.0);
+
+    MetricStore store;
+    store.setColumns(QStringList(), QStringList() << "Notes");
+    store.append(ride);
+
+    QBitArray results;
+    QVERIFY(program.runColumns(store, results));
+    QCOMPARE(results.count(), 1);
+    QVERIFY(!results.testBit(0));
+}
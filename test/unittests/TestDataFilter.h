@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2026 GoldenCheetah Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _GC_TestDataFilter_h
+#define _GC_TestDataFilter_h
+
+#include <QObject>
+
+class DataFilter;
+
+// filters that aren't well typed must be rejected, and if one
+// does get compiled it must not run off the program's stacks
+class TestDataFilter : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void init();
+        void cleanup();
+
+        void textDuration();
+        void mismatchedDuration();
+        void mismatchedProgram();
+
+    private:
+        DataFilter *df;
+};
+
+#endif
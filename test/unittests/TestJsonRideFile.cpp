@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2026 GoldenCheetah Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "TestJsonRideFile.h"
+#include "RideFile.h"
+#include "JsonRideFile.h"
+#include "GcRideFile.h"
+#include "TcxRideFile.h"
+#include "CsvRideFile.h"
+
+#include <QtTest>
+
+// relative to the directory the tests are run from
+static const char *ridesDir = "../test/rides";
+
+// numbers are written with 6 significant digits, lat/lon with 11
+static bool sameValue(double a, double b)
+{
+    return qAbs(a - b) <= 1e-5 * qMax(qAbs(a), qAbs(b)) + 1e-9;
+}
+
+void TestJsonRideFile::roundTrip_data()
+{
+    QTest::addColumn<QString>("fileName");
+
+    QDir rides(ridesDir);
+    QStringList filters;
+    filters << "*.json" << "*.gc" << "*.tcx" << "*.csv" << "*.CSV";
+    foreach (QString name, rides.entryList(filters, QDir::Files, QDir::Name))
+        QTest::newRow(name.toLatin1().constData()) << rides.absoluteFilePath(name);
+
+    QVERIFY2(!rides.entryList(filters).isEmpty(), "no sample rides, run the tests from the src directory");
+}
+
+void TestJsonRideFile::roundTrip()
+{
+    QFETCH(QString, fileName);
+
+    QString suffix = QFileInfo(fileName).suffix().toLower();
+    JsonFileReader json;
+    GcFileReader gc;
+    TcxFileReader tcx;
+    CsvFileReader csv;
+    const RideFileReader *reader = &json;
+    if (suffix == "gc") reader = &gc;
+    else if (suffix == "tcx") reader = &tcx;
+    else if (suffix == "csv") reader = &csv;
+
+    QStringList errors;
+    QFile original(fileName);
+    RideFile *ride = reader->openRideFile(original, errors);
+    if (!ride) QSKIP("not a ride this reader understands", SkipSingle);
+
+    // write it away as json, it doesn't need a context
+    QFile written(QDir::temp().absoluteFilePath("gc-roundtrip-" + QFileInfo(fileName).baseName() + ".json"));
+    QVERIFY(json.writeRideFile(NULL, ride, written));
+
+    RideFile *back = json.openRideFile(written, errors);
+    written.remove();
+    QVERIFY2(back, qPrintable(errors.join("; ")));
+
+    QCOMPARE(back->dataPoints().count(), ride->dataPoints().count());
+
+    // only the series that are present are written
+    const RideFileDataPresent *present = ride->areDataPresent();
+    for (int i=0; i<ride->dataPoints().count(); i++) {
+        const RideFilePoint *p = ride->dataPoints()[i];
+        const RideFilePoint *q = back->dataPoints()[i];
+
+        #define SAME(series) \
+            QVERIFY2(sameValue(p->series, q->series), \
+                     qPrintable(QString("sample %1 " #series " %2 read back as %3").arg(i).arg(p->series, 0, 'g', 17).arg(q->series, 0, 'g', 17)))
+        SAME(secs);
+        if (present->km) SAME(km);
+        if (present->watts) SAME(watts);
+        if (present->nm) SAME(nm);
+        if (present->cad) SAME(cad);
+        if (present->kph) SAME(kph);
+        if (present->hr) SAME(hr);
+        if (present->alt) SAME(alt);
+        if (present->lat) SAME(lat);
+        if (present->lon) SAME(lon);
+        if (present->headwind) SAME(headwind);
+        if (present->slope) SAME(slope);
+        if (present->temp) SAME(temp);
+        if (present->lrbalance) SAME(lrbalance);
+        #undef SAME
+    }
+
+    delete back;
+    delete ride;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2026 GoldenCheetah Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "RideMetric.h"
+#include "TestDataFilter.h"
+#include "TestJsonRideFile.h"
+
+#include <QApplication>
+#include <QtTest>
+
+// the application normally provides this
+QApplication *application;
+
+// qmake CONFIG+=unittests builds this instead of the application,
+// run it from the src directory, it returns the number of failures
+int
+main(int argc, char *argv[])
+{
+    application = new QApplication(argc, argv);
+    RideMetricFactory::instance().initialize();
+
+    int failures = 0;
+
+    TestDataFilter dataFilter;
+    failures += QTest::qExec(&dataFilter, argc, argv);
+
+    TestJsonRideFile jsonRideFile;
+    failures += QTest::qExec(&jsonRideFile, argc, argv);
+
+    return failures;
+}